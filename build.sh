@@ -8,8 +8,10 @@
 #   ./build.sh                    # Full build (bootstrap + native)
 #   ./build.sh bootstrap          # Build bootstrap compiler only
 #   ./build.sh native             # Build native compiler
+#   ./build.sh incremental        # Native build reusing build/artifacts/cache
 #   ./build.sh runtime            # Build runtime only
 #   ./build.sh test               # Run tests
+#   ./build.sh bench              # Run benchmarks (tests/bench + self-host)
 #   ./build.sh clean              # Clean build artifacts
 #   ./build.sh help               # Show this help
 #
@@ -17,7 +19,13 @@
 #   DEBUG=1                       # Enable debug output
 #   FORCE_RUNTIME=1               # Force runtime rebuild
 #   SKIP_RUNTIME=1                # Skip runtime build
+#   KAIN_GC=1                     # Runtime with the tracing collector (-DKAIN_GC)
+#   KAIN_PROFILE=1                # Runtime with builtin/allocation counters (-DKAIN_PROFILE)
+#   KAIN_LTO=1                    # Link programs with the runtime bitcode (cross-module inlining)
 #   KEEP_HISTORY=N                # Keep last N builds (default: 3)
+#   JOBS=N                        # Parallel backend jobs (default: all cores)
+#   CACHE_DAYS=N                  # Drop cache entries unused for N days (default: 14)
+#   KAIN_BENCH_RUNS=N             # Override the run count of every benchmark
 # ============================================================================
 
 set -e  # Exit on error
@@ -41,7 +49,7 @@ log_info()  { echo -e "${CYAN}>>${NC} $1"; }
 log_warn()  { echo -e "${YELLOW}[!]${NC} $1"; }
 log_err()   { echo -e "${RED}[X]${NC} $1"; }
 log_step()  { echo -e "${MAGENTA}==>${NC} ${BOLD}$1${NC}"; }
-log_debug() { [[ -n "$DEBUG" ]] && echo -e "${GRAY}    [DEBUG] $1${NC}"; }
+log_debug() { [[ -n "$DEBUG" ]] && echo -e "${GRAY}    [DEBUG] $1${NC}"; return 0; }
 
 separator() {
     echo -e "${BLUE}$(printf '=%.0s' {1..70})${NC}"
@@ -77,10 +85,26 @@ LATEST_NATIVE="$ARTIFACTS_DIR/latest/KAIN_native"
 # Runtime
 RUNTIME_SRC="$RUNTIME_DIR/KAIN_runtime.c"
 RUNTIME_OBJ="$BUILD_DIR/KAIN_runtime.o"
+RUNTIME_LIB="$BUILD_DIR/libkain_rt.a"     # RUNTIME_OBJ, archived for --gc-sections
+RUNTIME_BC="$BUILD_DIR/kain_runtime.bc"   # LLVM bitcode for KAIN_LTO links
+RUNTIME_HDR="$RUNTIME_DIR/kain_runtime.h"
+RUNTIME_STAMP="$RUNTIME_OBJ.flags"        # rt_flags the artifacts were built with
+
+# Drop unreferenced runtime functions (built with -ffunction-sections)
+if [[ "$(uname -s)" == "Darwin" ]]; then
+    GC_SECTIONS_FLAG="-Wl,-dead_strip"
+else
+    GC_SECTIONS_FLAG="-Wl,--gc-sections"
+fi
 
 # Keep history
 KEEP_HISTORY="${KEEP_HISTORY:-3}"
 
+# Incremental build cache (build/artifacts/cache) and backend parallelism
+CACHE_DIR="$ARTIFACTS_DIR/cache"
+CACHE_DAYS="${CACHE_DAYS:-14}"
+JOBS="${JOBS:-$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)}"
+
 # Source files in dependency order
 CORE_SOURCES=(
     "src/span.kn"
@@ -168,13 +192,33 @@ build_runtime() {
     log_step "Building C runtime..."
     ensure_dir "$BUILD_DIR"
     
+    local rt_flags=""
+    if [[ -n "$KAIN_GC" ]]; then
+        rt_flags="$rt_flags -DKAIN_GC"
+    fi
+    if [[ -n "$KAIN_PROFILE" ]]; then
+        rt_flags="$rt_flags -DKAIN_PROFILE"
+    fi
+    
+    # One section per function/global, so linking against the archive with
+    # GC_SECTIONS_FLAG keeps only the builtins a program actually reaches
+    rt_flags="$rt_flags -ffunction-sections -fdata-sections"
+    
     local needs_rebuild=0
     
-    if [[ ! -f "$RUNTIME_OBJ" ]]; then
+    if [[ ! -f "$RUNTIME_OBJ" ]] || [[ ! -f "$RUNTIME_LIB" ]] || [[ ! -f "$RUNTIME_BC" ]]; then
         needs_rebuild=1
-    elif [[ "$RUNTIME_SRC" -nt "$RUNTIME_OBJ" ]]; then
+    elif [[ "$RUNTIME_SRC" -nt "$RUNTIME_OBJ" ]] || [[ "$RUNTIME_HDR" -nt "$RUNTIME_OBJ" ]]; then
         log_warn "Runtime source is newer than object - rebuilding"
         needs_rebuild=1
+    elif [[ "$(cat "$RUNTIME_STAMP" 2>/dev/null)" != "$rt_flags" ]]; then
+        log_warn "Runtime flags changed - rebuilding"
+        needs_rebuild=1
+    elif [[ "$RUNTIME_OBJ" -nt "$RUNTIME_LIB" ]] || [[ "$RUNTIME_OBJ" -nt "$RUNTIME_BC" ]]; then
+        # A previous build stopped after the object: the archive or bitcode
+        # may still hold the other KAIN_GC/KAIN_PROFILE variant
+        log_warn "Runtime library or bitcode is older than object - rebuilding"
+        needs_rebuild=1
     elif [[ -n "$FORCE_RUNTIME" ]]; then
         log_warn "Forced runtime rebuild"
         needs_rebuild=1
@@ -185,11 +229,22 @@ build_runtime() {
         return 0
     fi
     
-    log_debug "clang -c $RUNTIME_SRC -o $RUNTIME_OBJ -O2 -Wall"
-    clang -c "$RUNTIME_SRC" -o "$RUNTIME_OBJ" -O2 -Wall
+    log_debug "clang -c $RUNTIME_SRC -o $RUNTIME_OBJ -O2 -Wall $rt_flags"
+    rm -f "$RUNTIME_STAMP"
+    clang -c "$RUNTIME_SRC" -o "$RUNTIME_OBJ" -O2 -Wall $rt_flags
+    
+    rm -f "$RUNTIME_LIB"
+    ar rcs "$RUNTIME_LIB" "$RUNTIME_OBJ"
+    
+    log_debug "clang -c -emit-llvm $RUNTIME_SRC -o $RUNTIME_BC -O2 $rt_flags"
+    clang -c -emit-llvm "$RUNTIME_SRC" -o "$RUNTIME_BC" -O2 $rt_flags
+    
+    # Written last: the stamp vouches for the object, archive and bitcode
+    echo "$rt_flags" > "$RUNTIME_STAMP"
     
     local size=$(stat -f%z "$RUNTIME_OBJ" 2>/dev/null || stat -c%s "$RUNTIME_OBJ")
     log_ok "Runtime compiled: $RUNTIME_OBJ ($size bytes)"
+    log_ok "Runtime library: $RUNTIME_LIB, bitcode: $RUNTIME_BC"
 }
 
 # ============================================================================
@@ -293,7 +348,7 @@ compile_with_bootstrap() {
     
     log_debug "$BOOTSTRAP_COMPILER $input_file -o $output_ll"
     "$BOOTSTRAP_COMPILER" "$input_file" -o "$output_ll" 2>&1 | while read -r line; do
-        [[ -n "$DEBUG" ]] && echo "  $line"
+        if [[ -n "$DEBUG" ]]; then echo "  $line"; fi
     done
     
     if [[ ! -f "$output_ll" ]]; then
@@ -345,6 +400,30 @@ fix_llvm_ir() {
 # Link Executable
 # ============================================================================
 
+# Link compiled KAIN code (.ll or objects) against the runtime: the archive
+# with dead-section stripping by default, or with KAIN_LTO=1 a single IR
+# module so LLVM can inline runtime builtins (kain_array_get, kain_add_op, ...)
+# into user code. Extra arguments are passed through to clang.
+link_with_runtime() {
+    local output_exe="$1"
+    shift
+    
+    if [[ -n "$KAIN_LTO" ]]; then
+        if command -v llvm-link &> /dev/null; then
+            local merged_bc="${output_exe}.lto.bc"
+            llvm-link "$@" "$RUNTIME_BC" -o "$merged_bc" || return 1
+            clang "$merged_bc" -o "$output_exe" -O2 $GC_SECTIONS_FLAG -lm -lpthread || return 1
+            rm -f "$merged_bc"
+            return 0
+        fi
+        # No llvm-link: leave it to the linker's LTO plugin
+        clang -flto "$@" "$RUNTIME_BC" -o "$output_exe" -O2 -lm -lpthread
+        return
+    fi
+    
+    clang "$@" "$RUNTIME_LIB" -o "$output_exe" -O2 $GC_SECTIONS_FLAG -lm -lpthread
+}
+
 link_executable() {
     local input_ll="$1"
     local output_exe="$2"
@@ -354,18 +433,18 @@ link_executable() {
     log_info "  Output: $output_exe"
     
     # Ensure runtime exists
-    if [[ ! -f "$RUNTIME_OBJ" ]]; then
+    if [[ ! -f "$RUNTIME_LIB" ]]; then
         if [[ -n "$SKIP_RUNTIME" ]]; then
-            log_err "Runtime object not found: $RUNTIME_OBJ"
+            log_err "Runtime library not found: $RUNTIME_LIB"
             exit 1
         fi
         build_runtime
     fi
     
-    log_debug "clang $input_ll $RUNTIME_OBJ -o $output_exe -O2"
-    clang "$input_ll" "$RUNTIME_OBJ" -o "$output_exe" -O2 2>&1 | while read -r line; do
+    log_debug "link_with_runtime $output_exe $input_ll"
+    link_with_runtime "$output_exe" "$input_ll" 2>&1 | while read -r line; do
         [[ "$line" == *"warning"* ]] && log_debug "$line"
-        [[ "$line" == *"error"* ]] && log_err "$line"
+        if [[ "$line" == *"error"* ]]; then log_err "$line"; fi
     done
     
     if [[ ! -f "$output_exe" ]]; then
@@ -421,6 +500,231 @@ build_native() {
     separator
 }
 
+# ============================================================================
+# Incremental Native Build
+# ============================================================================
+# The compiler resolves and type-checks the whole program before emitting a
+# single module, so IR cannot be produced one .kn file at a time. What is
+# cached instead: the fixed IR, keyed by the module hashes and the compiler,
+# and the backend objects. llvm-split cuts the IR into JOBS partitions that
+# are compiled in parallel and cached by content, so an edit only recompiles
+# the partitions whose functions changed.
+
+hash_stdin() {
+    if command -v sha256sum &> /dev/null; then
+        sha256sum | cut -c1-32
+    else
+        shasum -a 256 | cut -c1-32
+    fi
+}
+
+# Key of each CORE_SOURCES entry: its text plus the keys of the core modules
+# it imports (all earlier in dependency order), so an edit also marks its users
+MODULE_KEYS=()
+
+module_key_of() {
+    local name="$1"
+    local i
+    for i in "${!CORE_SOURCES[@]}"; do
+        if [[ "$(basename "${CORE_SOURCES[$i]}" .kn)" == "$name" ]]; then
+            echo "${MODULE_KEYS[$i]}"
+            return 0
+        fi
+    done
+}
+
+compute_module_keys() {
+    MODULE_KEYS=()
+    local i
+    for i in "${!CORE_SOURCES[@]}"; do
+        local source="${CORE_SOURCES[$i]}"
+        if [[ ! -f "$ROOT/$source" ]]; then
+            log_err "Source file not found: $source"
+            exit 1
+        fi
+        
+        local deps=""
+        local module
+        for module in $(grep -oE '^[[:space:]]*use[[:space:]]+[a-zA-Z_]+' "$ROOT/$source" | awk '{print $2}'); do
+            deps="$deps $module:$(module_key_of "$module")"
+        done
+        MODULE_KEYS[$i]=$( { cat "$ROOT/$source"; echo "$deps"; } | hash_stdin )
+    done
+}
+
+# Log which modules changed since the last incremental build
+report_module_changes() {
+    local manifest="$1"
+    local changed=()
+    local i
+    for i in "${!CORE_SOURCES[@]}"; do
+        local source="${CORE_SOURCES[$i]}"
+        if ! grep -qx "$source ${MODULE_KEYS[$i]}" "$manifest" 2>/dev/null; then
+            changed+=("$(basename "$source" .kn)")
+        fi
+    done
+    
+    if [[ ${#changed[@]} -eq 0 ]]; then
+        log_info "No module changed since the last build"
+    else
+        log_info "${#changed[@]}/${#CORE_SOURCES[@]} modules changed: ${changed[*]}"
+    fi
+    
+    : > "$manifest"
+    for i in "${!CORE_SOURCES[@]}"; do
+        echo "${CORE_SOURCES[$i]} ${MODULE_KEYS[$i]}" >> "$manifest"
+    done
+}
+
+# Compile IR to objects, one cached object per llvm-split partition.
+# Leaves the object paths in BACKEND_OBJS.
+BACKEND_OBJS=()
+
+compile_backend() {
+    local input_ll="$1"
+    local backend_flags="-O2"
+    local work_dir="$CACHE_DIR/split"
+    
+    log_step "Compiling LLVM IR ($JOBS jobs)..."
+    rm -rf "$work_dir"
+    ensure_dir "$work_dir"
+    ensure_dir "$CACHE_DIR/obj"
+    
+    local parts=()
+    if command -v llvm-split &> /dev/null && command -v llvm-as &> /dev/null && [[ $JOBS -gt 1 ]]; then
+        # Fixed paths: the module identifier ends up in the bitcode and
+        # therefore in the partition hashes
+        ln -f "$input_ll" "$work_dir/program.ll" 2>/dev/null || cp "$input_ll" "$work_dir/program.ll"
+        llvm-as "$work_dir/program.ll" -o "$work_dir/program.bc"
+        llvm-split -j "$JOBS" -o "$work_dir/part" "$work_dir/program.bc"
+        local n
+        for ((n = 0; n < JOBS; n++)); do
+            [[ -f "$work_dir/part$n" ]] && parts+=("$work_dir/part$n")
+        done
+    else
+        log_debug "llvm-split not available - compiling the IR as one unit"
+        parts=("$input_ll")
+    fi
+    
+    BACKEND_OBJS=()
+    local pids=()
+    local hits=0
+    local part
+    for part in "${parts[@]}"; do
+        local key=$( { cat "$part"; echo "$backend_flags"; } | hash_stdin )
+        local obj="$CACHE_DIR/obj/$key.o"
+        BACKEND_OBJS+=("$obj")
+        
+        if [[ -f "$obj" ]]; then
+            touch "$obj"
+            ((hits++)) || true
+            continue
+        fi
+        
+        log_debug "clang -c -x ir $part -o $obj $backend_flags"
+        # Write next to the entry and rename, so a failed job never leaves
+        # a truncated object in the cache
+        ( clang -c -x ir "$part" -o "$obj.tmp" $backend_flags && mv "$obj.tmp" "$obj" ) &
+        pids+=($!)
+    done
+    
+    local failed=0
+    local pid
+    for pid in "${pids[@]}"; do
+        wait "$pid" || failed=1
+    done
+    if [[ $failed -ne 0 ]]; then
+        log_err "Backend compilation failed!"
+        exit 1
+    fi
+    
+    log_ok "Objects: ${#parts[@]} partitions, $hits cached, ${#pids[@]} compiled"
+}
+
+build_incremental() {
+    separator
+    log_info "BUILDING NATIVE KAIN COMPILER (incremental)"
+    log_info "Build ID: $BUILD_TIMESTAMP"
+    separator
+    
+    if [[ ! -f "$BOOTSTRAP_COMPILER" ]]; then
+        log_err "Bootstrap compiler not found! Run ./build.sh bootstrap first"
+        exit 1
+    fi
+    
+    ensure_dir "$BUILD_FOLDER"
+    ensure_dir "$CACHE_DIR/ll"
+    
+    # The runtime does not depend on the compiler output: build it meanwhile
+    local runtime_pid=""
+    if [[ -z "$SKIP_RUNTIME" ]]; then
+        build_runtime &
+        runtime_pid=$!
+    fi
+    
+    # Step 1: Hash modules, compiler and IR fixups into the program key
+    compute_module_keys
+    report_module_changes "$CACHE_DIR/modules.manifest"
+    local program_key=$( {
+        printf '%s\n' "${MODULE_KEYS[@]}"
+        hash_stdin < "$BOOTSTRAP_COMPILER"
+        declare -f fix_llvm_ir
+    } | hash_stdin )
+    local cached_ll="$CACHE_DIR/ll/$program_key.ll"
+    local fixed_ll="$BUILD_FOLDER/KAIN_native_fixed.ll"
+    local exe_file="$BUILD_FOLDER/KAIN_native"
+    
+    # Step 2: Front end, only when some module changed
+    if [[ -f "$cached_ll" ]]; then
+        touch "$cached_ll"
+        log_ok "LLVM IR cached: $cached_ll"
+    else
+        local combined_file="$BUILD_DIR/KAINc_build.kn"
+        local ll_file="$BUILD_FOLDER/KAIN_native.ll"
+        combine_sources "$combined_file" "${CORE_SOURCES[@]}"
+        cp "$combined_file" "$BUILD_FOLDER/KAINc_build.kn"
+        compile_with_bootstrap "$combined_file" "$ll_file"
+        fix_llvm_ir "$ll_file" "$cached_ll.tmp"
+        mv "$cached_ll.tmp" "$cached_ll"
+    fi
+    ln -f "$cached_ll" "$fixed_ll" 2>/dev/null || cp "$cached_ll" "$fixed_ll"
+    
+    # Step 3: Backend, in parallel partitions
+    compile_backend "$cached_ll"
+    
+    # Step 4: Link
+    if [[ -n "$runtime_pid" ]] && ! wait "$runtime_pid"; then
+        log_err "Runtime build failed!"
+        exit 1
+    fi
+    if [[ ! -f "$RUNTIME_LIB" ]]; then
+        log_err "Runtime library not found: $RUNTIME_LIB"
+        exit 1
+    fi
+    
+    # The partitions are already machine code, so KAIN_LTO does not apply here
+    log_step "Linking executable..."
+    log_debug "clang ${BACKEND_OBJS[*]} $RUNTIME_LIB -o $exe_file $GC_SECTIONS_FLAG -lm -lpthread"
+    if ! clang "${BACKEND_OBJS[@]}" "$RUNTIME_LIB" -o "$exe_file" $GC_SECTIONS_FLAG -lm -lpthread; then
+        log_err "Linking failed!"
+        exit 1
+    fi
+    local size=$(stat -f%z "$exe_file" 2>/dev/null || stat -c%s "$exe_file")
+    log_ok "Linked: $exe_file ($size bytes)"
+    
+    update_latest_link "$BUILD_FOLDER"
+    cleanup_old_builds "$KEEP_HISTORY"
+    
+    # Drop cache entries no build has used for CACHE_DAYS
+    find "$CACHE_DIR/ll" "$CACHE_DIR/obj" -type f -mtime +"$CACHE_DAYS" -delete 2>/dev/null || true
+    
+    separator
+    log_ok "NATIVE COMPILER READY"
+    log_info "  Path: $exe_file"
+    log_info "  Latest: $LATEST_NATIVE"
+    separator
+}
+
 # ============================================================================
 # Run Tests
 # ============================================================================
@@ -465,7 +769,7 @@ run_tests() {
         fi
         
         # Link
-        if ! clang "$ll_file" "$RUNTIME_OBJ" -o "$exe_file" &>/dev/null; then
+        if ! link_with_runtime "$exe_file" "$ll_file" &>/dev/null; then
             echo -e "${RED}LINK FAIL${NC}"
             ((failed++))
             continue
@@ -488,6 +792,62 @@ run_tests() {
     return $failed
 }
 
+# ============================================================================
+# Run Benchmarks
+# ============================================================================
+
+run_benchmarks() {
+    separator
+    log_info "RUNNING BENCHMARKS"
+    separator
+    
+    if [[ ! -f "$LATEST_NATIVE" ]]; then
+        log_err "Native compiler not found! Run ./build.sh native first"
+        exit 1
+    fi
+    
+    local bench_dir="$BUILD_DIR/bench_$BUILD_TIMESTAMP"
+    ensure_dir "$bench_dir"
+    
+    # Runtime microbenchmarks: each program prints its own bench() lines
+    for bench_file in "$TESTS_DIR"/bench/*.kn; do
+        [[ ! -f "$bench_file" ]] && continue
+        
+        local name=$(basename "$bench_file" .kn)
+        log_step "$name"
+        
+        local ll_file="$bench_dir/$name.ll"
+        local exe_file="$bench_dir/$name"
+        if ! "$LATEST_NATIVE" "$bench_file" -o "$ll_file" &>/dev/null ||
+           ! link_with_runtime "$exe_file" "$ll_file" &>/dev/null; then
+            log_err "Failed to build $name"
+            continue
+        fi
+        "$exe_file"
+    done
+    
+    # Self-host: the native compiler compiling its own sources
+    log_step "self-host"
+    local combined_file="$bench_dir/KAINc_build.kn"
+    combine_sources "$combined_file" "${CORE_SOURCES[@]}" > /dev/null
+    
+    local runs="${KAIN_BENCH_RUNS:-5}"
+    local times=()
+    for ((i = 0; i < runs; i++)); do
+        local t0=$(date +%s%N)
+        if ! "$LATEST_NATIVE" "$combined_file" -o "$bench_dir/self_host.ll" &>/dev/null; then
+            log_err "Self-host compile failed"
+            return 1
+        fi
+        local t1=$(date +%s%N)
+        times+=($(( (t1 - t0) / 1000000 )))
+    done
+    local sorted=($(printf '%s\n' "${times[@]}" | sort -n))
+    echo "bench self-host (src/)         min ${sorted[0]} ms  median ${sorted[$((runs / 2))]} ms  (${runs} runs)"
+    
+    separator
+}
+
 # ============================================================================
 # Clean
 # ============================================================================
@@ -496,7 +856,7 @@ do_clean() {
     log_step "Cleaning build artifacts..."
     
     rm -rf "$ARTIFACTS_DIR" 2>/dev/null || true
-    rm -f "$RUNTIME_OBJ" 2>/dev/null || true
+    rm -f "$RUNTIME_OBJ" "$RUNTIME_LIB" "$RUNTIME_BC" "$RUNTIME_STAMP" 2>/dev/null || true
     rm -f "$BUILD_DIR/KAINc_build.kn" 2>/dev/null || true
     
     log_ok "Clean complete"
@@ -526,8 +886,10 @@ ${CYAN}Targets:${NC}
   all         Full build (bootstrap + native) [default]
   bootstrap   Build bootstrap compiler (Rust) only
   native      Build native KAIN compiler
+  incremental Native build with cached IR/objects and a parallel backend
   runtime     Build runtime library only
   test        Run test suite
+  bench       Run benchmarks (tests/bench and a self-host compile)
   clean       Clean build artifacts
   clean-all   Clean ALL artifacts (including bootstrap)
   help        Show this help
@@ -536,11 +898,18 @@ ${CYAN}Environment Variables:${NC}
   DEBUG=1           Enable debug output
   FORCE_RUNTIME=1   Force runtime rebuild
   SKIP_RUNTIME=1    Skip runtime build
+  KAIN_GC=1         Build the runtime with the tracing collector
+  KAIN_PROFILE=1    Build the runtime with call/allocation counters
+  KAIN_LTO=1        Link with the runtime bitcode so builtins can be inlined
   KEEP_HISTORY=N    Keep last N builds (default: 3)
+  JOBS=N            Parallel backend jobs for incremental (default: all cores)
+  CACHE_DAYS=N      Drop incremental cache entries unused for N days (default: 14)
+  KAIN_BENCH_RUNS=N Override the run count of every benchmark
 
 ${CYAN}Examples:${NC}
   ./build.sh                     # Full build
   DEBUG=1 ./build.sh native      # Native build with debug output
+  ./build.sh incremental         # Fast rebuild after editing src/
   ./build.sh test                # Run tests
 
 EOF
@@ -571,6 +940,10 @@ main() {
             build_runtime
             build_native
             ;;
+        incremental|inc)
+            check_prerequisites
+            build_incremental
+            ;;
         runtime)
             check_prerequisites
             build_runtime
@@ -580,6 +953,11 @@ main() {
             build_runtime
             run_tests
             ;;
+        bench)
+            check_prerequisites
+            build_runtime
+            run_benchmarks
+            ;;
         clean)
             do_clean
             ;;
@@ -8,181 +8,252 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <malloc.h>
+#include <setjmp.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#define sleep kain_posix_sleep // unistd's sleep() clashes with the Kain builtin
+#include <unistd.h>
+#undef sleep
+#endif
+
+#include "kain_runtime.h"
 
+// RAW POINTER STRING HANDLING
+// Heuristic: values >= 0x10000000000 (64GB) are likely pointers, not small
+// integers TEXT segment pointers are typically in 0x7FF... range (Windows) Heap
+// pointers are typically in 0x1xx... - 0x3xx... range
+#define LIKELY_POINTER_MIN                                                     \
+  0x10000000000ULL // 64GB - very unlikely to be an integer
 
-// =============================================================================
-// NaN-Boxing Type System
-// =============================================================================
-//
-// We use NaN-boxing to encode multiple types in a single 64-bit value.
-// IEEE 754 doubles have many "quiet NaN" bit patterns we can hijack.
-//
-// Bit layout:
-//   Float:  Any value < NANBOX_QNAN is a valid IEEE 754 double (unboxed)
-//   Tagged: [0xFFF8 prefix (16 bits)][tag (3 bits)][payload (45 bits)]
-//
-// Type tags (3 bits):
-//   0 = Pointer (heap object, 45-bit address space = 32TB)
-//   1 = Integer (signed 45-bit, range: ±17.5 trillion)
-//   2 = Boolean (payload = 0 or 1)
-//   3 = Null/Unit
-//   4-7 = Reserved for future types
-//
-// References: V8, LuaJIT, SpiderMonkey, JavaScriptCore, Koka
-// =============================================================================
-
-// Quiet NaN prefix - any value >= this is a tagged value, not a double
-#define NANBOX_QNAN 0xFFF8000000000000ULL
-
-// Type tag shifts and masks
-#define NANBOX_TAG_SHIFT 45
-#define NANBOX_PAYLOAD_MASK 0x00001FFFFFFFFFFFULL // 45 bits
-
-// Type tags (stored in bits 45-47)
-#define kain_TAG_PTR 0ULL
-#define kain_TAG_INT 1ULL
-#define kain_TAG_BOOL 2ULL
-#define kain_TAG_NULL 3ULL
-#define kain_TAG_STR 4ULL // String pointers (for quick type checks)
-
-// === UNIFIED MEMORY MODEL MACROS ===
-// Standardized macros for NaN-boxing to ensure consistency across runtime and
-// codegen
-#define kain_BOX_PTR(ptr) (NANBOX_QNAN | (((uint64_t)(ptr)) >> 3))
-#define kain_UNBOX_PTR(val) ((void *)(((val) & NANBOX_PAYLOAD_MASK) << 3))
-// Box string: QNAN | (TAG << 45) | (ptr >> 3)
-#define kain_BOX_STR(ptr)                                                      \
-  ((NANBOX_QNAN | (kain_TAG_STR << NANBOX_TAG_SHIFT)) |                        \
-   (((uint64_t)(ptr)) >> 3))
-// Unbox string: (val & PAYLOAD_MASK) << 3
-#define kain_UNBOX_STR(val) ((const char *)(((val) & NANBOX_PAYLOAD_MASK) << 3))
-// Check string: (val & PREFIX_MASK) == STR_PREFIX
-#define kain_IS_STR(val)                                                       \
-  (((val) & (NANBOX_QNAN | (7ULL << NANBOX_TAG_SHIFT))) ==                     \
-   (NANBOX_QNAN | (kain_TAG_STR << NANBOX_TAG_SHIFT)))
+// Untagged words that V1 code passes as strings. User-space addresses stay
+// below 2^48; anything between that and QNAN is a Float. Strict NaN-box
+// builds (see kain_runtime.h) never guess, so these fold to 0 and the
+// branches vanish.
+#define KAIN_V1_PTR_END (1ULL << 48)
+#ifdef KAIN_STRICT_NANBOX
+#define KAIN_V1_RAW_PTR(v) 0
+#define KAIN_V1_LIKELY_PTR(v) 0
+#else
+#define KAIN_V1_RAW_PTR(v) ((v) < KAIN_V1_PTR_END && (v) > 0x10000)
+#define KAIN_V1_LIKELY_PTR(v) ((v) < KAIN_V1_PTR_END && (v) > LIKELY_POINTER_MIN)
+#endif
+
+// Rarely-taken error paths: keep them out of the hot functions' bodies
+#if defined(__GNUC__) || defined(__clang__)
+#define KAIN_COLD __attribute__((cold, noinline, noreturn))
+#elif defined(_MSC_VER)
+#define KAIN_COLD __declspec(noinline) __declspec(noreturn)
+#else
+#define KAIN_COLD
+#endif
 
 void kain_print_stack_trace(void);
 
-// Sentinel values
-#define kain_NULL (NANBOX_QNAN | (kain_TAG_NULL << NANBOX_TAG_SHIFT))
-#define kain_TRUE (NANBOX_QNAN | (kain_TAG_BOOL << NANBOX_TAG_SHIFT) | 1)
-#define kain_FALSE (NANBOX_QNAN | (kain_TAG_BOOL << NANBOX_TAG_SHIFT) | 0)
-
-// === Type Checking ===
-
-static inline int kain_is_double(uint64_t v) { return v < NANBOX_QNAN; }
-
-static inline int kain_is_tagged(uint64_t v) { return v >= NANBOX_QNAN; }
-
-static inline uint64_t kain_get_tag(uint64_t v) {
-  if (v == 0)
-    return kain_TAG_NULL; // Treat 0 as Null
-  if (v < NANBOX_QNAN) {
-    // TRANSITION HACK: If the value is small (e.g. < 1 million),
-    // it's almost certainly a raw integer from the V1 compiler.
-    if (v < 0x0010000000000000ULL)
-      return kain_TAG_INT;
-    return (uint64_t)-1; // -1 = double
-  }
-  return (v >> NANBOX_TAG_SHIFT) & 0x7;
-}
+// =============================================================================
+// Threads (portability layer)
+// =============================================================================
+//
+// Per-thread runtime state (arena, trace stack, debug counters) is KAIN_TLS.
+// The few shared tables (interned strings, the stdout buffer) take a lock,
+// but only once kain_threaded is set, by the first spawn or by an embedder's
+// kain_enable_threads(), so single-threaded programs never touch a mutex.
+// =============================================================================
 
-static inline int kain_is_ptr(uint64_t v) {
-  if (v == 0)
-    return 0;
-  if (v < NANBOX_QNAN)
-    return v > 0x10000; // V1 Pointer
-  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_PTR &&
-         (v & NANBOX_QNAN) == NANBOX_QNAN;
-}
+#if defined(_MSC_VER) && !defined(__clang__)
+#define KAIN_TLS __declspec(thread)
+#else
+#define KAIN_TLS _Thread_local
+#endif
+
+#ifdef _WIN32
+typedef SRWLOCK kain_mutex_t;
+typedef CONDITION_VARIABLE kain_cond_t;
+typedef HANDLE kain_thread_t;
+#define KAIN_MUTEX_INIT SRWLOCK_INIT
+#define KAIN_COND_INIT CONDITION_VARIABLE_INIT
+#define kain_mutex_lock(m) AcquireSRWLockExclusive(m)
+#define kain_mutex_unlock(m) ReleaseSRWLockExclusive(m)
+#define kain_cond_wait(c, m) SleepConditionVariableSRW(c, m, INFINITE, 0)
+#define kain_cond_broadcast(c) WakeAllConditionVariable(c)
+#define kain_atomic_load(p) (*(volatile int *)(p))
+#define kain_atomic_store(p, v) (*(volatile int *)(p) = (v))
+#define kain_atomic_load_ptr(p) (*(void *volatile *)(p))
+#define kain_atomic_add_size(p, v)                                             \
+  ((size_t)InterlockedExchangeAdd64((volatile LONG64 *)(p), (LONG64)(v)) +     \
+   (size_t)(v))
+#define kain_atomic_cas_ptr(p, expected, desired)                              \
+  (InterlockedCompareExchangePointer((PVOID volatile *)(p), desired,           \
+                                     expected) == (expected))
+#define kain_atomic_xchg_ptr(p, v)                                             \
+  InterlockedExchangePointer((PVOID volatile *)(p), v)
+#else
+typedef pthread_mutex_t kain_mutex_t;
+typedef pthread_cond_t kain_cond_t;
+typedef pthread_t kain_thread_t;
+#define KAIN_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+#define KAIN_COND_INIT PTHREAD_COND_INITIALIZER
+#define kain_mutex_lock(m) pthread_mutex_lock(m)
+#define kain_mutex_unlock(m) pthread_mutex_unlock(m)
+#define kain_cond_wait(c, m) pthread_cond_wait(c, m)
+#define kain_cond_broadcast(c) pthread_cond_broadcast(c)
+#define kain_atomic_load(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define kain_atomic_store(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define kain_atomic_load_ptr(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define kain_atomic_add_size(p, v)                                             \
+  __atomic_add_fetch(p, (size_t)(v), __ATOMIC_RELAXED)
+#define kain_atomic_cas_ptr(p, expected, desired)                              \
+  __atomic_compare_exchange_n(p, &(expected), desired, 0, __ATOMIC_RELEASE,    \
+                              __ATOMIC_RELAXED)
+#define kain_atomic_xchg_ptr(p, v) __atomic_exchange_n(p, v, __ATOMIC_ACQUIRE)
+#endif
+
+static int kain_threaded = 0; // Set once, before the first worker starts
+
+#define KAIN_SHARED_LOCK(m)                                                    \
+  do {                                                                         \
+    if (kain_threaded)                                                         \
+      kain_mutex_lock(m);                                                      \
+  } while (0)
+#define KAIN_SHARED_UNLOCK(m)                                                  \
+  do {                                                                         \
+    if (kain_threaded)                                                         \
+      kain_mutex_unlock(m);                                                    \
+  } while (0)
 
-static inline int kain_is_string(uint64_t v) {
-  if (v == 0)
-    return 0;
-  if (v < NANBOX_QNAN)
-    return v > 0x10000; // V1 String
-  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_STR &&
-         (v & NANBOX_QNAN) == NANBOX_QNAN;
-}
+// =============================================================================
+// Profiling (opt-in: build the runtime with -DKAIN_PROFILE)
+// =============================================================================
+//
+// Counts calls per builtin, allocations and bytes per kind, map probes,
+// buffer growth and string copies, and prints a report to stderr at exit or
+// whenever the program calls kain_profile_dump(). Every hook is a macro that
+// expands to nothing in normal builds. Counters are relaxed atomics, so
+// totals stay exact once worker threads run.
+// =============================================================================
 
-static inline int kain_is_int(uint64_t v) {
-  if (v < NANBOX_QNAN)
-    return v < 0x0010000000000000ULL;
-  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_INT &&
-         (v & NANBOX_QNAN) == NANBOX_QNAN;
-}
+enum {
+  KAIN_PROF_MAP_LOOKUPS,    // map_find_in calls
+  KAIN_PROF_MAP_PROBES,     // Slots inspected by them
+  KAIN_PROF_GROWTHS,        // Buffers reallocated to grow (arrays, maps, ...)
+  KAIN_PROF_STR_COPIES,     // Strings created by copying bytes
+  KAIN_PROF_STR_COPY_BYTES,
+  KAIN_PROF_EVENT_COUNT
+};
 
-static inline int kain_is_bool(uint64_t v) {
-  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_BOOL;
-}
+#define KAIN_PROF_KINDS 5 // Allocation kinds: KAIN_GC_RAW .. KAIN_GC_OBJ
 
-static inline int kain_is_null(uint64_t v) {
-  if (v == 0)
-    return 1;
-  if (v < NANBOX_QNAN)
-    return 0;
-  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_NULL;
-}
+#ifdef KAIN_PROFILE
 
-// === Boxing (Kain -> NaN-box) ===
+typedef struct KainProfSite {
+  const char *name;
+  size_t calls;
+  void *claimed; // Set by whichever call links the site first
+  struct KainProfSite *next;
+} KainProfSite;
 
-static inline uint64_t kain_box_double(double d) {
-  uint64_t bits;
-  memcpy(&bits, &d, sizeof(double));
-  return bits;
-}
+static KainProfSite *kain_prof_sites = NULL; // Every builtin called so far
+static size_t kain_prof_events[KAIN_PROF_EVENT_COUNT];
+static size_t kain_prof_objects[KAIN_PROF_KINDS];
+static size_t kain_prof_bytes[KAIN_PROF_KINDS];
 
-static inline uint64_t kain_box_ptr(void *p) {
-  if (p == NULL)
-    return 0;
-  return kain_BOX_PTR(p);
-}
+static void kain_profile_at_exit(void) { kain_profile_dump(); }
 
-static inline uint64_t kain_box_string(const char *s) {
-  return kain_BOX_STR(s);
+static void kain_prof_link(KainProfSite *site) {
+  if (kain_atomic_xchg_ptr(&site->claimed, (void *)site))
+    return;
+  KainProfSite *head;
+  do {
+    head = (KainProfSite *)kain_atomic_load_ptr(&kain_prof_sites);
+    site->next = head;
+  } while (!kain_atomic_cas_ptr(&kain_prof_sites, head, site));
+  // The first site ever linked arranges the report
+  if (!head)
+    atexit(kain_profile_at_exit);
 }
 
-static inline uint64_t kain_box_int(int64_t n) {
-  // Apply NaN-boxing: QNAN | (TAG_INT << 45) | (value & PAYLOAD_MASK)
-  return NANBOX_QNAN | (kain_TAG_INT << NANBOX_TAG_SHIFT) |
-         ((uint64_t)n & NANBOX_PAYLOAD_MASK);
+static inline void kain_prof_hit(KainProfSite *site) {
+  if (kain_atomic_add_size(&site->calls, 1) == 1)
+    kain_prof_link(site);
 }
 
-static inline uint64_t kain_box_bool(int b) {
-  return b ? kain_TRUE : kain_FALSE;
+#define KAIN_PROFILE_CALL()                                                    \
+  static KainProfSite kain_prof_site = {__func__, 0, NULL, NULL};              \
+  kain_prof_hit(&kain_prof_site)
+#define KAIN_PROFILE_COUNT(event, n)                                           \
+  ((void)kain_atomic_add_size(&kain_prof_events[event], (n)))
+#define KAIN_PROFILE_ALLOC(kind, size)                                         \
+  ((void)kain_atomic_add_size(&kain_prof_objects[kind], 1),                    \
+   (void)kain_atomic_add_size(&kain_prof_bytes[kind], (size)))
+
+#else
+#define KAIN_PROFILE_CALL() ((void)0)
+#define KAIN_PROFILE_COUNT(event, n) ((void)0)
+#define KAIN_PROFILE_ALLOC(kind, size) ((void)0)
+#endif
+
+// Header in front of every kain_TAG_STR payload (see "String Storage" below)
+typedef struct {
+  int64_t len; // Bytes, excluding the NUL terminator
+  union {
+    int64_t cap;      // Usable bytes after the header, excluding the terminator
+    const char *base; // KAIN_STR_VIEW: first byte of the borrowed range
+  };
+  uint64_t hash; // FNV-1a of the bytes, 0 until first requested
+  uint64_t flags;
+} KainStrHeader;
+
+// KainStrHeader.flags
+#define KAIN_STR_INTERNED 1ULL // Unique per content, compare by pointer
+#define KAIN_STR_VIEW 2ULL     // Borrowed range of another string's bytes
+#define KAIN_STR_VIEW_CSTR 4ULL // View whose base is now a NUL-terminated copy
+#define KAIN_STR_VOLATILE 16ULL // View over a buffer its owner reuses
+
+static inline KainStrHeader *kain_str_header(const char *s) {
+  return ((KainStrHeader *)s) - 1;
 }
 
-static inline uint64_t kain_box_null(void) { return kain_NULL; }
-
-// === Unboxing (NaN-box -> Kain) ===
-
-static inline double kain_unbox_double(uint64_t v) {
-  double d;
-  memcpy(&d, &v, sizeof(double));
-  return d;
-}
+const char *kain_str_view_cstr(KainStrHeader *hdr);
 
-static inline void *kain_unbox_ptr(uint64_t v) {
-  if (v == 0)
-    return NULL;
-  return kain_UNBOX_PTR(v);
+// NUL-terminated bytes of a runtime string, materializing views on demand
+static inline const char *kain_str_cstr(const char *s) {
+  KainStrHeader *hdr = kain_str_header(s);
+  if (!(hdr->flags & KAIN_STR_VIEW))
+    return s;
+  return kain_str_view_cstr(hdr);
 }
 
 static inline const char *kain_unbox_string(uint64_t v) {
   if (kain_IS_STR(v)) {
-    return kain_UNBOX_STR(v);
+    const char *s = kain_UNBOX_STR(v);
+    return s ? kain_str_cstr(s) : NULL;
   }
   // Fallback for raw pointers (transition period)
-  if (v < NANBOX_QNAN && v > 0x10000)
+  if (KAIN_V1_RAW_PTR(v))
     return (const char *)v;
   return NULL;
 }
 
+static void *kain_range_array(uint64_t v);
+
 // Robust unboxing that handles both tagged and raw pointers
 void *kain_unbox_any_ptr(int64_t val) {
   uint64_t v = (uint64_t)val;
@@ -192,9 +263,16 @@ void *kain_unbox_any_ptr(int64_t val) {
   // Check if it's explicitly tagged as a pointer or string
   if (v >= NANBOX_QNAN) {
     uint64_t tag = (v >> NANBOX_TAG_SHIFT) & 0x7;
-    if (tag == kain_TAG_PTR || tag == kain_TAG_STR) {
+    if (tag == kain_TAG_PTR)
       return kain_UNBOX_PTR(v);
+    if (tag == kain_TAG_STR) {
+      // Callers want a C string; views are copied out on first use
+      const char *s = kain_UNBOX_STR(v);
+      return s ? (void *)kain_str_cstr(s) : NULL;
     }
+    // Lazy ranges become a real array the first time one is needed
+    if (tag == kain_TAG_OBJ)
+      return kain_range_array(v);
     // If it's tagged as something else (Int/Bool/Null), it's NOT a pointer!
     return NULL;
   }
@@ -203,29 +281,54 @@ void *kain_unbox_any_ptr(int64_t val) {
   return (void *)v;
 }
 
+// Every kain_TAG_OBJ payload starts with this header
+typedef struct {
+  uint32_t kind;
+  uint32_t flags;
+} KainObjHeader;
+
+#define KAIN_OBJ_BUILDER 1
+#define KAIN_OBJ_BYTE_ITER 2
+#define KAIN_OBJ_READER 3
+#define KAIN_OBJ_RANGE 4
+#define KAIN_OBJ_I64_ARRAY 5
+#define KAIN_OBJ_F64_ARRAY 6
+#define KAIN_OBJ_U8_ARRAY 7
+#define KAIN_OBJ_TASK 8
+#define KAIN_OBJ_ENUM_NAMES 9
+#define KAIN_OBJ_WRITER 10
+
+static inline void *kain_unbox_obj(uint64_t v, uint32_t kind) {
+  if (!kain_IS_OBJ(v))
+    return NULL;
+  KainObjHeader *obj = (KainObjHeader *)kain_UNBOX_PTR(v);
+  return obj && obj->kind == kind ? obj : NULL;
+}
+
 // Forward declaration for kain_to_string (used in kain_add_op before
 // definition)
 int64_t kain_to_string(int64_t val);
 
-static inline int64_t kain_unbox_int(uint64_t v) {
-  // Sign-extend from 45 bits
-  int64_t raw = (int64_t)(v & NANBOX_PAYLOAD_MASK);
-  // If bit 44 is set, extend the sign
-  if (raw & (1ULL << 44)) {
-    raw |= 0xFFFFE00000000000LL; // Set upper bits for negative
-  }
-  return raw;
-}
-
-static inline int kain_unbox_bool(uint64_t v) {
-  return (v & NANBOX_PAYLOAD_MASK) != 0;
-}
-
 // Check if a value is "truthy" for condition checks
 // Handles both NaN-boxed and legacy raw values
 int64_t kain_is_truthy(int64_t val) {
+  KAIN_PROFILE_CALL();
   uint64_t v = (uint64_t)val;
 
+#ifdef KAIN_STRICT_NANBOX
+  switch (kain_get_tag(v)) {
+  case kain_TAG_INT:
+  case kain_TAG_BOOL:
+    return (v & NANBOX_PAYLOAD_MASK) != 0;
+  case kain_TAG_NULL:
+    return 0;
+  case KAIN_TAG_DOUBLE:
+    return kain_unbox_double(v) != 0.0;
+  default:
+    return 1; // Strings, pointers and runtime objects
+  }
+#endif
+
   // CRITICAL FIX: Handle raw booleans (1/0) from comparison ops FIRST
   // Comparison operators return raw 1/0, not tagged booleans
   if (v == 1)
@@ -268,38 +371,28 @@ void kain_set_args(int argc, char **argv) {
 
 // ... existing code ...
 
-// =============================================================================
-// Print Functions
-// =============================================================================
-
-int64_t kain_print_i64(int64_t value) {
-  // Auto-unbox NaN-boxed integers
-  int64_t to_print;
-  if (kain_is_int((uint64_t)value)) {
-    to_print = kain_unbox_int((uint64_t)value);
-  } else {
-    to_print = value; // Already raw or unknown
-  }
-  printf("%lld\n", (long long)to_print);
-  return 0;
-}
-
-int64_t kain_print_str(int64_t val) {
-  const char *str = (const char *)kain_unbox_any_ptr(val);
-  printf("%s", str ? str : "(null)");
-  return 0;
-}
-
-int64_t kain_println_str(int64_t val) {
-  kain_print_str(val);
-  printf("\n");
-  fflush(stdout);
-  return 0;
-}
-
 // =============================================================================
 // Memory Management (Paged Arena Allocator)
 // =============================================================================
+//
+// Small requests are bump-allocated out of PAGE_SIZE pages; anything larger
+// than ARENA_LARGE_THRESHOLD gets a dedicated page so it doesn't waste the
+// tail of the current one. Every returned pointer is 8-byte aligned because
+// kain_BOX_PTR / kain_BOX_STR drop the low 3 bits.
+//
+// Normal pages form a stack (current_page is the newest, ->next is older),
+// large pages form a second stack. A mark records the top of both, so
+// rewinding is O(pages released) and never touches individual objects.
+//
+// All of this state is per thread. Objects may still be handed to other
+// threads: pages are only released by their owner's rewind/reset.
+//
+// Spare pages beyond a thread's own small cache go to a global lock-free
+// pool, so a thread that releases memory feeds the one that needs it next.
+// Pushes are a CAS loop. Takers swap out the whole list and keep what they
+// need, which sidesteps the ABA problem of single-node pops. The memory
+// limit is enforced on the bytes all threads hold in pages.
+// =============================================================================
 
 typedef struct ArenaPage {
   struct ArenaPage *next;
@@ -308,1623 +401,6592 @@ typedef struct ArenaPage {
   size_t capacity;
 } ArenaPage;
 
-static ArenaPage *head_page = NULL;
-static ArenaPage *current_page = NULL;
+static KAIN_TLS ArenaPage *head_page = NULL;    // Oldest normal page (never released)
+static KAIN_TLS ArenaPage *current_page = NULL; // Newest normal page (bump target)
+static KAIN_TLS ArenaPage *large_pages = NULL;  // Newest large-object page
+static KAIN_TLS ArenaPage *spare_pages = NULL;  // Released normal pages kept for reuse
+static KAIN_TLS int spare_page_count = 0;
 
 #define PAGE_SIZE (1 * 1024 * 1024) // 1MB pages
+#define ARENA_ALIGN 8
+#define ARENA_LARGE_THRESHOLD (PAGE_SIZE / 4)
+#define ARENA_MAX_SPARE_PAGES 4
 
-static size_t total_allocated = 0;
+static KAIN_TLS size_t total_allocated = 0;
 #define MAX_MEMORY_USAGE (16ULL * 1024 * 1024 * 1024) // 16GB Limit
 
-void *arena_alloc(size_t size) {
-  void *p = malloc(size);
-  if (!p) {
-    fprintf(stderr,
-            "FATAL: Out of memory in arena_alloc (requested %zu bytes)\n",
-            size);
-    exit(1);
-  }
-  return p;
-}
+#define ARENA_MAX_POOL_PAGES 64
+static ArenaPage *page_pool = NULL; // Global spare pages (lock-free stack)
+static size_t page_pool_count = 0;  // Approximate, only bounds the pool
+static size_t heap_page_bytes = 0;  // Bytes in arena pages, all threads
 
-// Global allocator wrapper - Returns RAW pointer for bootstrap compatibility
-void *kain_alloc(int64_t size) { return arena_alloc((size_t)size); }
+// Snapshot of the arena top, see arena_mark() / arena_rewind()
+typedef struct {
+  ArenaPage *page;
+  size_t used;
+  ArenaPage *large;
+  size_t total;
+  size_t owned; // region_owned entries at the mark
+} ArenaMark;
+
+static void arena_oom(const char *what, size_t size) {
+  fprintf(stderr, "FATAL: %s in arena_alloc (requested %zu bytes, %zu in use)\n",
+          what, size, total_allocated);
+  exit(1);
+}
 
-void kain_free(void *ptr) {
-  // No-op: Arena memory is freed when the process exits
+static void arena_free_page(ArenaPage *page) {
+  kain_atomic_add_size(&heap_page_bytes, 0 - page->capacity);
+  free(page);
 }
 
-char *kain_str_new(const char *str) {
-  if (!str)
-    return NULL;
-  size_t len = strlen(str);
+static ArenaPage *arena_new_page(size_t capacity) {
+  if (kain_atomic_add_size(&heap_page_bytes, capacity) > MAX_MEMORY_USAGE) {
+    kain_atomic_add_size(&heap_page_bytes, 0 - capacity);
+    arena_oom("Memory limit exceeded", capacity);
+  }
+  // Header and data share one malloc; sizeof(ArenaPage) keeps data aligned
+  ArenaPage *page = (ArenaPage *)malloc(sizeof(ArenaPage) + capacity);
+  if (!page)
+    arena_oom("Out of memory", capacity);
+  page->next = NULL;
+  page->data = (char *)(page + 1);
+  page->used = 0;
+  page->capacity = capacity;
+  return page;
+}
 
-  char *result = _strdup(str);
+static void page_pool_push(ArenaPage *page) {
+  ArenaPage *head;
+  do {
+    head = (ArenaPage *)kain_atomic_load_ptr(&page_pool);
+    page->next = head;
+  } while (!kain_atomic_cas_ptr(&page_pool, head, page));
+}
 
-  if (!result) {
-    fprintf(stderr,
-            "FATAL: Out of memory in kain_str_new (requested %zu bytes)\n",
-            len + 1);
-    exit(1);
+// Refill the thread's spare cache from the global pool
+static void page_pool_take_all(void) {
+  ArenaPage *list = (ArenaPage *)kain_atomic_xchg_ptr(&page_pool, NULL);
+  while (list) {
+    ArenaPage *next = list->next;
+    kain_atomic_add_size(&page_pool_count, (size_t)-1);
+    if (spare_page_count < ARENA_MAX_SPARE_PAGES) {
+      list->next = spare_pages;
+      spare_pages = list;
+      spare_page_count++;
+    } else {
+      kain_atomic_add_size(&page_pool_count, 1);
+      page_pool_push(list);
+    }
+    list = next;
   }
-  return result;
 }
 
-char *kain_str_concat(const char *a, const char *b) {
-  if (!a)
-    a = "";
-  if (!b)
-    b = "";
-
-  size_t len_a = strlen(a);
-  size_t len_b = strlen(b);
-  char *result = (char *)kain_alloc(len_a + len_b + 1);
-  memcpy(result, a, len_a);
-  memcpy(result + len_a, b, len_b);
-  result[len_a + len_b] = '\0';
-  return result;
+static ArenaPage *arena_take_page(void) {
+  if (!spare_pages && kain_atomic_load_ptr(&page_pool))
+    page_pool_take_all();
+  if (spare_pages) {
+    ArenaPage *page = spare_pages;
+    spare_pages = page->next;
+    spare_page_count--;
+    page->next = NULL;
+    page->used = 0;
+    return page;
+  }
+  return arena_new_page(PAGE_SIZE);
 }
 
-// NaN-boxing aware string concat - accepts boxed values, returns boxed value
-int64_t kain_str_concat_boxed(int64_t a_val, int64_t b_val) {
-  const char *a = (const char *)kain_unbox_any_ptr(a_val);
-  const char *b = (const char *)kain_unbox_any_ptr(b_val);
+static void page_pool_give(ArenaPage *page) {
+  if (kain_atomic_add_size(&page_pool_count, 1) <= ARENA_MAX_POOL_PAGES) {
+    page_pool_push(page);
+  } else {
+    kain_atomic_add_size(&page_pool_count, (size_t)-1);
+    arena_free_page(page);
+  }
+}
 
-  char *result = kain_str_concat(a, b);
-  return (int64_t)kain_box_string(result);
+static void arena_give_page(ArenaPage *page) {
+  if (spare_page_count < ARENA_MAX_SPARE_PAGES) {
+    page->next = spare_pages;
+    spare_pages = page;
+    spare_page_count++;
+  } else {
+    page_pool_give(page);
+  }
 }
 
-int64_t kain_str_starts_with(int64_t str_val, int64_t prefix_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  const char *prefix = kain_is_string((uint64_t)prefix_val)
-                           ? kain_unbox_string((uint64_t)prefix_val)
-                           : (const char *)prefix_val;
-  if (!str || !prefix)
-    return (int64_t)kain_box_bool(0);
-  size_t len_str = strlen(str);
-  size_t len_prefix = strlen(prefix);
-  if (len_prefix > len_str)
-    return (int64_t)kain_box_bool(0);
-  return (int64_t)kain_box_bool(strncmp(str, prefix, len_prefix) == 0);
+// -----------------------------------------------------------------------------
+// Collected heap (KAIN_GC builds)
+// -----------------------------------------------------------------------------
+//
+// Building with -DKAIN_GC replaces the arena with individually malloc'd
+// blocks that a mark-sweep collector reclaims (see "Garbage Collector" near
+// the end of this file). Each block carries a KainGcHeader in front of the
+// payload recording how to trace it, and every live payload is in a hash set
+// so a word can be checked for "is this a block" exactly, without guessing
+// from its magnitude. Marks and regions still work but release nothing.
+// -----------------------------------------------------------------------------
+
+// How a block's payload is traced
+#define KAIN_GC_RAW 0   // Slots of boxed values (structs, tuples, options)
+#define KAIN_GC_LEAF 1  // No references (string bytes)
+#define KAIN_GC_ARRAY 2 // KainArray: elements live in its malloc'd buffer
+#define KAIN_GC_MAP 3   // KainMap: keys and values live in its entry tables
+#define KAIN_GC_OBJ 4   // KainObjHeader object, finalized by its kind
+
+#ifdef KAIN_GC
+
+#ifndef KAIN_GC_MIN_HEAP
+#define KAIN_GC_MIN_HEAP (8 * 1024 * 1024) // Bytes allocated before the 1st GC
+#endif
+
+typedef struct {
+  size_t size;   // Payload bytes
+  uint32_t kind; // KAIN_GC_*
+  uint32_t mark;
+} KainGcHeader;
+
+static void **gc_blocks = NULL; // Open-addressed set of block payloads
+static size_t gc_block_cap = 0;
+static size_t gc_block_count = 0;
+static uintptr_t gc_lo = UINTPTR_MAX, gc_hi = 0; // Payload address bounds
+static size_t gc_live_bytes = 0;  // Payload bytes after the last sweep
+static size_t gc_alloc_bytes = 0; // Payload bytes allocated since then
+static size_t gc_total_bytes = 0; // Payload bytes allocated, never reset
+static size_t gc_threshold = KAIN_GC_MIN_HEAP;
+static kain_mutex_t gc_lock = KAIN_MUTEX_INIT; // Block set, once threaded
+
+static void kain_gc_maybe_collect(void);
+
+static inline KainGcHeader *gc_header(void *p) { return (KainGcHeader *)p - 1; }
+
+static inline size_t gc_slot(uintptr_t p, size_t cap) {
+  uint64_t h = (uint64_t)(p >> 3) * 0x9E3779B97F4A7C15ULL;
+  return (size_t)(h >> 32) & (cap - 1);
 }
 
-int64_t kain_str_replace(int64_t str_val, int64_t old_val, int64_t new_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  const char *old_sub = kain_is_string((uint64_t)old_val)
-                            ? kain_unbox_string((uint64_t)old_val)
-                            : (const char *)old_val;
-  const char *new_sub = kain_is_string((uint64_t)new_val)
-                            ? kain_unbox_string((uint64_t)new_val)
-                            : (const char *)new_val;
-
-  if (!str || !old_sub || !new_sub)
-    return (int64_t)kain_box_string(kain_str_new(""));
-  size_t str_len = strlen(str);
-  size_t old_len = strlen(old_sub);
-  size_t new_len = strlen(new_sub);
-  if (old_len == 0)
-    return (int64_t)kain_box_string(kain_str_new(str));
-
-  int count = 0;
-  const char *tmp = str;
-  while ((tmp = strstr(tmp, old_sub))) {
-    count++;
-    tmp += old_len;
-  }
+static void gc_table_insert(void **table, size_t cap, void *p) {
+  size_t i = gc_slot((uintptr_t)p, cap);
+  while (table[i])
+    i = (i + 1) & (cap - 1);
+  table[i] = p;
+}
 
-  size_t result_len = str_len + count * (new_len - old_len);
-  char *result = (char *)arena_alloc(result_len + 1);
-  char *dst = result;
-  const char *src = str;
-  while (1) {
-    const char *p = strstr(src, old_sub);
-    if (!p) {
-      strcpy(dst, src);
-      break;
-    }
-    size_t segment_len = p - src;
-    memcpy(dst, src, segment_len);
-    dst += segment_len;
-    memcpy(dst, new_sub, new_len);
-    dst += new_len;
-    src = p + old_len;
+static void **gc_table_new(size_t cap) {
+  void **table = (void **)calloc(cap, sizeof(void *));
+  if (!table) {
+    fprintf(stderr, "FATAL: OOM in the GC block table (%zu slots)\n", cap);
+    exit(1);
   }
-  return (int64_t)kain_box_string(result);
+  return table;
 }
 
-int64_t kain_str_len(int64_t str_val) {
-  if (str_val == 0)
-    return (int64_t)kain_box_int(0);
+static void gc_table_grow(void) {
+  size_t cap = gc_block_cap ? gc_block_cap * 2 : 1024;
+  void **table = gc_table_new(cap);
+  for (size_t i = 0; i < gc_block_cap; i++)
+    if (gc_blocks[i])
+      gc_table_insert(table, cap, gc_blocks[i]);
+  free(gc_blocks);
+  gc_blocks = table;
+  gc_block_cap = cap;
+}
 
-  // Auto-unbox NaN-boxed string
-  const char *str;
-  if (kain_is_string((uint64_t)str_val)) {
-    str = kain_unbox_string((uint64_t)str_val);
-  } else {
-    str = (const char *)str_val;
+// The payload starting exactly at `p`, or NULL if there is none
+static inline void *gc_find(uintptr_t p) {
+  if (p < gc_lo || p > gc_hi || (p & (ARENA_ALIGN - 1)))
+    return NULL;
+  size_t i = gc_slot(p, gc_block_cap);
+  while (gc_blocks[i]) {
+    if ((uintptr_t)gc_blocks[i] == p)
+      return gc_blocks[i];
+    i = (i + 1) & (gc_block_cap - 1);
   }
+  return NULL;
+}
 
-  return (int64_t)kain_box_int(strlen(str));
+static void *gc_alloc(size_t size, uint32_t kind) {
+  if (!kain_threaded && gc_alloc_bytes >= gc_threshold)
+    kain_gc_maybe_collect();
+  KainGcHeader *h = (KainGcHeader *)malloc(sizeof(KainGcHeader) + size);
+  if (!h)
+    arena_oom("Out of memory", size);
+  h->size = size;
+  h->kind = kind;
+  h->mark = 0;
+  void *p = h + 1;
+  // Strings are filled in by the caller; anything traced starts out zeroed
+  // so a collection never reads stale words as references
+  if (kind != KAIN_GC_LEAF)
+    memset(p, 0, size);
+
+  KAIN_SHARED_LOCK(&gc_lock);
+  if (size > MAX_MEMORY_USAGE - gc_live_bytes - gc_alloc_bytes)
+    arena_oom("Memory limit exceeded", size);
+  if ((gc_block_count + 1) * 2 > gc_block_cap)
+    gc_table_grow();
+  gc_table_insert(gc_blocks, gc_block_cap, p);
+  gc_block_count++;
+  if ((uintptr_t)p < gc_lo)
+    gc_lo = (uintptr_t)p;
+  if ((uintptr_t)p > gc_hi)
+    gc_hi = (uintptr_t)p;
+  gc_alloc_bytes += size;
+  gc_total_bytes += size;
+  KAIN_SHARED_UNLOCK(&gc_lock);
+  return p;
 }
 
-static int str_eq_count = 0;
-int64_t kain_str_eq(int64_t a_val, int64_t b_val) {
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
+#define arena_alloc_as(size, kind)                                             \
+  (KAIN_PROFILE_ALLOC(kind, size), gc_alloc((size_t)(size), kind))
+#else
+#define arena_alloc_as(size, kind)                                             \
+  (KAIN_PROFILE_ALLOC(kind, size), arena_alloc(size))
+#endif
 
-  // Fast path: bitwise equality
-  if (a_val == b_val) {
-    return kain_TRUE;
+void *arena_alloc(size_t size) {
+#ifdef KAIN_GC
+  return gc_alloc(size ? size : ARENA_ALIGN, KAIN_GC_RAW);
+#endif
+  if (size == 0)
+    size = ARENA_ALIGN;
+  size = (size + (ARENA_ALIGN - 1)) & ~(size_t)(ARENA_ALIGN - 1);
+
+  if (size > MAX_MEMORY_USAGE - total_allocated)
+    arena_oom("Memory limit exceeded", size);
+
+  if (size > ARENA_LARGE_THRESHOLD) {
+    ArenaPage *page = arena_new_page(size);
+    page->used = size;
+    page->next = large_pages;
+    large_pages = page;
+    total_allocated += size;
+    return page->data;
   }
 
-  // NaN-boxing: Check if both are tagged integers
-  if (kain_is_int(a) && kain_is_int(b)) {
-    return kain_unbox_int(a) == kain_unbox_int(b) ? kain_TRUE : kain_FALSE;
+  if (!current_page || current_page->capacity - current_page->used < size) {
+    ArenaPage *page = arena_take_page();
+    page->next = current_page;
+    current_page = page;
+    if (!head_page)
+      head_page = page;
   }
 
-  // NaN-boxing: Check if both are booleans
-  if (kain_is_bool(a) && kain_is_bool(b)) {
-    return kain_unbox_bool(a) == kain_unbox_bool(b) ? kain_TRUE : kain_FALSE;
-  }
+  void *p = current_page->data + current_page->used;
+  current_page->used += size;
+  total_allocated += size;
+  return p;
+}
 
-  // NaN-boxing: Check if both are null
-  if (kain_is_null(a) && kain_is_null(b)) {
-    return kain_TRUE;
-  }
+// Take ownership of a malloc'd page (see kain_builder_finish) so that it is
+// released by arena_rewind/kain_arena_reset like any other large allocation
+static void arena_adopt_large(ArenaPage *page) {
+  if (page->used > MAX_MEMORY_USAGE - total_allocated)
+    arena_oom("Memory limit exceeded", page->used);
+  kain_atomic_add_size(&heap_page_bytes, page->capacity);
+  page->next = large_pages;
+  large_pages = page;
+  total_allocated += page->used;
+}
 
-  // NaN-boxing: Check if both are strings (proper tagged)
-  if (kain_is_string(a) && kain_is_string(b)) {
-    const char *sa = kain_unbox_string(a);
-    const char *sb = kain_unbox_string(b);
-    if (!sa || !sb)
-      return sa == sb ? kain_TRUE : kain_FALSE;
-    return strcmp(sa, sb) == 0 ? kain_TRUE : kain_FALSE;
+// -----------------------------------------------------------------------------
+// Size-class pools
+// -----------------------------------------------------------------------------
+//
+// Fixed-shape objects (array headers, options, box cells, payload tuples,
+// codegen structs) come from per-thread slabs, one size class per slab, so
+// objects of one shape are packed together instead of sitting between
+// strings, and an object known to be dead can be handed out again. Slabs are
+// ordinary arena allocations: marks, regions and resets release them, and
+// arena_rewind() forgets every class's cursor and free list because they may
+// point into released pages.
+// -----------------------------------------------------------------------------
+
+#define SMALL_MAX 64
+#define SMALL_CLASSES 6
+#define SMALL_SLAB_BYTES 4096
+
+typedef struct {
+  char *next; // Bump cursor in the current slab
+  char *end;
+  void *free; // Released objects, linked through their first word
+} SmallClass;
+
+static KAIN_TLS SmallClass small_classes[SMALL_CLASSES];
+
+#ifndef KAIN_GC
+static const uint8_t small_class_size[SMALL_CLASSES] = {8, 16, 24, 32, 48, 64};
+// Class for a request of (bytes + 7) / 8 words
+static const uint8_t small_class_of[SMALL_MAX / 8 + 1] = {0, 0, 1, 2, 3,
+                                                          4, 4, 5, 5};
+
+static void *small_alloc(size_t size) {
+  SmallClass *sc = &small_classes[small_class_of[(size + 7) >> 3]];
+  void *p = sc->free;
+  if (p) {
+    sc->free = *(void **)p;
+    return p;
+  }
+  size_t n = small_class_size[sc - small_classes];
+  if ((size_t)(sc->end - sc->next) < n) {
+    sc->next = (char *)arena_alloc(SMALL_SLAB_BYTES);
+    sc->end = sc->next + SMALL_SLAB_BYTES - SMALL_SLAB_BYTES % n;
   }
+  p = sc->next;
+  sc->next += n;
+  return p;
+}
 
-  // V1 COMPATIBILITY: Try to extract string pointers from V1-style boxing
-  // V1 uses: (ptr >> 3) | STRING_TAG
-  // We can try to undo this if the value looks like it might be V1-boxed
-  const char *str_a = NULL;
-  const char *str_b = NULL;
+// Return an object of `size` bytes nothing refers to any more
+static inline void small_free(void *p, size_t size) {
+  SmallClass *sc = &small_classes[small_class_of[(size + 7) >> 3]];
+  *(void **)p = sc->free;
+  sc->free = p;
+}
 
-  // Check if 'a' looks like a V1-boxed string or raw pointer
-  // V1 COMPATIBILITY: Only try if not already identified as another type
-  if (kain_is_int(a) || kain_is_bool(a) || kain_is_null(a)) {
-    // Skip
-  } else if (a >= NANBOX_QNAN) {
-    uint64_t payload = a & NANBOX_PAYLOAD_MASK;
-    str_a = (const char *)(payload << 3);
-  } else if (a > 0x10000 && a < NANBOX_QNAN) {
-    str_a = (const char *)a;
+#define arena_alloc_small(size, kind)                                          \
+  (KAIN_PROFILE_ALLOC(kind, size), small_alloc(size))
+#define arena_free_small(p, size) small_free(p, size)
+#else
+#define arena_alloc_small(size, kind)                                          \
+  (KAIN_PROFILE_ALLOC(kind, size), gc_alloc((size_t)(size), kind))
+#define arena_free_small(p, size) ((void)(p)) // The collector reclaims it
+#endif
+
+// Mark stack behind kain_arena_mark(), see "Regions" below
+static KAIN_TLS ArenaMark *region_marks = NULL;
+static KAIN_TLS int64_t region_depth = 0;
+static KAIN_TLS int64_t region_cap = 0;
+
+// Arrays, maps, builders, readers and typed arrays keep their contents in
+// malloc'd buffers the arena knows nothing about. Those created while a mark
+// is active are recorded here, and rewinding past them frees the buffers
+// too, so a region gives back everything it allocated.
+typedef struct {
+  void *obj;
+  uint32_t kind; // KAIN_GC_ARRAY, KAIN_GC_MAP or KAIN_GC_OBJ
+} RegionOwned;
+
+static KAIN_TLS RegionOwned *region_owned = NULL;
+static KAIN_TLS size_t region_owned_len = 0;
+static KAIN_TLS size_t region_owned_cap = 0;
+
+#ifdef KAIN_GC
+#define region_track(obj, kind) ((void)0) // The collector finalizes them
+#else
+static void region_release_owned(size_t from);
+
+static void region_track_slow(void *obj, uint32_t kind) {
+  if (region_owned_len == region_owned_cap) {
+    size_t new_cap = region_owned_cap ? region_owned_cap * 2 : 256;
+    RegionOwned *owned = (RegionOwned *)realloc(
+        region_owned, new_cap * sizeof(RegionOwned));
+    if (!owned) {
+      fprintf(stderr, "FATAL: OOM in region_track\n");
+      exit(1);
+    }
+    region_owned = owned;
+    region_owned_cap = new_cap;
   }
+  region_owned[region_owned_len].obj = obj;
+  region_owned[region_owned_len].kind = kind;
+  region_owned_len++;
+}
 
-  if (kain_is_int(b) || kain_is_bool(b) || kain_is_null(b)) {
-    // Skip
-  } else if (b >= NANBOX_QNAN) {
-    uint64_t payload = b & NANBOX_PAYLOAD_MASK;
-    str_b = (const char *)(payload << 3);
-  } else if (b > 0x10000 && b < NANBOX_QNAN) {
-    str_b = (const char *)b;
+static inline void region_track(void *obj, uint32_t kind) {
+  if (region_depth > 0)
+    region_track_slow(obj, kind);
+}
+#endif
+
+ArenaMark arena_mark(void) {
+  ArenaMark mark;
+  mark.page = current_page;
+  mark.used = current_page ? current_page->used : 0;
+  mark.large = large_pages;
+  mark.total = total_allocated;
+  mark.owned = region_owned_len;
+  return mark;
+}
+
+// Release everything allocated since `mark`. Pointers handed out after the
+// mark become dangling; pointers from before it stay valid.
+void arena_rewind(ArenaMark mark) {
+#ifndef KAIN_GC
+  region_release_owned(mark.owned); // Reads headers in the pages below
+#endif
+  while (large_pages && large_pages != mark.large) {
+    ArenaPage *next = large_pages->next;
+    arena_free_page(large_pages);
+    large_pages = next;
   }
 
-  // If we got valid-looking string pointers, compare them
-  if (str_a && str_b) {
-    // Sanity check: str_a and str_b should be valid readable pointers
-    // Just do strcmp - if they're garbage pointers, this will crash
-    // which is better than silently returning wrong results
-    int result = strcmp(str_a, str_b) == 0 ? 1 : 0;
-    return result;
+  while (current_page && current_page != mark.page) {
+    ArenaPage *next = current_page->next;
+    if (current_page == head_page) {
+      // Mark predates the first page: keep it as the (empty) bump target
+      current_page->used = 0;
+      break;
+    }
+    arena_give_page(current_page);
+    current_page = next;
   }
+  if (current_page && current_page == mark.page)
+    current_page->used = mark.used;
 
-  // Last resort: if one is null and the other isn't, they're not equal
+  total_allocated = mark.total;
+  memset(small_classes, 0, sizeof(small_classes));
+}
+
+// Whether `p` points into arena memory handed out since `mark`, i.e. memory
+// arena_rewind(mark) would release
+static int arena_since_mark(ArenaMark mark, const void *p) {
+  const char *c = (const char *)p;
+  for (ArenaPage *pg = large_pages; pg && pg != mark.large; pg = pg->next)
+    if (c >= pg->data && c < pg->data + pg->used)
+      return 1;
+  for (ArenaPage *pg = current_page; pg; pg = pg->next) {
+    size_t from = pg == mark.page ? mark.used : 0;
+    if (c >= pg->data + from && c < pg->data + pg->used)
+      return 1;
+    if (pg == mark.page)
+      break;
+  }
   return 0;
 }
 
-int64_t kain_add_op(int64_t a_val, int64_t b_val) {
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
+// Drop every arena allocation at once. The first page is kept so the next
+// allocation doesn't have to go back to malloc.
+void kain_arena_reset(void) {
+  KAIN_PROFILE_CALL();
+  ArenaMark empty = {NULL, 0, NULL, 0, 0};
+  arena_rewind(empty);
+  region_depth = 0;
+}
 
-  // NaN-boxing: Both are tagged integers -> integer add
-  if (kain_is_int(a) && kain_is_int(b)) {
-    int64_t result = kain_unbox_int(a) + kain_unbox_int(b);
-    return (int64_t)kain_box_int(result);
+// For embedders: release everything the calling thread allocated and hand
+// its pages to the global pool. Call it when a thread that ran Kain code is
+// about to end; objects it allocated must no longer be in use anywhere.
+void kain_thread_exit(void) {
+  kain_arena_reset();
+  ArenaPage *pages = spare_pages;
+  if (head_page) {
+    head_page->next = pages;
+    pages = head_page;
   }
-
-  // NaN-boxing: Both are doubles -> double add
-  if (kain_is_double(a) && kain_is_double(b)) {
-    double result = kain_unbox_double(a) + kain_unbox_double(b);
-    return (int64_t)kain_box_double(result);
+  head_page = current_page = spare_pages = NULL;
+  spare_page_count = 0;
+  free(region_marks);
+  region_marks = NULL;
+  region_cap = 0;
+  free(region_owned);
+  region_owned = NULL;
+  region_owned_cap = 0;
+  while (pages) {
+    ArenaPage *next = pages->next;
+    page_pool_give(pages);
+    pages = next;
   }
+}
 
-  // NaN-boxing: Both are tagged strings -> string concat
-  if (kain_is_string(a) && kain_is_string(b)) {
-    const char *sa = kain_unbox_string(a);
-    const char *sb = kain_unbox_string(b);
-    char *result = kain_str_concat(sa, sb);
-    return (int64_t)kain_box_string(result);
-  }
+// Bytes currently handed out by the calling thread's arena (boxed for Kain
+// callers)
+int64_t kain_arena_used(void) { return (int64_t)kain_box_int(total_allocated); }
 
-// RAW POINTER STRING HANDLING
-// Heuristic: values >= 0x10000000000 (64GB) are likely pointers, not small
-// integers TEXT segment pointers are typically in 0x7FF... range (Windows) Heap
-// pointers are typically in 0x1xx... - 0x3xx... range
-#define LIKELY_POINTER_MIN                                                     \
-  0x10000000000ULL // 64GB - very unlikely to be an integer
+// Global allocator wrapper - Returns RAW pointer for bootstrap compatibility
+void *kain_alloc(int64_t size) {
+  KAIN_PROFILE_CALL();
+  // Codegen allocates structs, enums and payload tuples of a fixed shape
+  if (size > 0 && size <= SMALL_MAX)
+    return arena_alloc_small((size_t)size, KAIN_GC_RAW);
+  return arena_alloc_as((size_t)size, KAIN_GC_RAW);
+}
 
-  // Check if both look like pointers (not small integers)
-  int a_looks_like_ptr = (a > LIKELY_POINTER_MIN && a < NANBOX_QNAN);
-  int b_looks_like_ptr = (b > LIKELY_POINTER_MIN && b < NANBOX_QNAN);
+void kain_free(void *ptr) {
+  KAIN_PROFILE_CALL();
+  // No-op: arena memory is released in bulk via arena_rewind/kain_arena_reset
+}
 
-  // If both look like pointers and neither is a tagged integer, try string
-  // concat
-  if (a_looks_like_ptr && b_looks_like_ptr && !kain_is_tagged(a) &&
-      !kain_is_tagged(b)) {
-    const char *sa = (const char *)a;
-    const char *sb = (const char *)b;
-    char *result = kain_str_concat(sa, sb);
-    return (int64_t)kain_box_string(result);
+// =============================================================================
+// Heap Strings (length-prefixed, NUL-terminated)
+// =============================================================================
+//
+// Every string the runtime hands out with kain_TAG_STR carries a header just
+// in front of its bytes. The boxed value still points at the bytes, so the
+// data stays a plain NUL-terminated C string for printf/fopen interop, but
+// length is O(1) and the hash is computed at most once.
+//
+//   [KainStrHeader][bytes...][\0]
+//                  ^-- kain_BOX_STR(ptr)
+//
+// Substrings may instead be views: a bare header flagged KAIN_STR_VIEW whose
+// `base` points into the parent's bytes. View bytes are not NUL-terminated, so
+// code that needs a C string goes through kain_str_cstr()/kain_materialize(),
+// which copy once and remember the copy; everything else uses kain_str_ref().
+//
+// V1 raw pointers (string literals from codegen are emitted as ptrtoint) have
+// no header; kain_str_ref() falls back to strlen for those. Foreign C strings
+// must go through kain_box_cstr(), which copies, before being tagged.
+// =============================================================================
+
+// Borrowed view of a string value: pointer + length, header if it has one
+typedef struct {
+  const char *ptr;
+  size_t len;
+  KainStrHeader *hdr;
+} KainStrRef;
+
+static inline KainStrRef kain_str_ref(int64_t val) {
+  uint64_t v = (uint64_t)val;
+  KainStrRef r = {NULL, 0, NULL};
+  if (kain_IS_STR(v)) {
+    r.ptr = kain_UNBOX_STR(v);
+    if (r.ptr) {
+      r.hdr = kain_str_header(r.ptr);
+      r.len = (size_t)r.hdr->len;
+      if (r.hdr->flags & KAIN_STR_VIEW)
+        r.ptr = r.hdr->base;
+    }
+  } else if (KAIN_V1_RAW_PTR(v)) {
+    // V1 raw string pointer
+    r.ptr = (const char *)v;
+    r.len = strlen(r.ptr);
   }
+  return r;
+}
 
-  // One is tagged string, other is raw pointer
-  if (kain_is_string(a) && b_looks_like_ptr && !kain_is_tagged(b)) {
-    const char *sa = kain_unbox_string(a);
-    const char *sb = (const char *)b;
-    char *result = kain_str_concat(sa, sb);
-    return (int64_t)kain_box_string(result);
+// Allocate an uninitialized string of `len` bytes (terminator already set)
+char *kain_str_alloc(size_t len) {
+  KainStrHeader *hdr =
+      (KainStrHeader *)arena_alloc_as(sizeof(KainStrHeader) + len + 1, KAIN_GC_LEAF);
+  hdr->len = (int64_t)len;
+  hdr->cap = (int64_t)len;
+  hdr->hash = 0;
+  hdr->flags = 0;
+  char *data = (char *)(hdr + 1);
+  data[len] = '\0';
+  return data;
+}
+
+char *kain_str_from(const char *src, size_t len) {
+  KAIN_PROFILE_COUNT(KAIN_PROF_STR_COPIES, 1);
+  KAIN_PROFILE_COUNT(KAIN_PROF_STR_COPY_BYTES, len);
+  char *result = kain_str_alloc(len);
+  if (len)
+    memcpy(result, src, len);
+  return result;
+}
+
+char *kain_str_new(const char *str) {
+  if (!str)
+    return NULL;
+  return kain_str_from(str, strlen(str));
+}
+
+// Copy a foreign C string into a runtime string and box it
+int64_t kain_box_cstr(const char *s) {
+  if (!s)
+    return (int64_t)kain_box_null();
+  return (int64_t)kain_box_string(kain_str_new(s));
+}
+
+// Substrings at least this long become views. A view is one bare header
+// (32 bytes); a copy is the header plus the bytes, so shorter ones gain
+// nothing from borrowing.
+#define KAIN_STR_VIEW_MIN 16
+
+// Borrow bytes [start, start + len) of `parent` without copying
+static int64_t kain_str_view(KainStrRef parent, size_t start, size_t len) {
+#ifdef KAIN_GC
+  // The collector only resolves pointers to the start of a block, so a view
+  // could not keep its parent alive: copy instead
+  return (int64_t)kain_box_string(kain_str_from(parent.ptr + start, len));
+#endif
+  KainStrHeader *hdr =
+      (KainStrHeader *)arena_alloc_as(sizeof(KainStrHeader), KAIN_GC_LEAF);
+  hdr->len = (int64_t)len;
+  hdr->base = parent.ptr + start;
+  hdr->hash = 0;
+  hdr->flags = KAIN_STR_VIEW;
+  return (int64_t)kain_box_string((const char *)(hdr + 1));
+}
+
+// Copy a view's bytes out once; later calls reuse the copy
+const char *kain_str_view_cstr(KainStrHeader *hdr) {
+  if (!(hdr->flags & KAIN_STR_VIEW_CSTR)) {
+    hdr->base = kain_str_from(hdr->base, (size_t)hdr->len);
+    hdr->flags |= KAIN_STR_VIEW_CSTR;
   }
-  if (kain_is_string(b) && a_looks_like_ptr && !kain_is_tagged(a)) {
-    const char *sa = (const char *)a;
-    const char *sb = kain_unbox_string(b);
-    char *result = kain_str_concat(sa, sb);
-    return (int64_t)kain_box_string(result);
+  return hdr->base;
+}
+
+// A string value whose bytes are NUL-terminated (views are copied out)
+int64_t kain_materialize(int64_t val) {
+  KAIN_PROFILE_CALL();
+  uint64_t v = (uint64_t)val;
+  if (!kain_IS_STR(v) || !kain_UNBOX_STR(v))
+    return val;
+  KainStrHeader *hdr = kain_str_header(kain_UNBOX_STR(v));
+  if (!(hdr->flags & KAIN_STR_VIEW))
+    return val;
+  return (int64_t)kain_box_string(kain_str_view_cstr(hdr));
+}
+
+static inline uint64_t kain_hash_mix(uint64_t x) {
+  // splitmix64 finalizer
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+// FNV-1a over a byte range
+uint64_t kain_hash_bytes(const char *s, size_t len) {
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)s[i];
+    h *= 0x100000001B3ULL;
   }
+  return h;
+}
 
-  // Auto-unbox each operand independently for V1 compatibility
-  int64_t a_raw, b_raw;
-  if (kain_is_int(a))
-    a_raw = kain_unbox_int(a);
-  else if (a < NANBOX_QNAN)
-    a_raw = a_val;
-  else
-    a_raw = 0; // Invalid
+// Hash of a string value; cached in the header when there is one
+static uint64_t kain_str_ref_hash(KainStrRef r) {
+  if (r.hdr && r.hdr->hash)
+    return r.hdr->hash;
+  uint64_t h = kain_hash_bytes(r.ptr ? r.ptr : "", r.len);
+  if (h == 0)
+    h = 1;
+  if (r.hdr)
+    r.hdr->hash = h;
+  return h;
+}
 
-  if (kain_is_int(b))
-    b_raw = kain_unbox_int(b);
-  else if (b < NANBOX_QNAN)
-    b_raw = b_val;
-  else
-    b_raw = 0; // Invalid
+// =============================================================================
+// Regions (scoped arena marks)
+// =============================================================================
+//
+// kain_arena_mark() pushes the current arena top on a per-thread stack and
+// returns its depth; kain_arena_release(mark) rewinds to it in O(pages) and
+// pops it together with every mark taken after it. Releasing a mark that
+// an outer release already dropped is a no-op, so handles never dangle.
+//
+// A release also frees the malloc'd buffers of the arrays, maps, builders,
+// readers and typed arrays created since the mark (see region_track).
+//
+// kain_region(fn, arg) wraps one call: everything fn allocates is dropped
+// when it returns. A string result is copied out. Anything else, literals
+// and objects from before the region included, passes through unless it
+// points into the memory being released, which is fatal.
+// =============================================================================
 
-  return (int64_t)kain_box_int(a_raw + b_raw);
+int64_t kain_arena_mark(void) {
+  KAIN_PROFILE_CALL();
+  if (region_depth == region_cap) {
+    int64_t new_cap = region_cap ? region_cap * 2 : 16;
+    ArenaMark *marks =
+        (ArenaMark *)realloc(region_marks, (size_t)new_cap * sizeof(ArenaMark));
+    if (!marks) {
+      fprintf(stderr, "FATAL: OOM in kain_arena_mark\n");
+      exit(1);
+    }
+    region_marks = marks;
+    region_cap = new_cap;
+  }
+  region_marks[region_depth] = arena_mark();
+  return (int64_t)kain_box_int(region_depth++);
 }
 
-int64_t kain_sub_op(int64_t a_val, int64_t b_val) {
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
+int64_t kain_arena_release(int64_t mark_val) {
+  KAIN_PROFILE_CALL();
+  int64_t depth = (uint64_t)mark_val < NANBOX_QNAN
+                      ? mark_val
+                      : kain_unbox_int((uint64_t)mark_val);
+  if (depth < 0 || depth >= region_depth)
+    return 0;
+  arena_rewind(region_marks[depth]);
+  region_depth = depth;
+  return 0;
+}
 
-  // Auto-unbox each operand independently for V1 compatibility
-  int64_t a_raw, b_raw;
+int64_t kain_region(int64_t fn_val, int64_t arg) {
+  KAIN_PROFILE_CALL();
+  if (!fn_val || (uint64_t)fn_val >= NANBOX_QNAN) {
+    fprintf(stderr, "FATAL: region expects a function\n");
+    exit(1);
+  }
+  int64_t mark = kain_arena_mark();
+  int64_t result = ((int64_t(*)(int64_t))(intptr_t)fn_val)(arg);
+  uint64_t r = (uint64_t)result;
+
+  if (kain_IS_STR(r)) {
+    KainStrRef ref = kain_str_ref(result);
+    if (ref.hdr && (ref.hdr->flags & KAIN_STR_INTERNED)) {
+      kain_arena_release(mark);
+      return result;
+    }
+    // Stash the bytes, drop the region, then rebuild below the old mark
+    char *tmp = (char *)malloc(ref.len ? ref.len : 1);
+    if (!tmp) {
+      fprintf(stderr, "FATAL: OOM in kain_region\n");
+      exit(1);
+    }
+    memcpy(tmp, ref.ptr, ref.len);
+    size_t len = ref.len;
+    kain_arena_release(mark);
+    char *out = kain_str_alloc(len);
+    memcpy(out, tmp, len);
+    free(tmp);
+    return (int64_t)kain_box_string(out);
+  }
 
-  if (kain_is_int(a)) {
-    a_raw = kain_unbox_int(a);
-  } else if (a_val < NANBOX_QNAN) {
-    // Raw small integer
-    a_raw = a_val;
-  } else {
-    // Assume double or other - just use raw
-    a_raw = a_val;
+  // Anything else passes through unless it points into the memory about to
+  // be released. Raw words are only compared, never followed: a literal's
+  // address in a PIE binary looks like a heap pointer, and so may an Int.
+  uint64_t tag = (r >> NANBOX_TAG_SHIFT) & 0x7;
+  const void *p = NULL;
+  if (r >= NANBOX_QNAN) {
+    if (tag == kain_TAG_PTR || tag == kain_TAG_OBJ)
+      p = kain_UNBOX_PTR(r);
+  } else if (r >= LIKELY_POINTER_MIN && r < (1ULL << 48)) {
+    p = (const void *)(uintptr_t)r;
+  }
+  int64_t depth = kain_unbox_int((uint64_t)mark);
+  if (p && depth < region_depth && arena_since_mark(region_marks[depth], p)) {
+    fprintf(stderr, "FATAL: region result must be a scalar or a string\n");
+    exit(1);
+  }
+  kain_arena_release(mark);
+  return result;
+}
+
+// =============================================================================
+// Single-Byte String Table
+// =============================================================================
+//
+// One preallocated, headered string per byte value. char_at / chr /
+// char_from_code return these instead of allocating, so walking a source
+// file a character at a time costs nothing. The entries count as interned:
+// kain_intern_n() hands them out for 1-byte strings, keeping interned
+// strings unique per content.
+// =============================================================================
+
+typedef struct {
+  KainStrHeader hdr;
+  char bytes[8]; // byte + NUL, padded so every entry stays 8-byte aligned
+} KainCharStr;
+
+static KainCharStr kain_char_table[256];
+static int kain_char_table_ready = 0;
+
+static void kain_char_table_init(void) {
+  for (int i = 0; i < 256; i++) {
+    KainCharStr *c = &kain_char_table[i];
+    c->bytes[0] = (char)i;
+    c->bytes[1] = '\0';
+    c->hdr.len = 1;
+    c->hdr.cap = 1;
+    c->hdr.hash = kain_hash_bytes(c->bytes, 1);
+    if (c->hdr.hash == 0)
+      c->hdr.hash = 1;
+    c->hdr.flags = KAIN_STR_INTERNED;
   }
+  kain_char_table_ready = 1;
+}
 
-  if (kain_is_int(b)) {
-    b_raw = kain_unbox_int(b);
-  } else if (b_val < NANBOX_QNAN) {
-    // Raw small integer
-    b_raw = b_val;
+// Boxed 1-byte string for `code` (low 8 bits), never allocates
+static inline int64_t kain_char_str(int64_t code) {
+  if (!kain_char_table_ready)
+    kain_char_table_init();
+  return (int64_t)kain_box_string(kain_char_table[(unsigned char)code].bytes);
+}
+
+// Bytes [start, start + len) of `str` as a string value: single bytes come
+// from the char table, long runs are views, the rest are copied. Slices of a
+// volatile string (a reader line) are always copied: a view would change
+// under the program at the next read.
+static int64_t kain_str_slice(KainStrRef str, size_t start, size_t len) {
+  if (len == 1)
+    return kain_char_str(str.ptr[start]);
+  if (len >= KAIN_STR_VIEW_MIN &&
+      !(str.hdr && (str.hdr->flags & KAIN_STR_VOLATILE)))
+    return kain_str_view(str, start, len);
+  return (int64_t)kain_box_string(kain_str_from(str.ptr + start, len));
+}
+
+// =============================================================================
+// String Interning
+// =============================================================================
+//
+// Interned strings are unique per content, so two interned values are equal
+// iff their pointers are. They live outside the arena (kain_arena_reset must
+// not invalidate names cached in static slots) and are never freed.
+//
+// kain_intern_lit() is the codegen fast path: each constant gets a zeroed
+// i64 slot that is filled on first use, after which it is a single load.
+// kain_intern_ptr() does the same for C literals passed by address, using a
+// small direct-mapped cache keyed on the pointer.
+// =============================================================================
+
+static char **intern_slots = NULL; // Open addressing, NULL = empty
+static size_t intern_cap = 0;
+static size_t intern_len = 0;
+static kain_mutex_t intern_lock = KAIN_MUTEX_INIT;
+
+#define INTERN_PTR_CACHE_SIZE 256
+static struct {
+  const char *src;
+  int64_t boxed;
+} intern_ptr_cache[INTERN_PTR_CACHE_SIZE];
+
+static void intern_grow(void) {
+  size_t new_cap = intern_cap ? intern_cap * 2 : 256;
+  char **slots = (char **)calloc(new_cap, sizeof(char *));
+  if (!slots) {
+    fprintf(stderr, "FATAL: OOM in kain_intern\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < intern_cap; i++) {
+    char *s = intern_slots[i];
+    if (!s)
+      continue;
+    size_t idx = kain_str_header(s)->hash & (new_cap - 1);
+    while (slots[idx])
+      idx = (idx + 1) & (new_cap - 1);
+    slots[idx] = s;
+  }
+  free(intern_slots);
+  intern_slots = slots;
+  intern_cap = new_cap;
+}
+
+int64_t kain_intern_n(const char *s, size_t len) {
+  KAIN_PROFILE_CALL();
+  if (!s)
+    return (int64_t)kain_box_null();
+  if (len == 1)
+    return kain_char_str(s[0]);
+  uint64_t h = kain_hash_bytes(s, len);
+  if (h == 0)
+    h = 1;
+
+  KAIN_SHARED_LOCK(&intern_lock);
+  if ((intern_len + 1) * 2 > intern_cap)
+    intern_grow();
+
+  size_t idx = h & (intern_cap - 1);
+  while (intern_slots[idx]) {
+    char *cand = intern_slots[idx];
+    KainStrHeader *hdr = kain_str_header(cand);
+    if (hdr->hash == h && (size_t)hdr->len == len &&
+        memcmp(cand, s, len) == 0) {
+      KAIN_SHARED_UNLOCK(&intern_lock);
+      return (int64_t)kain_box_string(cand);
+    }
+    idx = (idx + 1) & (intern_cap - 1);
+  }
+
+  KainStrHeader *hdr = (KainStrHeader *)malloc(sizeof(KainStrHeader) + len + 1);
+  if (!hdr) {
+    fprintf(stderr, "FATAL: OOM in kain_intern\n");
+    exit(1);
+  }
+  hdr->len = (int64_t)len;
+  hdr->cap = (int64_t)len;
+  hdr->hash = h;
+  hdr->flags = KAIN_STR_INTERNED;
+  char *data = (char *)(hdr + 1);
+  memcpy(data, s, len);
+  data[len] = '\0';
+
+  intern_slots[idx] = data;
+  intern_len++;
+  KAIN_SHARED_UNLOCK(&intern_lock);
+  return (int64_t)kain_box_string(data);
+}
+
+int64_t kain_intern(const char *s) {
+  KAIN_PROFILE_CALL();
+  return s ? kain_intern_n(s, strlen(s)) : (int64_t)kain_box_null();
+}
+
+// Codegen entry point: `slot` is a zero-initialized global owned by the caller
+int64_t kain_intern_lit(int64_t *slot, const char *s) {
+  KAIN_PROFILE_CALL();
+  if (*slot)
+    return *slot;
+  return *slot = kain_intern(s);
+}
+
+// Intern a C string whose address is stable (literals, static names)
+int64_t kain_intern_ptr(const char *s) {
+  KAIN_PROFILE_CALL();
+  size_t idx = ((uintptr_t)s >> 3) & (INTERN_PTR_CACHE_SIZE - 1);
+  KAIN_SHARED_LOCK(&intern_lock);
+  if (intern_ptr_cache[idx].src == s && s) {
+    int64_t hit = intern_ptr_cache[idx].boxed;
+    KAIN_SHARED_UNLOCK(&intern_lock);
+    return hit;
+  }
+  KAIN_SHARED_UNLOCK(&intern_lock);
+  int64_t boxed = kain_intern(s);
+  KAIN_SHARED_LOCK(&intern_lock);
+  intern_ptr_cache[idx].src = s;
+  intern_ptr_cache[idx].boxed = boxed;
+  KAIN_SHARED_UNLOCK(&intern_lock);
+  return boxed;
+}
+
+// Intern a Kain string value (tagged or V1 raw)
+int64_t kain_intern_value(int64_t val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef r = kain_str_ref(val);
+  if (!r.ptr)
+    return val;
+  if (r.hdr && (r.hdr->flags & KAIN_STR_INTERNED))
+    return val;
+  return kain_intern_n(r.ptr, r.len);
+}
+
+static char *kain_str_concat_ref(KainStrRef a, KainStrRef b) {
+  char *result = kain_str_alloc(a.len + b.len);
+  if (a.len)
+    memcpy(result, a.ptr, a.len);
+  if (b.len)
+    memcpy(result + a.len, b.ptr, b.len);
+  return result;
+}
+
+char *kain_str_concat(const char *a, const char *b) {
+  KAIN_PROFILE_CALL();
+  KainStrRef ra = {a ? a : "", a ? strlen(a) : 0, NULL};
+  KainStrRef rb = {b ? b : "", b ? strlen(b) : 0, NULL};
+  return kain_str_concat_ref(ra, rb);
+}
+
+// NaN-boxing aware string concat - accepts boxed values, returns boxed value
+int64_t kain_builder_append(int64_t sb_val, int64_t val);
+int64_t kain_str_concat_boxed(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  if (kain_IS_OBJ((uint64_t)a_val))
+    return kain_builder_append(a_val, b_val);
+  char *result = kain_str_concat_ref(kain_str_ref(a_val), kain_str_ref(b_val));
+  return (int64_t)kain_box_string(result);
+}
+
+// =============================================================================
+// String Builder
+// =============================================================================
+//
+// A growable byte buffer boxed as a runtime object. Appends are amortized
+// O(1) (capacity doubles), so `sb = sb + piece` in a loop is linear instead
+// of copying the whole prefix every time. kain_add_op and kain_append append
+// in place when the left operand is a builder.
+//
+// The buffer is laid out as [ArenaPage][KainStrHeader][bytes][\0] so that
+// kain_builder_finish() can hand a large result to the arena as-is instead
+// of copying it; small results are copied and the buffer is kept for reuse.
+// =============================================================================
+
+typedef struct {
+  KainObjHeader obj;
+  ArenaPage *buf; // NULL until the first append
+  int64_t len;
+  int64_t cap;
+} KainBuilder;
+
+#define BUILDER_MIN_CAP 64
+#define BUILDER_ADOPT_MIN ARENA_LARGE_THRESHOLD
+
+static inline char *builder_bytes(KainBuilder *b) {
+  return (char *)(((KainStrHeader *)(b->buf + 1)) + 1);
+}
+
+static void builder_reserve(KainBuilder *b, size_t extra) {
+  size_t need = (size_t)b->len + extra;
+  if (need <= (size_t)b->cap)
+    return;
+  size_t new_cap = b->cap ? (size_t)b->cap : BUILDER_MIN_CAP;
+  while (new_cap < need)
+    new_cap *= 2;
+  KAIN_PROFILE_COUNT(KAIN_PROF_GROWTHS, 1);
+  ArenaPage *page = (ArenaPage *)realloc(
+      b->buf, sizeof(ArenaPage) + sizeof(KainStrHeader) + new_cap + 1);
+  if (!page) {
+    fprintf(stderr, "FATAL: OOM in kain_builder (requested %zu bytes)\n",
+            new_cap);
+    exit(1);
+  }
+  page->data = (char *)(page + 1);
+  b->buf = page;
+  b->cap = (int64_t)new_cap;
+}
+
+static inline void builder_put(KainBuilder *b, const char *src, size_t n) {
+  if (!n)
+    return;
+  builder_reserve(b, n);
+  memcpy(builder_bytes(b) + b->len, src, n);
+  b->len += (int64_t)n;
+}
+
+// "00".."99": two digits per division halves the divides of a naive loop
+static const char kain_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+// Write the decimal form of `n` into `out` (at least 21 bytes), return length
+static size_t kain_format_i64(char *out, int64_t n) {
+  char tmp[24];
+  char *p = tmp + sizeof(tmp);
+  uint64_t u = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+  while (u >= 100) {
+    const char *d = kain_digit_pairs + (u % 100) * 2;
+    u /= 100;
+    *--p = d[1];
+    *--p = d[0];
+  }
+  if (u >= 10) {
+    const char *d = kain_digit_pairs + u * 2;
+    *--p = d[1];
+    *--p = d[0];
   } else {
-    // Assume double or other - just use raw
-    b_raw = b_val;
+    *--p = (char)('0' + u);
   }
+  if (n < 0)
+    *--p = '-';
+  size_t len = (size_t)(tmp + sizeof(tmp) - p);
+  memcpy(out, p, len);
+  return len;
+}
 
-  // Return RAW result for V1 compatibility
-  // V1 codegen uses raw integers for array indexing
-  return a_raw - b_raw;
+#define KAIN_F64_BUF 32
+
+static const double kain_pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17};
+
+// Shortest round-trip digits by Grisu2 (Loitsch, "Printing Floating-Point
+// Numbers Quickly and Accurately with Integers"): 64-bit integer arithmetic
+// against a table of cached powers of ten, no libc and no bignums. The
+// digits always read back as the same double and are the shortest such in
+// all but a tiny fraction of inputs.
+typedef struct {
+  uint64_t f;
+  int e;
+} KainDiyFp;
+
+// 10^(-348 + 8i) as normalized 64-bit significand * 2^e
+static const uint64_t kain_cached_pow_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL};
+static const int16_t kain_cached_pow_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066};
+
+static const uint64_t kain_pow10_u64[] = {1ULL,
+                                          10ULL,
+                                          100ULL,
+                                          1000ULL,
+                                          10000ULL,
+                                          100000ULL,
+                                          1000000ULL,
+                                          10000000ULL,
+                                          100000000ULL,
+                                          1000000000ULL,
+                                          10000000000ULL,
+                                          100000000000ULL,
+                                          1000000000000ULL,
+                                          10000000000000ULL,
+                                          100000000000000ULL,
+                                          1000000000000000ULL,
+                                          10000000000000000ULL,
+                                          100000000000000000ULL,
+                                          1000000000000000000ULL,
+                                          10000000000000000000ULL};
+
+// High 64 bits of the 128-bit product, rounded
+static KainDiyFp diyfp_mul(KainDiyFp x, KainDiyFp y) {
+  const uint64_t M32 = 0xFFFFFFFFULL;
+  uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ULL << 31);
+  KainDiyFp r = {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+  return r;
 }
 
-int64_t kain_mul_op(int64_t a_val, int64_t b_val) {
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
+static KainDiyFp diyfp_normalize(KainDiyFp x) {
+  while (!(x.f & (1ULL << 63))) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
 
-  // Auto-unbox each operand independently for V1 compatibility
-  int64_t a_raw, b_raw;
+static void grisu_round(char *buf, int len, uint64_t delta, uint64_t rest,
+                        uint64_t ten_kappa, uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
 
-  if (kain_is_int(a)) {
-    a_raw = kain_unbox_int(a);
-  } else if (a_val < NANBOX_QNAN) {
-    // Raw small integer
-    a_raw = a_val;
+// Digits of a positive finite `d` into `buf` (17 bytes); *k is the decimal
+// exponent of the last digit. Returns the digit count.
+static int kain_grisu2(double d, char *buf, int *k) {
+  const uint64_t hidden = 1ULL << 52;
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  int biased = (int)((bits >> 52) & 0x7FF);
+  KainDiyFp v = {bits & (hidden - 1), -1074};
+  if (biased) {
+    v.f |= hidden;
+    v.e = biased - 1075;
+  }
+
+  // Boundaries halfway to the neighbouring doubles
+  KainDiyFp hi = {(v.f << 1) + 1, v.e - 1};
+  while (!(hi.f & (hidden << 1))) {
+    hi.f <<= 1;
+    hi.e--;
+  }
+  hi.f <<= 10;
+  hi.e -= 10;
+  KainDiyFp lo = v.f == hidden ? (KainDiyFp){(v.f << 2) - 1, v.e - 2}
+                               : (KainDiyFp){(v.f << 1) - 1, v.e - 1};
+  lo.f <<= lo.e - hi.e;
+  lo.e = hi.e;
+
+  // Scale by a cached 10^-K so the product's exponent lands in [-60, -32]
+  double dk = (-61 - hi.e) * 0.30102999566398114 + 347;
+  int ki = (int)dk;
+  if (dk - ki > 0.0)
+    ki++;
+  unsigned index = (unsigned)((ki >> 3) + 1);
+  *k = -(-348 + (int)(index << 3));
+  KainDiyFp c = {kain_cached_pow_f[index], kain_cached_pow_e[index]};
+
+  KainDiyFp w = diyfp_mul(diyfp_normalize(v), c);
+  KainDiyFp wp = diyfp_mul(hi, c);
+  KainDiyFp wm = diyfp_mul(lo, c);
+  wm.f++;
+  wp.f--;
+
+  // Digit generation: integral part of wp first, then the fraction
+  uint64_t delta = wp.f - wm.f;
+  uint64_t wp_w = wp.f - w.f;
+  KainDiyFp one = {1ULL << -wp.e, wp.e};
+  uint32_t p1 = (uint32_t)(wp.f >> -one.e);
+  uint64_t p2 = wp.f & (one.f - 1);
+  int kappa = 1;
+  while (kappa < 10 && p1 >= kain_pow10_u64[kappa])
+    kappa++;
+  int len = 0;
+  while (kappa > 0) {
+    uint32_t div = (uint32_t)kain_pow10_u64[kappa - 1];
+    uint32_t digit = p1 / div;
+    p1 %= div;
+    if (digit || len)
+      buf[len++] = (char)('0' + digit);
+    kappa--;
+    uint64_t rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      grisu_round(buf, len, delta, rest, kain_pow10_u64[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    char digit = (char)(p2 >> -one.e);
+    if (digit || len)
+      buf[len++] = (char)('0' + digit);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      int scale = -kappa;
+      grisu_round(buf, len, delta, p2, one.f,
+                  wp_w * (scale < 20 ? kain_pow10_u64[scale] : 0));
+      return len;
+    }
+  }
+}
+
+// Write the shortest decimal that reads back as `d` into `out` (at least
+// KAIN_F64_BUF bytes), return length. The notation follows "%g": integral
+// values without a point, exponents below 1e-4 and from 1e15 on.
+static size_t kain_format_f64(char *out, double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  int neg = (int64_t)bits < 0;
+  double a = neg ? -d : d;
+
+  if (a < 1e15 && a == (double)(int64_t)a && (a != 0 || !neg))
+    return kain_format_i64(out, (int64_t)d);
+
+  size_t len = 0;
+  if (neg && a == a)
+    out[len++] = '-';
+  if (a != a || a - a != 0) {
+    memcpy(out + len, a != a ? "nan" : "inf", 3);
+    return len + 3;
+  }
+  if (a == 0) {
+    out[len++] = '0';
+    return len;
+  }
+
+  char digits[20];
+  int k;
+  int nd = kain_grisu2(a, digits, &k);
+  int exp10 = nd + k - 1; // exponent of the first digit
+
+  if (exp10 >= -4 && exp10 < 15) {
+    if (exp10 < 0) {
+      out[len++] = '0';
+      out[len++] = '.';
+      for (int z = -1; z > exp10; z--)
+        out[len++] = '0';
+      memcpy(out + len, digits, (size_t)nd);
+      return len + (size_t)nd;
+    }
+    int whole = exp10 + 1;
+    if (nd <= whole) {
+      memcpy(out + len, digits, (size_t)nd);
+      len += (size_t)nd;
+      for (int z = nd; z < whole; z++)
+        out[len++] = '0';
+      return len;
+    }
+    memcpy(out + len, digits, (size_t)whole);
+    len += (size_t)whole;
+    out[len++] = '.';
+    memcpy(out + len, digits + whole, (size_t)(nd - whole));
+    return len + (size_t)(nd - whole);
+  }
+
+  out[len++] = digits[0];
+  if (nd > 1) {
+    out[len++] = '.';
+    memcpy(out + len, digits + 1, (size_t)(nd - 1));
+    len += (size_t)(nd - 1);
+  }
+  out[len++] = 'e';
+  out[len++] = exp10 < 0 ? '-' : '+';
+  int e = exp10 < 0 ? -exp10 : exp10;
+  if (e < 10)
+    out[len++] = '0';
+  return len + kain_format_i64(out + len, e);
+}
+
+static inline KainBuilder *kain_unbox_builder(int64_t val) {
+  return (KainBuilder *)kain_unbox_obj((uint64_t)val, KAIN_OBJ_BUILDER);
+}
+
+int64_t kain_builder_with_capacity(int64_t cap_val) {
+  KAIN_PROFILE_CALL();
+  int64_t cap = kain_is_int((uint64_t)cap_val) ? kain_unbox_int((uint64_t)cap_val)
+                                               : cap_val;
+  KainBuilder *b = (KainBuilder *)arena_alloc_as(sizeof(KainBuilder), KAIN_GC_OBJ);
+  b->obj.kind = KAIN_OBJ_BUILDER;
+  b->obj.flags = 0;
+  b->buf = NULL;
+  b->len = 0;
+  b->cap = 0;
+  region_track(b, KAIN_GC_OBJ);
+  if (cap > 0)
+    builder_reserve(b, (size_t)cap);
+  return (int64_t)kain_BOX_OBJ(b);
+}
+
+int64_t kain_builder_new(void) { return kain_builder_with_capacity(0); }
+
+int64_t kain_builder_append_int(int64_t sb_val, int64_t n_val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(sb_val);
+  if (!b)
+    return sb_val;
+  int64_t n = kain_is_int((uint64_t)n_val) ? kain_unbox_int((uint64_t)n_val)
+                                           : n_val;
+  builder_reserve(b, 24);
+  b->len += (int64_t)kain_format_i64(builder_bytes(b) + b->len, n);
+  return sb_val;
+}
+
+int64_t kain_builder_append_char(int64_t sb_val, int64_t code_val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(sb_val);
+  if (!b)
+    return sb_val;
+  int64_t code = kain_is_int((uint64_t)code_val)
+                     ? kain_unbox_int((uint64_t)code_val)
+                     : code_val;
+  builder_reserve(b, 1);
+  builder_bytes(b)[b->len++] = (char)code;
+  return sb_val;
+}
+
+// Append any value: strings by bytes, numbers formatted in place, builders
+// by contents, everything else through kain_to_string
+int64_t kain_builder_append(int64_t sb_val, int64_t val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(sb_val);
+  if (!b)
+    return sb_val;
+  uint64_t v = (uint64_t)val;
+
+  if (kain_IS_STR(v) || KAIN_V1_LIKELY_PTR(v)) {
+    KainStrRef r = kain_str_ref(val);
+    builder_put(b, r.ptr, r.len);
+  } else if (kain_is_int(v)) {
+    return kain_builder_append_int(sb_val, val);
+  } else if (kain_is_double(v) && v >= KAIN_DOUBLE_MIN) {
+    builder_reserve(b, KAIN_F64_BUF);
+    b->len += (int64_t)kain_format_f64(builder_bytes(b) + b->len,
+                                       kain_unbox_double(v));
+  } else if (kain_IS_OBJ(v)) {
+    KainBuilder *other = kain_unbox_builder(val);
+    if (other && other->len) {
+      // Reserve first: `other` may be `b` itself
+      builder_reserve(b, (size_t)other->len);
+      memmove(builder_bytes(b) + b->len, builder_bytes(other),
+              (size_t)other->len);
+      b->len += other->len;
+    }
   } else {
-    // Assume double or other - just use raw
+    KainStrRef r = kain_str_ref(kain_to_string(val));
+    builder_put(b, r.ptr, r.len);
+  }
+  return sb_val;
+}
+
+int64_t kain_builder_len(int64_t sb_val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(sb_val);
+  return (int64_t)kain_box_int(b ? b->len : 0);
+}
+
+// Copy of the current contents; the builder keeps going
+int64_t kain_builder_to_string(int64_t sb_val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(sb_val);
+  if (!b || !b->len)
+    return (int64_t)kain_box_string(kain_str_new(""));
+  return (int64_t)kain_box_string(kain_str_from(builder_bytes(b), (size_t)b->len));
+}
+
+// Produce the final string and reset the builder to empty
+int64_t kain_builder_finish(int64_t sb_val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(sb_val);
+  if (!b || !b->len)
+    return (int64_t)kain_box_string(kain_str_new(""));
+#ifdef KAIN_GC
+  int adopt = 0; // An adopted buffer would not be a GC block
+#else
+  int adopt = b->len >= BUILDER_ADOPT_MIN;
+#endif
+  if (!adopt) {
+    int64_t result = kain_builder_to_string(sb_val);
+    b->len = 0;
+    return result;
+  }
+
+  // Large result: shrink the buffer to fit and give it to the arena
+  size_t size = sizeof(KainStrHeader) + (size_t)b->len + 1;
+  ArenaPage *page = (ArenaPage *)realloc(b->buf, sizeof(ArenaPage) + size);
+  if (!page)
+    page = b->buf;
+  page->data = (char *)(page + 1);
+  page->used = size;
+  page->capacity = size;
+
+  KainStrHeader *hdr = (KainStrHeader *)page->data;
+  hdr->len = b->len;
+  hdr->cap = b->len;
+  hdr->hash = 0;
+  hdr->flags = 0;
+  char *data = (char *)(hdr + 1);
+  data[b->len] = '\0';
+  arena_adopt_large(page);
+
+  b->buf = NULL;
+  b->len = 0;
+  b->cap = 0;
+  return (int64_t)kain_box_string(data);
+}
+
+// =============================================================================
+// Print Functions (buffered stdout)
+// =============================================================================
+//
+// print/println append to a runtime-owned buffer that is written out in large
+// chunks: when it fills, on kain_flush(), at exit and in kain_panic(). When
+// stdout is a terminal it is also flushed at every newline, so interactive
+// output still shows up line by line.
+//
+// Anything else that writes to stdout (printf, child processes) must call
+// kain_flush() first to keep the output in order.
+// =============================================================================
+
+#ifndef KAIN_OUT_BUF_SIZE
+#define KAIN_OUT_BUF_SIZE (64 * 1024)
+#endif
+
+static char kain_out_buf[KAIN_OUT_BUF_SIZE];
+static size_t kain_out_len = 0;
+static int kain_out_mode = 0; // 0 = not set up yet, 1 = block, 2 = line (TTY)
+static kain_mutex_t kain_out_lock = KAIN_MUTEX_INIT;
+
+#ifdef _WIN32
+#define kain_stdout_is_tty() _isatty(_fileno(stdout))
+#else
+#define kain_stdout_is_tty() isatty(fileno(stdout))
+#endif
+
+static void kain_out_drain(void) {
+  if (kain_out_len) {
+    fwrite(kain_out_buf, 1, kain_out_len, stdout);
+    kain_out_len = 0;
+  }
+  fflush(stdout);
+}
+
+int64_t kain_flush(void) {
+  KAIN_PROFILE_CALL();
+  KAIN_SHARED_LOCK(&kain_out_lock);
+  kain_out_drain();
+  KAIN_SHARED_UNLOCK(&kain_out_lock);
+  return 0;
+}
+
+static void kain_flush_at_exit(void) { kain_flush(); }
+
+static void kain_out_setup(void) {
+  kain_out_mode = kain_stdout_is_tty() ? 2 : 1;
+  atexit(kain_flush_at_exit);
+}
+
+// Caller holds kain_out_lock (when threaded)
+static void kain_out_put(const char *s, size_t n) {
+  if (!kain_out_mode)
+    kain_out_setup();
+  if (n > KAIN_OUT_BUF_SIZE - kain_out_len) {
+    kain_out_drain();
+    // Too big to be worth buffering: hand it straight to stdio
+    if (n >= KAIN_OUT_BUF_SIZE) {
+      fwrite(s, 1, n, stdout);
+      return;
+    }
+  }
+  memcpy(kain_out_buf + kain_out_len, s, n);
+  kain_out_len += n;
+  if (kain_out_mode == 2 && memchr(s, '\n', n))
+    kain_out_drain();
+}
+
+static void kain_out_write(const char *s, size_t n) {
+  KAIN_SHARED_LOCK(&kain_out_lock);
+  kain_out_put(s, n);
+  KAIN_SHARED_UNLOCK(&kain_out_lock);
+}
+
+int64_t kain_print_i64(int64_t value) {
+  KAIN_PROFILE_CALL();
+  // Auto-unbox NaN-boxed integers
+  int64_t to_print;
+  if (kain_is_int((uint64_t)value)) {
+    to_print = kain_unbox_int((uint64_t)value);
+  } else {
+    to_print = value; // Already raw or unknown
+  }
+  char buf[24];
+  size_t n = kain_format_i64(buf, to_print);
+  buf[n++] = '\n';
+  kain_out_write(buf, n);
+  return 0;
+}
+
+int64_t kain_print_str(int64_t val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(val);
+  if (b) {
+    kain_out_write(builder_bytes(b), (size_t)b->len);
+    return 0;
+  }
+  if (kain_IS_OBJ((uint64_t)val))
+    val = kain_to_string(val);
+  KainStrRef r = kain_str_ref(val);
+  if (r.ptr) {
+    kain_out_write(r.ptr, r.len);
+    return 0;
+  }
+  const char *str = (const char *)kain_unbox_any_ptr(val);
+  if (!str)
+    str = "(null)";
+  kain_out_write(str, strlen(str));
+  return 0;
+}
+
+int64_t kain_println_str(int64_t val) {
+  KAIN_PROFILE_CALL();
+  KainBuilder *b = kain_unbox_builder(val);
+  if (b) {
+    // Value and newline go out under one lock so threaded lines don't split
+    KAIN_SHARED_LOCK(&kain_out_lock);
+    kain_out_put(builder_bytes(b), (size_t)b->len);
+    kain_out_put("\n", 1);
+    KAIN_SHARED_UNLOCK(&kain_out_lock);
+    return 0;
+  }
+  if (kain_IS_OBJ((uint64_t)val))
+    val = kain_to_string(val);
+  KainStrRef r = kain_str_ref(val);
+  const char *str = r.ptr ? r.ptr : (const char *)kain_unbox_any_ptr(val);
+  if (!str)
+    str = "(null)";
+  size_t n = r.ptr ? r.len : strlen(str);
+  KAIN_SHARED_LOCK(&kain_out_lock);
+  kain_out_put(str, n);
+  kain_out_put("\n", 1);
+  KAIN_SHARED_UNLOCK(&kain_out_lock);
+  return 0;
+}
+
+int64_t kain_str_starts_with(int64_t str_val, int64_t prefix_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef str = kain_str_ref(str_val);
+  KainStrRef prefix = kain_str_ref(prefix_val);
+  if (!str.ptr || !prefix.ptr)
+    return (int64_t)kain_box_bool(0);
+  if (prefix.len > str.len)
+    return (int64_t)kain_box_bool(0);
+  return (int64_t)kain_box_bool(memcmp(str.ptr, prefix.ptr, prefix.len) == 0);
+}
+
+// Substring search. Views are not NUL-terminated, so strstr cannot be used.
+// One-byte needles go straight to memchr (vectorized by libc). Longer ones
+// use Two-Way (Crochemore-Perrin): linear time and constant space, with
+// memchr on the first byte and a last-byte shift table to skip windows.
+// split and replace prepare one KainFinder per call and reuse it for every
+// occurrence.
+
+typedef struct {
+  const unsigned char *needle;
+  size_t len;
+  size_t ms;     // Critical factorization: needle = needle[0..ms] needle[ms+1..]
+  size_t period; // Shift after a full match
+  size_t mem0;   // Prefix known to match after that shift (periodic needles)
+  size_t shift[256]; // 1 + last index of each byte in the needle, 0 if absent
+} KainFinder;
+
+// Maximal suffix of the needle under `<` (rev = 0) or `>` (rev = 1).
+// Returns its start minus one and stores its period.
+static size_t kain_max_suffix(const unsigned char *n, size_t l, int rev,
+                              size_t *period) {
+  size_t ip = (size_t)-1, jp = 0, k = 1, p = 1;
+  while (jp + k < l) {
+    unsigned char a = n[ip + k], b = n[jp + k];
+    if (a == b) {
+      if (k == p) {
+        jp += p;
+        k = 1;
+      } else {
+        k++;
+      }
+    } else if (rev ? a < b : a > b) {
+      jp += k;
+      k = 1;
+      p = jp - ip;
+    } else {
+      ip = jp++;
+      k = p = 1;
+    }
+  }
+  *period = p;
+  return ip;
+}
+
+static void kain_finder_init(KainFinder *f, const char *needle, size_t len) {
+  const unsigned char *n = (const unsigned char *)needle;
+  f->needle = n;
+  f->len = len;
+  if (len < 2)
+    return;
+
+  memset(f->shift, 0, sizeof(f->shift));
+  for (size_t i = 0; i < len; i++)
+    f->shift[n[i]] = i + 1;
+
+  size_t p, p_rev;
+  size_t ms = kain_max_suffix(n, len, 0, &p);
+  size_t ms_rev = kain_max_suffix(n, len, 1, &p_rev);
+  if (ms_rev + 1 > ms + 1) {
+    ms = ms_rev;
+    p = p_rev;
+  }
+  f->ms = ms;
+  if (memcmp(n, n + p, ms + 1) != 0) {
+    // Not periodic: any shift up to the longer half is safe
+    f->period = (ms > len - ms - 1 ? ms : len - ms - 1) + 1;
+    f->mem0 = 0;
+  } else {
+    f->period = p;
+    f->mem0 = len - p;
+  }
+}
+
+// First occurrence of the needle in [hay, end), or NULL
+static const char *kain_finder_next(const KainFinder *f, const char *hay,
+                                    const char *end) {
+  size_t l = f->len;
+  if ((size_t)(end - hay) < l)
+    return NULL;
+  if (l == 0)
+    return hay;
+  if (l == 1)
+    return (const char *)memchr(hay, f->needle[0], (size_t)(end - hay));
+
+  const unsigned char *n = f->needle;
+  const unsigned char *h = (const unsigned char *)hay;
+  const unsigned char *last = (const unsigned char *)end - l;
+  size_t ms = f->ms, mem = 0;
+  while (h <= last) {
+    // Jump to the next possible first byte; memchr scans far faster than the
+    // shift table steps when matches are sparse
+    if (!mem && h[0] != n[0]) {
+      h = (const unsigned char *)memchr(h, n[0], (size_t)(last - h) + 1);
+      if (!h)
+        return NULL;
+    }
+    // Align the window's last byte with its last occurrence in the needle
+    size_t k = l - f->shift[h[l - 1]];
+    if (k) {
+      h += k < mem ? mem : k;
+      mem = 0;
+      continue;
+    }
+    // Right half, then left half
+    for (k = ms + 1 > mem ? ms + 1 : mem; k < l && n[k] == h[k]; k++)
+      ;
+    if (k < l) {
+      h += k - ms;
+      mem = 0;
+      continue;
+    }
+    for (k = ms + 1; k > mem && n[k - 1] == h[k - 1]; k--)
+      ;
+    if (k <= mem)
+      return (const char *)h;
+    h += f->period;
+    mem = f->mem0;
+  }
+  return NULL;
+}
+
+// One-off search. Short haystacks are not worth preparing a finder for.
+static const char *kain_find_bytes(const char *hay, size_t hay_len,
+                                   const char *needle, size_t needle_len) {
+  if (needle_len == 0)
+    return hay;
+  if (needle_len > hay_len)
+    return NULL;
+  if (needle_len > 1 && hay_len >= 256) {
+    KainFinder f;
+    kain_finder_init(&f, needle, needle_len);
+    return kain_finder_next(&f, hay, hay + hay_len);
+  }
+  const char *last = hay + (hay_len - needle_len);
+  const char *p = hay;
+  while (p <= last) {
+    p = (const char *)memchr(p, needle[0], (size_t)(last - p) + 1);
+    if (!p)
+      return NULL;
+    if (memcmp(p, needle, needle_len) == 0)
+      return p;
+    p++;
+  }
+  return NULL;
+}
+
+int64_t kain_str_replace(int64_t str_val, int64_t old_val, int64_t new_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef str = kain_str_ref(str_val);
+  KainStrRef old_sub = kain_str_ref(old_val);
+  KainStrRef new_sub = kain_str_ref(new_val);
+
+  if (!str.ptr || !old_sub.ptr || !new_sub.ptr)
+    return (int64_t)kain_box_string(kain_str_new(""));
+  if (old_sub.len == 0 || old_sub.len > str.len)
+    return kain_IS_STR((uint64_t)str_val)
+               ? str_val
+               : (int64_t)kain_box_string(kain_str_from(str.ptr, str.len));
+
+  // One scan records the match offsets; the result is then sized exactly
+  KainFinder f;
+  kain_finder_init(&f, old_sub.ptr, old_sub.len);
+  size_t inline_hits[64];
+  size_t *hits = inline_hits, hits_cap = 64, count = 0;
+  const char *end = str.ptr + str.len;
+  for (const char *p = str.ptr; (p = kain_finder_next(&f, p, end));
+       p += old_sub.len) {
+    if (count == hits_cap) {
+      size_t *grown = (size_t *)realloc(
+          hits == inline_hits ? NULL : hits, hits_cap * 2 * sizeof(size_t));
+      if (!grown) {
+        fprintf(stderr, "FATAL: OOM in kain_str_replace\n");
+        exit(1);
+      }
+      if (hits == inline_hits)
+        memcpy(grown, inline_hits, sizeof(inline_hits));
+      hits = grown;
+      hits_cap *= 2;
+    }
+    hits[count++] = (size_t)(p - str.ptr);
+  }
+  // Strings are immutable: nothing to replace means nothing to copy
+  if (count == 0 && kain_IS_STR((uint64_t)str_val))
+    return str_val;
+
+  size_t result_len = str.len - count * old_sub.len + count * new_sub.len;
+  char *result = kain_str_alloc(result_len);
+  char *dst = result;
+  size_t src = 0;
+  for (size_t i = 0; i < count; i++) {
+    memcpy(dst, str.ptr + src, hits[i] - src);
+    dst += hits[i] - src;
+    memcpy(dst, new_sub.ptr, new_sub.len);
+    dst += new_sub.len;
+    src = hits[i] + old_sub.len;
+  }
+  memcpy(dst, str.ptr + src, str.len - src);
+  if (hits != inline_hits)
+    free(hits);
+  return (int64_t)kain_box_string(result);
+}
+
+int64_t kain_str_len(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  if (kain_IS_OBJ((uint64_t)str_val))
+    return kain_builder_len(str_val);
+  return (int64_t)kain_box_int((int64_t)kain_str_ref(str_val).len);
+}
+
+int64_t kain_str_eq(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+  // Fast path: bitwise equality
+  if (a_val == b_val) {
+    return kain_TRUE;
+  }
+
+#ifdef KAIN_STRICT_NANBOX
+  // Boxed scalars are canonical: unequal bits mean unequal values, except
+  // for the two spellings of null, signed zeros and string contents
+  uint64_t tag = kain_get_tag(a);
+  if (tag != kain_get_tag(b))
+    return kain_FALSE;
+  switch (tag) {
+  case kain_TAG_STR:
+    break;
+  case kain_TAG_NULL:
+    return kain_TRUE;
+  case KAIN_TAG_DOUBLE:
+    return (int64_t)kain_box_bool(kain_unbox_double(a) ==
+                                  kain_unbox_double(b));
+  default:
+    return kain_FALSE;
+  }
+#else
+  // NaN-boxing: Check if both are tagged integers
+  if (kain_is_int(a) && kain_is_int(b)) {
+    return kain_unbox_int(a) == kain_unbox_int(b) ? kain_TRUE : kain_FALSE;
+  }
+
+  // NaN-boxing: Check if both are booleans
+  if (kain_is_bool(a) && kain_is_bool(b)) {
+    return kain_unbox_bool(a) == kain_unbox_bool(b) ? kain_TRUE : kain_FALSE;
+  }
+
+  // NaN-boxing: Check if both are null
+  if (kain_is_null(a) && kain_is_null(b)) {
+    return kain_TRUE;
+  }
+#endif
+
+  // Both runtime strings: reject on length or cached hash before the bytes
+  if (kain_IS_STR(a) && kain_IS_STR(b)) {
+    KainStrRef sa = kain_str_ref(a_val);
+    KainStrRef sb = kain_str_ref(b_val);
+    if (!sa.ptr || !sb.ptr)
+      return sa.ptr == sb.ptr ? kain_TRUE : kain_FALSE;
+    // Distinct interned strings are distinct by construction
+    if (sa.hdr->flags & sb.hdr->flags & KAIN_STR_INTERNED)
+      return kain_FALSE;
+    if (sa.len != sb.len)
+      return kain_FALSE;
+    if (sa.hdr->hash && sb.hdr->hash && sa.hdr->hash != sb.hdr->hash)
+      return kain_FALSE;
+    return memcmp(sa.ptr, sb.ptr, sa.len) == 0 ? kain_TRUE : kain_FALSE;
+  }
+
+#ifdef KAIN_STRICT_NANBOX
+  return kain_FALSE;
+#else
+  // NaN-boxing: Check if both are strings (tagged or V1 raw pointers)
+  if (kain_is_string(a) && kain_is_string(b)) {
+    KainStrRef sa = kain_str_ref(a_val);
+    KainStrRef sb = kain_str_ref(b_val);
+    if (!sa.ptr || !sb.ptr)
+      return sa.ptr == sb.ptr ? kain_TRUE : kain_FALSE;
+    if (sa.len != sb.len)
+      return kain_FALSE;
+    return memcmp(sa.ptr, sb.ptr, sa.len) == 0 ? kain_TRUE : kain_FALSE;
+  }
+
+  // V1 COMPATIBILITY: Try to extract string pointers from V1-style boxing
+  // V1 uses: (ptr >> 3) | STRING_TAG
+  // We can try to undo this if the value looks like it might be V1-boxed
+  const char *str_a = NULL;
+  const char *str_b = NULL;
+
+  // Check if 'a' looks like a V1-boxed string or raw pointer
+  // V1 COMPATIBILITY: Only try if not already identified as another type
+  if (kain_is_int(a) || kain_is_bool(a) || kain_is_null(a)) {
+    // Skip
+  } else if (a >= NANBOX_QNAN) {
+    uint64_t payload = a & NANBOX_PAYLOAD_MASK;
+    str_a = (const char *)(payload << 3);
+  } else if (a > 0x10000 && a < NANBOX_QNAN) {
+    str_a = (const char *)a;
+  }
+
+  if (kain_is_int(b) || kain_is_bool(b) || kain_is_null(b)) {
+    // Skip
+  } else if (b >= NANBOX_QNAN) {
+    uint64_t payload = b & NANBOX_PAYLOAD_MASK;
+    str_b = (const char *)(payload << 3);
+  } else if (b > 0x10000 && b < NANBOX_QNAN) {
+    str_b = (const char *)b;
+  }
+
+  // If we got valid-looking string pointers, compare them
+  if (str_a && str_b) {
+    // Sanity check: str_a and str_b should be valid readable pointers
+    // Just do strcmp - if they're garbage pointers, this will crash
+    // which is better than silently returning wrong results
+    int result = strcmp(str_a, str_b) == 0 ? 1 : 0;
+    return result;
+  }
+
+  // Last resort: if one is null and the other isn't, they're not equal
+  return 0;
+#endif
+}
+
+#ifdef KAIN_STRICT_NANBOX
+static KAIN_COLD void kain_bad_operand(const char *op, uint64_t v) {
+  fprintf(stderr, "FATAL: operator %s expects numbers, got 0x%llx\n", op,
+          (unsigned long long)v);
+  kain_flush();
+  exit(1);
+}
+
+// An Int or Float operand as a double; anything else is fatal
+static inline double kain_operand(uint64_t v, const char *op) {
+  if (kain_is_int(v))
+    return (double)kain_unbox_int(v);
+  if (v - KAIN_DOUBLE_MIN < NANBOX_QNAN - KAIN_DOUBLE_MIN)
+    return kain_unbox_double(v);
+  kain_bad_operand(op, v);
+  return 0;
+}
+#endif
+
+int64_t kain_add_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+#ifdef KAIN_STRICT_NANBOX
+  switch (kain_get_tag(a)) {
+  case kain_TAG_INT:
+    if (kain_is_int(b))
+      return (int64_t)kain_box_int(kain_unbox_int(a) + kain_unbox_int(b));
+    break;
+  case kain_TAG_OBJ:
+    // StringBuilder on the left: append in place
+    return kain_builder_append(a_val, b_val);
+  case kain_TAG_STR:
+    if (kain_IS_STR(b))
+      return (int64_t)kain_box_string(
+          kain_str_concat_ref(kain_str_ref(a_val), kain_str_ref(b_val)));
+    break;
+  }
+  return (int64_t)kain_box_double(kain_operand(a, "+") + kain_operand(b, "+"));
+#endif
+
+  // NaN-boxing: Both are tagged integers -> integer add
+  if (kain_is_int(a) && kain_is_int(b)) {
+    int64_t result = kain_unbox_int(a) + kain_unbox_int(b);
+    return (int64_t)kain_box_int(result);
+  }
+
+  // NaN-boxing: Both are doubles -> double add
+  if (kain_is_double(a) && kain_is_double(b)) {
+    double result = kain_unbox_double(a) + kain_unbox_double(b);
+    return (int64_t)kain_box_double(result);
+  }
+
+  // StringBuilder on the left: append in place, `sb = sb + x` stays linear
+  if (kain_IS_OBJ(a))
+    return kain_builder_append(a_val, b_val);
+
+  // NaN-boxing: Both are tagged strings -> string concat
+  if (kain_IS_STR(a) && kain_IS_STR(b)) {
+    char *result = kain_str_concat_ref(kain_str_ref(a_val), kain_str_ref(b_val));
+    return (int64_t)kain_box_string(result);
+  }
+
+  // Check if both look like pointers (not small integers)
+  int a_looks_like_ptr = (a > LIKELY_POINTER_MIN && a < NANBOX_QNAN);
+  int b_looks_like_ptr = (b > LIKELY_POINTER_MIN && b < NANBOX_QNAN);
+
+  // If both look like pointers and neither is a tagged integer, try string
+  // concat
+  if (a_looks_like_ptr && b_looks_like_ptr && !kain_is_tagged(a) &&
+      !kain_is_tagged(b)) {
+    const char *sa = (const char *)a;
+    const char *sb = (const char *)b;
+    char *result = kain_str_concat(sa, sb);
+    return (int64_t)kain_box_string(result);
+  }
+
+  // One is tagged string, other is raw pointer
+  if ((kain_IS_STR(a) && b_looks_like_ptr && !kain_is_tagged(b)) ||
+      (kain_IS_STR(b) && a_looks_like_ptr && !kain_is_tagged(a))) {
+    char *result = kain_str_concat_ref(kain_str_ref(a_val), kain_str_ref(b_val));
+    return (int64_t)kain_box_string(result);
+  }
+
+  // Auto-unbox each operand independently for V1 compatibility
+  int64_t a_raw, b_raw;
+  if (kain_is_int(a))
+    a_raw = kain_unbox_int(a);
+  else if (a < NANBOX_QNAN)
     a_raw = a_val;
+  else
+    a_raw = 0; // Invalid
+
+  if (kain_is_int(b))
+    b_raw = kain_unbox_int(b);
+  else if (b < NANBOX_QNAN)
+    b_raw = b_val;
+  else
+    b_raw = 0; // Invalid
+
+  return (int64_t)kain_box_int(a_raw + b_raw);
+}
+
+int64_t kain_sub_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+#ifdef KAIN_STRICT_NANBOX
+  if (kain_both_int(a, b))
+    return KAIN_OP_INT(kain_unbox_int(a) - kain_unbox_int(b));
+  return (int64_t)kain_box_double(kain_operand(a, "-") - kain_operand(b, "-"));
+#endif
+
+  // Auto-unbox each operand independently for V1 compatibility
+  int64_t a_raw, b_raw;
+
+  if (kain_is_int(a)) {
+    a_raw = kain_unbox_int(a);
+  } else if (a_val < NANBOX_QNAN) {
+    // Raw small integer
+    a_raw = a_val;
+  } else {
+    // Assume double or other - just use raw
+    a_raw = a_val;
+  }
+
+  if (kain_is_int(b)) {
+    b_raw = kain_unbox_int(b);
+  } else if (b_val < NANBOX_QNAN) {
+    // Raw small integer
+    b_raw = b_val;
+  } else {
+    // Assume double or other - just use raw
+    b_raw = b_val;
+  }
+
+  // Return RAW result for V1 compatibility
+  // V1 codegen uses raw integers for array indexing
+  return a_raw - b_raw;
+}
+
+int64_t kain_mul_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+#ifdef KAIN_STRICT_NANBOX
+  if (kain_both_int(a, b))
+    return KAIN_OP_INT(kain_unbox_int(a) * kain_unbox_int(b));
+  return (int64_t)kain_box_double(kain_operand(a, "*") * kain_operand(b, "*"));
+#endif
+
+  // Auto-unbox each operand independently for V1 compatibility
+  int64_t a_raw, b_raw;
+
+  if (kain_is_int(a)) {
+    a_raw = kain_unbox_int(a);
+  } else if (a_val < NANBOX_QNAN) {
+    // Raw small integer
+    a_raw = a_val;
+  } else {
+    // Assume double or other - just use raw
+    a_raw = a_val;
+  }
+
+  if (kain_is_int(b)) {
+    b_raw = kain_unbox_int(b);
+  } else if (b_val < NANBOX_QNAN) {
+    // Raw small integer
+    b_raw = b_val;
+  } else {
+    // Assume double or other - just use raw
+    b_raw = b_val;
+  }
+
+  // Return RAW result for V1 compatibility
+  return a_raw * b_raw;
+}
+
+int64_t kain_div_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+  if (kain_is_int(a) && kain_is_int(b)) {
+    int64_t vb = kain_unbox_int(b);
+    if (vb == 0) {
+      fprintf(stderr, "PANIC: Division by zero\n");
+      exit(1);
+    }
+    int64_t result = kain_unbox_int(a) / vb;
+    return (int64_t)kain_box_int(result);
+  }
+
+  if (kain_is_double(a) && kain_is_double(b)) {
+    double vb = kain_unbox_double(b);
+    if (vb == 0.0) {
+      // IEEE 754 infinity? Or panic?
+      // For now, let's just do it
+    }
+    double result = kain_unbox_double(a) / vb;
+    return (int64_t)kain_box_double(result);
+  }
+
+#ifdef KAIN_STRICT_NANBOX
+  return (int64_t)kain_box_double(kain_operand(a, "/") / kain_operand(b, "/"));
+#else
+  if (b_val == 0)
+    return 0;
+  return a_val / b_val;
+#endif
+}
+
+int64_t kain_rem_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+  if (kain_is_int(a) && kain_is_int(b)) {
+    int64_t vb = kain_unbox_int(b);
+    if (vb == 0) {
+      fprintf(stderr, "PANIC: Remainder by zero\n");
+      exit(1);
+    }
+    int64_t result = kain_unbox_int(a) % vb;
+    return (int64_t)kain_box_int(result);
+  }
+
+  // Floats don't support % in C, would need fmod
+#ifdef KAIN_STRICT_NANBOX
+  kain_bad_operand("%", kain_is_int(a) ? b : a);
+#endif
+
+  if (b_val == 0) {
+    fprintf(stderr, "PANIC: Remainder by zero (legacy)\n");
+    exit(1);
+  }
+  return a_val % b_val;
+}
+
+// Comparison Helpers - Return RAW booleans for V1 compatibility, tagged Bools
+// in strict builds
+
+#ifdef KAIN_STRICT_NANBOX
+// Ints compare exactly; once a Float is involved both sides are doubles
+#define KAIN_CMP_OP(name, op)                                                  \
+  int64_t kain_##name##_op(int64_t a_val, int64_t b_val) {                     \
+    KAIN_PROFILE_CALL();                                                       \
+    uint64_t a = (uint64_t)a_val;                                              \
+    uint64_t b = (uint64_t)b_val;                                              \
+    if (kain_both_int(a, b))                                                   \
+      return KAIN_OP_BOOL(kain_unbox_int(a) op kain_unbox_int(b));             \
+    return KAIN_OP_BOOL(kain_operand(a, #op) op kain_operand(b, #op));         \
+  }
+
+KAIN_CMP_OP(lt, <)
+KAIN_CMP_OP(gt, >)
+KAIN_CMP_OP(le, <=)
+KAIN_CMP_OP(ge, >=)
+
+#undef KAIN_CMP_OP
+
+int64_t kain_eq_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  return kain_str_eq(a_val, b_val);
+}
+#else
+// Helper to unbox integer with V1 compatibility
+static int64_t unbox_int_v1(uint64_t val, int64_t raw_val) {
+  if (kain_is_int(val)) {
+    return kain_unbox_int(val);
+  } else if (raw_val < NANBOX_QNAN) {
+    return raw_val; // Already raw
+  }
+  return raw_val; // Fallback
+}
+
+int64_t kain_lt_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
+  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
+  return a < b ? 1 : 0; // Raw boolean
+}
+
+int64_t kain_gt_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
+  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
+  return a > b ? 1 : 0; // Raw boolean
+}
+
+int64_t kain_le_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
+  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
+  return a <= b ? 1 : 0; // Raw boolean
+}
+
+int64_t kain_ge_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
+  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
+  return a >= b ? 1 : 0; // Raw boolean
+}
+
+int64_t kain_eq_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  // Fast path: bit-identical
+  if (a_val == b_val)
+    return 1;
+
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+
+  // If both are integers (boxed or raw), compare them
+  if (kain_is_int(a) && kain_is_int(b)) {
+    return kain_unbox_int(a) == kain_unbox_int(b);
+  }
+
+  // V1 compatibility: unbox integers before comparing
+  int64_t ua = unbox_int_v1(a, a_val);
+  int64_t ub = unbox_int_v1(b, b_val);
+  if (ua == ub && (ua != a_val || ub != b_val)) {
+    return 1;
+  }
+
+  // Only fall back to string comparison if both are potentially strings
+  if (kain_is_string(a) || kain_is_string(b) ||
+      (a < NANBOX_QNAN && a > 0x10000) || (b < NANBOX_QNAN && b > 0x10000)) {
+    // kain_str_eq returns kain_TRUE/kain_FALSE, we need truthy check
+    int64_t res = kain_str_eq(a_val, b_val);
+    return kain_is_truthy(res);
+  }
+
+  return 0;
+}
+#endif // KAIN_STRICT_NANBOX
+
+int64_t kain_neq_op(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  return KAIN_OP_BOOL(kain_eq_op(a_val, b_val) == KAIN_OP_BOOL(0));
+}
+
+int64_t kain_ord(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  const char *str = (const char *)kain_unbox_any_ptr(str_val);
+  if (!str || !*str)
+    return (int64_t)kain_box_int(0);
+  return (int64_t)kain_box_int(str[0]);
+}
+
+int64_t kain_chr(int64_t code_val) {
+  KAIN_PROFILE_CALL();
+  // Auto-unbox NaN-boxed integer
+  int64_t code = kain_is_int((uint64_t)code_val)
+                     ? kain_unbox_int((uint64_t)code_val)
+                     : code_val;
+
+  return kain_char_str(code);
+}
+
+// Get character code at index in string (for efficient lexer)
+int64_t kain_char_code_at(int64_t str_val, int64_t index_val) {
+  KAIN_PROFILE_CALL();
+  // Auto-unbox NaN-boxed string and index
+  KainStrRef str = kain_str_ref(str_val);
+
+  int64_t index = kain_is_int((uint64_t)index_val)
+                      ? kain_unbox_int((uint64_t)index_val)
+                      : index_val;
+
+  if (!str.ptr || index < 0 || (size_t)index >= str.len)
+    return (int64_t)kain_box_int(0);
+  return (int64_t)kain_box_int((unsigned char)str.ptr[index]);
+}
+
+// Create single-character string from code (for efficient lexer)
+int64_t kain_char_from_code(int64_t code_val) {
+  KAIN_PROFILE_CALL();
+  // Auto-unbox NaN-boxed integer
+  int64_t code = kain_is_int((uint64_t)code_val)
+                     ? kain_unbox_int((uint64_t)code_val)
+                     : code_val;
+
+  return kain_char_str(code);
+}
+
+// Get single character at index as string (for compatibility)
+int64_t kain_char_at(int64_t str_val, int64_t index_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef str = kain_str_ref(str_val);
+  int64_t index = kain_is_int((uint64_t)index_val)
+                      ? kain_unbox_int((uint64_t)index_val)
+                      : index_val;
+
+  if (!str.ptr || index < 0 || (size_t)index >= str.len)
+    return (int64_t)kain_box_string(kain_str_new(""));
+  return kain_char_str(str.ptr[index]);
+}
+
+// Raw byte pointer of a string value, for codegen that indexes directly
+const char *kain_str_data(int64_t str_val) {
+  KainStrRef r = kain_str_ref(str_val);
+  return r.ptr ? r.ptr : "";
+}
+
+// Byte iterator: walks a string yielding byte codes as boxed ints, so a
+// lexer never materializes per-character strings. Yields -1 past the end.
+typedef struct {
+  KainObjHeader obj;
+  const char *ptr;
+  int64_t len;
+  int64_t pos;
+  int64_t source; // Keeps the iterated string reachable
+} KainByteIter;
+
+static inline KainByteIter *kain_unbox_byte_iter(int64_t val) {
+  return (KainByteIter *)kain_unbox_obj((uint64_t)val, KAIN_OBJ_BYTE_ITER);
+}
+
+int64_t kain_bytes_iter(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef r = kain_str_ref(str_val);
+  KainByteIter *it = (KainByteIter *)arena_alloc_as(sizeof(KainByteIter), KAIN_GC_OBJ);
+  it->obj.kind = KAIN_OBJ_BYTE_ITER;
+  it->obj.flags = 0;
+  it->ptr = r.ptr ? r.ptr : "";
+  it->len = (int64_t)r.len;
+  it->pos = 0;
+  it->source = str_val;
+  return (int64_t)kain_BOX_OBJ(it);
+}
+
+int64_t kain_bytes_next(int64_t it_val) {
+  KAIN_PROFILE_CALL();
+  KainByteIter *it = kain_unbox_byte_iter(it_val);
+  if (!it || it->pos >= it->len)
+    return (int64_t)kain_box_int(-1);
+  return (int64_t)kain_box_int((unsigned char)it->ptr[it->pos++]);
+}
+
+// Byte at pos + offset without advancing
+int64_t kain_bytes_peek(int64_t it_val, int64_t offset_val) {
+  KAIN_PROFILE_CALL();
+  KainByteIter *it = kain_unbox_byte_iter(it_val);
+  int64_t offset = kain_is_int((uint64_t)offset_val)
+                       ? kain_unbox_int((uint64_t)offset_val)
+                       : offset_val;
+  if (!it)
+    return (int64_t)kain_box_int(-1);
+  int64_t idx = it->pos + offset;
+  if (idx < 0 || idx >= it->len)
+    return (int64_t)kain_box_int(-1);
+  return (int64_t)kain_box_int((unsigned char)it->ptr[idx]);
+}
+
+int64_t kain_bytes_pos(int64_t it_val) {
+  KAIN_PROFILE_CALL();
+  KainByteIter *it = kain_unbox_byte_iter(it_val);
+  return (int64_t)kain_box_int(it ? it->pos : 0);
+}
+
+// =============================================================================
+// Array Operations (heap-allocated dynamic arrays)
+// =============================================================================
+
+typedef struct {
+  int64_t *data;
+  int64_t len;
+  int64_t cap; // Element capacity, plus the KAIN_ARRAY_* ownership bits
+} KainArray;
+
+// Slices may borrow their parent's buffer. While any view exists neither
+// side may write to, realloc or free the shared buffer; the first mutation
+// copies into a private buffer instead (the old one stays with the views).
+#define KAIN_ARRAY_BORROWED (1LL << 62) // `data` points into another buffer
+#define KAIN_ARRAY_SHARED (1LL << 61)   // Views point into `data`
+#define KAIN_ARRAY_COW (KAIN_ARRAY_BORROWED | KAIN_ARRAY_SHARED)
+// New arrays start out storing their first few elements in slots right
+// after the header, so the many 1-4 element arrays never touch malloc. The
+// slots can be written but not realloc'd or freed; growing past them copies.
+#define KAIN_ARRAY_INLINE (1LL << 60) // `data` is the header's inline slots
+#define KAIN_ARRAY_FLAGS (KAIN_ARRAY_COW | KAIN_ARRAY_INLINE)
+#define KAIN_ARRAY_CAP(arr) ((arr)->cap & ~KAIN_ARRAY_FLAGS)
+// Whether `data` is a malloc'd buffer this array must free
+#define KAIN_ARRAY_OWNS_DATA(arr) ((arr)->data && !((arr)->cap & KAIN_ARRAY_FLAGS))
+
+// Header plus inline slots fill one 64-byte pool class exactly
+#define KAIN_ARRAY_INLINE_CAP 5
+typedef struct {
+  KainArray arr;
+  int64_t slots[KAIN_ARRAY_INLINE_CAP];
+} KainSmallArray;
+
+// Slices at least this long borrow instead of copying, provided they cover
+// half the parent or more; a later write to the parent then copies at most
+// twice what an eager slice would have.
+#define KAIN_ARRAY_VIEW_MIN 16
+
+// Give `arr` a private buffer of at least `min_cap` elements
+static void kain_array_detach(KainArray *arr, int64_t min_cap) {
+  int64_t new_cap = arr->len > 8 ? arr->len : 8;
+  while (new_cap < min_cap)
+    new_cap *= 2;
+  KAIN_PROFILE_COUNT(KAIN_PROF_GROWTHS, 1);
+  int64_t *data = (int64_t *)malloc((size_t)new_cap * sizeof(int64_t));
+  if (!data) {
+    fprintf(stderr, "FATAL: OOM in kain_array_detach\n");
+    exit(1);
+  }
+  if (arr->len)
+    memcpy(data, arr->data, (size_t)arr->len * sizeof(int64_t));
+  arr->data = data;
+  arr->cap = new_cap;
+}
+
+// We store arrays as pointers cast to i64
+int64_t kain_array_new() {
+  KAIN_PROFILE_CALL();
+  KainSmallArray *small = (KainSmallArray *)arena_alloc_small(
+      sizeof(KainSmallArray), KAIN_GC_ARRAY);
+  KainArray *arr = &small->arr;
+  arr->data = small->slots;
+  arr->len = 0;
+  arr->cap = KAIN_ARRAY_INLINE_CAP | KAIN_ARRAY_INLINE;
+  region_track(arr, KAIN_GC_ARRAY);
+  return (int64_t)arr;
+}
+
+// Empty array with room for exactly `n` elements (raw, like kain_array_new)
+static KainArray *kain_array_reserve(int64_t n) {
+  KainArray *arr = (KainArray *)kain_array_new();
+  if (n > KAIN_ARRAY_INLINE_CAP) {
+    arr->data = (int64_t *)malloc((size_t)n * sizeof(int64_t));
+    if (!arr->data) {
+      fprintf(stderr, "FATAL: OOM in kain_array_with_capacity (%lld)\n",
+              (long long)n);
+      exit(1);
+    }
+    arr->cap = n;
+  }
+  return arr;
+}
+
+// Lazy range: range(start, end) yields start, start + step, ... without
+// allocating the elements. len/index/for read it directly; any other array
+// operation materializes it once into `array`, which is used from then on.
+typedef struct {
+  KainObjHeader obj;
+  int64_t start;
+  int64_t end;
+  int64_t step;
+  int64_t array; // Materialized KainArray, 0 until needed
+} KainRange;
+
+static inline KainRange *kain_unbox_range(int64_t val) {
+  return (KainRange *)kain_unbox_obj((uint64_t)val, KAIN_OBJ_RANGE);
+}
+
+static int64_t kain_range_count(const KainRange *r) {
+  if (r->array)
+    return ((KainArray *)r->array)->len;
+  if (r->step > 0)
+    return r->end > r->start ? (r->end - r->start - 1) / r->step + 1 : 0;
+  return r->start > r->end ? (r->start - r->end - 1) / -r->step + 1 : 0;
+}
+
+static void *kain_range_array(uint64_t v) {
+  KainRange *r = kain_unbox_range((int64_t)v);
+  if (!r)
+    return NULL;
+  if (!r->array) {
+    int64_t n = kain_range_count(r);
+    KainArray *arr = kain_array_reserve(n);
+    for (int64_t i = 0; i < n; i++)
+      arr->data[i] = (int64_t)kain_box_int(r->start + i * r->step);
+    arr->len = n;
+    r->array = (int64_t)arr;
+  }
+  return (void *)r->array;
+}
+
+// Element i of an unmaterialized range, raw index, boxed result
+static inline int64_t kain_range_at(const KainRange *r, int64_t i) {
+  if (r->array)
+    return ((KainArray *)r->array)->data[i];
+  return (int64_t)kain_box_int(r->start + i * r->step);
+}
+
+// Typed arrays keep raw int64 / double / byte elements in one contiguous
+// buffer so numeric loops neither box nor chase tags. Elements are boxed
+// only at the get/set boundary; the kernels below work on the raw data.
+typedef struct {
+  KainObjHeader obj; // kind = KAIN_OBJ_{I64,F64,U8}_ARRAY
+  int64_t len;
+  int64_t cap;
+  void *data;
+} KainTypedArray;
+
+static inline KainTypedArray *kain_unbox_typed(int64_t val) {
+  uint64_t v = (uint64_t)val;
+  if (!kain_IS_OBJ(v))
+    return NULL;
+  KainTypedArray *a = (KainTypedArray *)kain_UNBOX_PTR(v);
+  return a && a->obj.kind >= KAIN_OBJ_I64_ARRAY &&
+                 a->obj.kind <= KAIN_OBJ_U8_ARRAY
+             ? a
+             : NULL;
+}
+
+static inline size_t kain_typed_elem_size(const KainTypedArray *a) {
+  return a->obj.kind == KAIN_OBJ_U8_ARRAY ? 1 : 8;
+}
+
+// Numeric argument as a double: boxed ints, raw V1 ints and doubles
+static inline double kain_num_arg(int64_t val) {
+  uint64_t v = (uint64_t)val;
+  if (kain_is_int(v))
+    return (double)kain_unbox_int(v);
+  return v < KAIN_DOUBLE_MIN ? (double)val : kain_unbox_double(v);
+}
+
+// Numeric argument as an integer (doubles truncate)
+static inline int64_t kain_int_num_arg(int64_t val) {
+  uint64_t v = (uint64_t)val;
+  if (kain_is_int(v))
+    return kain_unbox_int(v);
+  return v < KAIN_DOUBLE_MIN ? val : (int64_t)kain_unbox_double(v);
+}
+
+static inline int64_t kain_typed_at(const KainTypedArray *a, int64_t i) {
+  switch (a->obj.kind) {
+  case KAIN_OBJ_F64_ARRAY:
+    return (int64_t)kain_box_double(((double *)a->data)[i]);
+  case KAIN_OBJ_U8_ARRAY:
+    return (int64_t)kain_box_int(((uint8_t *)a->data)[i]);
+  default:
+    return (int64_t)kain_box_int(((int64_t *)a->data)[i]);
+  }
+}
+
+static inline void kain_typed_store(KainTypedArray *a, int64_t i,
+                                    int64_t value) {
+  switch (a->obj.kind) {
+  case KAIN_OBJ_F64_ARRAY:
+    ((double *)a->data)[i] = kain_num_arg(value);
+    break;
+  case KAIN_OBJ_U8_ARRAY:
+    ((uint8_t *)a->data)[i] = (uint8_t)kain_int_num_arg(value);
+    break;
+  default:
+    ((int64_t *)a->data)[i] = kain_int_num_arg(value);
+    break;
+  }
+}
+
+// len/index over the array-like objects (ranges and typed arrays)
+static inline int64_t kain_obj_len(int64_t val) {
+  KainTypedArray *a = kain_unbox_typed(val);
+  if (a)
+    return a->len;
+  KainRange *r = kain_unbox_range(val);
+  return r ? kain_range_count(r) : 0;
+}
+
+static inline int64_t kain_obj_at(int64_t val, int64_t i) {
+  KainTypedArray *a = kain_unbox_typed(val);
+  if (a)
+    return kain_typed_at(a, i);
+  return kain_range_at(kain_unbox_range(val), i);
+}
+
+static void kain_typed_push(KainTypedArray *a, int64_t value);
+
+int64_t kain_array_push(int64_t arr_val, int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_unbox_typed(arr_val);
+  if (a) {
+    kain_typed_push(a, value);
+    return arr_val;
+  }
+
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  if (!arr)
+    return 0;
+
+  if (arr->cap & KAIN_ARRAY_FLAGS) {
+    // Borrowed or shared buffers copy on write; inline slots copy when full
+    if ((arr->cap & KAIN_ARRAY_COW) || arr->len >= KAIN_ARRAY_CAP(arr))
+      kain_array_detach(arr, arr->len + 1);
+  } else if (arr->len >= arr->cap) {
+    int64_t new_cap = arr->cap == 0 ? 8 : arr->cap * 2;
+    KAIN_PROFILE_COUNT(KAIN_PROF_GROWTHS, 1);
+    arr->data = (int64_t *)realloc(arr->data, new_cap * sizeof(int64_t));
+    if (!arr->data) {
+      fprintf(stderr, "FATAL: OOM in kain_array_push\n");
+      exit(1);
+    }
+    arr->cap = new_cap;
+  }
+
+  if (!arr->data) {
+    fprintf(stderr, "FATAL: arr->data is NULL even after realloc! cap=%lld\n",
+            arr->cap);
+    exit(1);
+  }
+
+  arr->data[arr->len] = value;
+  arr->len++;
+  return arr_val;
+}
+
+int64_t kain_array_pop(int64_t arr_val) {
+  KAIN_PROFILE_CALL();
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  if (!arr)
+    return 0;
+
+  if (arr->len == 0)
+    return 0;
+  return arr->data[--arr->len];
+}
+
+// Index argument: raw V1 ints pass through, tagged ints are unboxed
+static inline int64_t kain_index_arg(int64_t index_val) {
+  return (uint64_t)index_val < NANBOX_QNAN ? index_val
+                                           : kain_unbox_int((uint64_t)index_val);
+}
+
+// Empty array that takes `n` pushes without reallocating
+int64_t kain_array_with_capacity(int64_t cap_val) {
+  KAIN_PROFILE_CALL();
+  return (int64_t)kain_array_reserve(kain_index_arg(cap_val));
+}
+
+// Out-of-bounds report for kain_array_get. Kept out of line and cold so the
+// checked accessor stays small enough to inline.
+static KAIN_COLD void kain_array_oob(KainArray *arr, int64_t index,
+                                     int64_t index_val) {
+  fprintf(stderr,
+          "\n═══════════════════════════════════════════════════════════\n");
+  fprintf(stderr, "ERROR: Array index out of bounds\n");
+  fprintf(stderr,
+          "═══════════════════════════════════════════════════════════\n\n");
+
+  fprintf(stderr, "Array Information:\n");
+  fprintf(stderr, "  Address:  %p\n", (void *)arr);
+  fprintf(stderr, "  Length:   %lld\n", (long long)arr->len);
+  fprintf(stderr, "  Capacity: %lld\n", (long long)KAIN_ARRAY_CAP(arr));
+  fprintf(stderr, "  Data ptr: %p\n", (void *)arr->data);
+
+  fprintf(stderr, "\nIndex Information:\n");
+  fprintf(stderr, "  Requested index: %lld\n", (long long)index);
+  fprintf(stderr, "  Index (raw):     0x%llx\n",
+          (unsigned long long)index_val);
+  if (index_val >= NANBOX_QNAN) {
+    fprintf(stderr, "  Index (boxed):   0x%llx (NaN-boxed integer)\n",
+            (unsigned long long)index_val);
+  }
+  fprintf(stderr, "  Valid range:     0 <= index < %lld\n",
+          (long long)arr->len);
+
+  if (arr->len > 0 && arr->data) {
+    fprintf(stderr, "\nArray Contents Preview:\n");
+    int show_count = arr->len < 5 ? (int)arr->len : 5;
+    for (int i = 0; i < show_count; i++) {
+      fprintf(stderr, "  arr[%d] = 0x%llx\n", i,
+              (unsigned long long)arr->data[i]);
+    }
+    if (arr->len > 5) {
+      fprintf(stderr, "  ... (%lld more elements)\n",
+              (long long)(arr->len - 5));
+    }
+  }
+
+  fprintf(stderr, "\nLikely Causes:\n");
+  if (index == arr->len) {
+    fprintf(stderr, "   Index equals length - off-by-one error\n");
+    fprintf(stderr, "    - Using 1-based indexing instead of 0-based\n");
+    fprintf(stderr,
+            "    - Loop condition should be 'i < len' not 'i <= len'\n");
+  } else if (index == index_val && index_val >= NANBOX_QNAN) {
+    fprintf(stderr, "   Using boxed integer directly as index\n");
+    fprintf(stderr,
+            "    - Variable assignment may not be storing computed value\n");
+    fprintf(stderr, "    - Let-binding codegen bug in bootstrap compiler\n");
+    fprintf(stderr, "    - Expression result not being used\n");
+  } else if (index > arr->len + 100) {
+    fprintf(stderr, "   Index is very large - possible memory corruption\n");
+    fprintf(stderr, "    - Uninitialized variable\n");
+    fprintf(stderr, "    - Pointer arithmetic error\n");
+  } else {
+    fprintf(stderr, "  - Check loop bounds and index calculations\n");
+    fprintf(stderr, "  - Verify array was populated correctly\n");
+  }
+
+  fprintf(stderr, "\nStack Trace:\n");
+  kain_print_stack_trace();
+  fprintf(stderr,
+          "═══════════════════════════════════════════════════════════\n\n");
+  fflush(stderr);
+  exit(1);
+}
+
+int64_t kain_array_get(int64_t arr_val, int64_t index_val) {
+  KAIN_PROFILE_CALL();
+  if (kain_IS_OBJ((uint64_t)arr_val)) {
+    if (!kain_unbox_typed(arr_val) && !kain_unbox_range(arr_val))
+      return 0;
+    int64_t index = kain_index_arg(index_val);
+    int64_t len = kain_obj_len(arr_val);
+    if ((uint64_t)index >= (uint64_t)len) {
+      fprintf(stderr, "FATAL: Array index out of bounds: %lld (len=%lld)\n",
+              (long long)index, (long long)len);
+      kain_flush();
+      exit(1);
+    }
+    return kain_obj_at(arr_val, index);
+  }
+
+  // Auto-unbox NaN-boxed array pointer
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  if (!arr)
+    return 0;
+
+  int64_t index = kain_index_arg(index_val);
+  if ((uint64_t)index >= (uint64_t)arr->len)
+    kain_array_oob(arr, index, index_val);
+  return arr->data[index];
+}
+
+// Array handle as passed by codegen: raw pointer, kain_TAG_PTR box or a
+// range (materialized)
+static inline KainArray *kain_array_ref(int64_t arr_val) {
+  uint64_t v = (uint64_t)arr_val;
+  if (v < NANBOX_QNAN)
+    return (KainArray *)v;
+  return (KainArray *)(kain_IS_OBJ(v) ? kain_range_array(v) : kain_UNBOX_PTR(v));
+}
+
+// Unchecked accessors for code that has already bounds-checked (e.g. a for
+// loop that compared against kain_array_len_raw once). `index` is raw.
+int64_t kain_array_get_fast(int64_t arr_val, int64_t index) {
+  KAIN_PROFILE_CALL();
+  if (kain_IS_OBJ((uint64_t)arr_val))
+    return kain_obj_at(arr_val, index);
+  return kain_array_ref(arr_val)->data[index];
+}
+
+void kain_array_set_fast(int64_t arr_val, int64_t index, int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_unbox_typed(arr_val);
+  if (a) {
+    kain_typed_store(a, index, value);
+    return;
+  }
+  KainArray *arr = kain_array_ref(arr_val);
+  if (arr->cap & KAIN_ARRAY_COW)
+    kain_array_detach(arr, arr->len);
+  arr->data[index] = value;
+}
+
+// Element buffer for direct indexing, valid until the array next grows.
+// Read-only: writes must go through kain_array_set* (copy-on-write views).
+int64_t *kain_array_data_ptr(int64_t arr_val) {
+  KAIN_PROFILE_CALL();
+  KainArray *arr = kain_array_ref(arr_val);
+  return arr ? arr->data : NULL;
+}
+
+// Raw (unboxed) length, 0 for null
+int64_t kain_array_len_raw(int64_t arr_val) {
+  KAIN_PROFILE_CALL();
+  if (kain_IS_OBJ((uint64_t)arr_val))
+    return kain_obj_len(arr_val);
+  KainArray *arr = kain_array_ref(arr_val);
+  return arr ? arr->len : 0;
+}
+
+void kain_array_set(int64_t arr_val, int64_t index_val, int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_unbox_typed(arr_val);
+  if (a) {
+    int64_t index = kain_index_arg(index_val);
+    if ((uint64_t)index >= (uint64_t)a->len) {
+      fprintf(stderr, "FATAL: Array SET index out of bounds: %lld (len=%lld)\n",
+              (long long)index, (long long)a->len);
+      exit(1);
+    }
+    kain_typed_store(a, index, value);
+    return;
+  }
+
+  // Auto-unbox NaN-boxed array pointer and index
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  if (!arr)
+    return;
+
+  int64_t index = kain_index_arg(index_val);
+  if ((uint64_t)index >= (uint64_t)arr->len) {
+    fprintf(stderr, "FATAL: Array SET index out of bounds: %lld (len=%lld)\n",
+            (long long)index, (long long)arr->len);
+    exit(1);
+  }
+  if (arr->cap & KAIN_ARRAY_COW)
+    kain_array_detach(arr, arr->len);
+  arr->data[index] = value;
+}
+
+int64_t kain_array_len(int64_t arr_val) {
+  KAIN_PROFILE_CALL();
+  if (kain_IS_OBJ((uint64_t)arr_val))
+    return (int64_t)kain_box_int(kain_array_len_raw(arr_val));
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  if (!arr)
+    return 0;
+
+  // Return boxed integer for V1/V2 compatibility
+  return (int64_t)kain_box_int(arr->len);
+}
+
+void kain_array_free(int64_t arr_ptr) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_unbox_typed(arr_ptr);
+  if (a) {
+    free(a->data);
+    a->data = NULL;
+    a->len = a->cap = 0;
+    return;
+  }
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_ptr);
+  if (!arr)
+    return;
+  // The header lives in the arena; only the element buffer is malloc'd, and
+  // a shared or borrowed one still belongs to the views
+  if (KAIN_ARRAY_OWNS_DATA(arr))
+    free(arr->data);
+  arr->data = NULL;
+  arr->len = 0;
+  arr->cap = 0;
+}
+
+// kain_array_free() for an array nothing refers to any more: its header is
+// recycled too. Typed arrays and ranges only give up their storage.
+int64_t kain_array_drop(int64_t arr_ptr) {
+  KAIN_PROFILE_CALL();
+  kain_array_free(arr_ptr);
+  uint64_t v = (uint64_t)arr_ptr;
+  if (v >= NANBOX_QNAN && kain_get_tag(v) != kain_TAG_PTR)
+    return (int64_t)kain_box_null();
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_ptr);
+  // Inside a region the header may be on the region's list: leave it to
+  // the release rather than hand the slot to another object
+  if (arr && region_depth == 0)
+    arena_free_small(arr, sizeof(KainSmallArray));
+  return (int64_t)kain_box_null();
+}
+
+// =============================================================================
+// Typed Arrays (raw i64 / f64 / u8 storage)
+// =============================================================================
+
+// GCC only vectorizes at -O3 unless asked; clang already does at -O2
+#if defined(__GNUC__) && !defined(__clang__)
+#define KAIN_VECTORIZE __attribute__((optimize("tree-vectorize")))
+#else
+#define KAIN_VECTORIZE
+#endif
+
+static int64_t kain_typed_new(uint32_t kind, int64_t len) {
+  if (len < 0)
+    len = 0;
+  KainTypedArray *a = (KainTypedArray *)arena_alloc_as(sizeof(KainTypedArray), KAIN_GC_OBJ);
+  a->obj.kind = kind;
+  a->obj.flags = 0;
+  a->len = len;
+  a->cap = len > 0 ? len : 8;
+  a->data = calloc((size_t)a->cap, kain_typed_elem_size(a));
+  if (!a->data) {
+    fprintf(stderr, "FATAL: OOM in kain_typed_new\n");
+    exit(1);
+  }
+  region_track(a, KAIN_GC_OBJ);
+  return (int64_t)kain_BOX_OBJ(a);
+}
+
+// Zero-filled typed arrays of `len` elements
+int64_t kain_i64_array(int64_t len_val) {
+  KAIN_PROFILE_CALL();
+  return kain_typed_new(KAIN_OBJ_I64_ARRAY, kain_index_arg(len_val));
+}
+
+int64_t kain_f64_array(int64_t len_val) {
+  KAIN_PROFILE_CALL();
+  return kain_typed_new(KAIN_OBJ_F64_ARRAY, kain_index_arg(len_val));
+}
+
+int64_t kain_u8_array(int64_t len_val) {
+  KAIN_PROFILE_CALL();
+  return kain_typed_new(KAIN_OBJ_U8_ARRAY, kain_index_arg(len_val));
+}
+
+// Typed copy of any array-like value (elements converted per kind)
+static int64_t kain_typed_from(uint32_t kind, int64_t src_val) {
+  int64_t n = kain_array_len_raw(src_val);
+  int64_t dst_val = kain_typed_new(kind, n);
+  KainTypedArray *dst = kain_unbox_typed(dst_val);
+  for (int64_t i = 0; i < n; i++)
+    kain_typed_store(dst, i, kain_array_get_fast(src_val, i));
+  return dst_val;
+}
+
+int64_t kain_to_i64_array(int64_t src) {
+  KAIN_PROFILE_CALL();
+  return kain_typed_from(KAIN_OBJ_I64_ARRAY, src);
+}
+int64_t kain_to_f64_array(int64_t src) {
+  KAIN_PROFILE_CALL();
+  return kain_typed_from(KAIN_OBJ_F64_ARRAY, src);
+}
+int64_t kain_to_u8_array(int64_t src) {
+  KAIN_PROFILE_CALL();
+  return kain_typed_from(KAIN_OBJ_U8_ARRAY, src);
+}
+
+static void kain_typed_push(KainTypedArray *a, int64_t value) {
+  if (a->len >= a->cap) {
+    int64_t new_cap = a->cap * 2;
+    KAIN_PROFILE_COUNT(KAIN_PROF_GROWTHS, 1);
+    void *data = realloc(a->data, (size_t)new_cap * kain_typed_elem_size(a));
+    if (!data) {
+      fprintf(stderr, "FATAL: OOM in kain_typed_push\n");
+      exit(1);
+    }
+    a->data = data;
+    a->cap = new_cap;
+  }
+  kain_typed_store(a, a->len++, value);
+}
+
+static KainTypedArray *kain_typed_arg(int64_t val, const char *fn) {
+  KainTypedArray *a = kain_unbox_typed(val);
+  if (!a) {
+    fprintf(stderr, "FATAL: %s expects an i64/f64/u8 array\n", fn);
+    kain_flush();
+    exit(1);
+  }
+  return a;
+}
+
+// Reductions use four independent accumulators so they vectorize (and
+// pipeline) without -ffast-math reassociation.
+static KAIN_VECTORIZE int64_t kain_sum_i64(const int64_t *restrict x,
+                                           int64_t n) {
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += (uint64_t)x[i];
+    s1 += (uint64_t)x[i + 1];
+    s2 += (uint64_t)x[i + 2];
+    s3 += (uint64_t)x[i + 3];
+  }
+  for (; i < n; i++)
+    s0 += (uint64_t)x[i];
+  return (int64_t)(s0 + s1 + s2 + s3);
+}
+
+static KAIN_VECTORIZE double kain_sum_f64(const double *restrict x,
+                                          int64_t n) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += x[i];
+    s1 += x[i + 1];
+    s2 += x[i + 2];
+    s3 += x[i + 3];
+  }
+  for (; i < n; i++)
+    s0 += x[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+static KAIN_VECTORIZE int64_t kain_sum_u8(const uint8_t *restrict x,
+                                          int64_t n) {
+  uint64_t s = 0;
+  for (int64_t i = 0; i < n; i++)
+    s += x[i];
+  return (int64_t)s;
+}
+
+static KAIN_VECTORIZE int64_t kain_dot_i64(const int64_t *restrict x,
+                                           const int64_t *restrict y,
+                                           int64_t n) {
+  uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += (uint64_t)x[i] * (uint64_t)y[i];
+    s1 += (uint64_t)x[i + 1] * (uint64_t)y[i + 1];
+    s2 += (uint64_t)x[i + 2] * (uint64_t)y[i + 2];
+    s3 += (uint64_t)x[i + 3] * (uint64_t)y[i + 3];
+  }
+  for (; i < n; i++)
+    s0 += (uint64_t)x[i] * (uint64_t)y[i];
+  return (int64_t)(s0 + s1 + s2 + s3);
+}
+
+static KAIN_VECTORIZE double kain_dot_f64(const double *restrict x,
+                                          const double *restrict y,
+                                          int64_t n) {
+  double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int64_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    s0 += x[i] * y[i];
+    s1 += x[i + 1] * y[i + 1];
+    s2 += x[i + 2] * y[i + 2];
+    s3 += x[i + 3] * y[i + 3];
+  }
+  for (; i < n; i++)
+    s0 += x[i] * y[i];
+  return (s0 + s1) + (s2 + s3);
+}
+
+static KAIN_VECTORIZE int64_t kain_dot_u8(const uint8_t *restrict x,
+                                          const uint8_t *restrict y,
+                                          int64_t n) {
+  uint64_t s = 0;
+  for (int64_t i = 0; i < n; i++)
+    s += (uint32_t)x[i] * y[i];
+  return (int64_t)s;
+}
+
+// Sum of the elements: Int for i64/u8 arrays, Float for f64. Plain arrays
+// fall back to folding kain_add_op.
+int64_t kain_array_sum(int64_t arr_val) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_unbox_typed(arr_val);
+  if (!a) {
+    int64_t acc = (int64_t)kain_box_int(0);
+    int64_t n = kain_array_len_raw(arr_val);
+    for (int64_t i = 0; i < n; i++)
+      acc = kain_add_op(acc, kain_array_get_fast(arr_val, i));
+    return acc;
+  }
+  switch (a->obj.kind) {
+  case KAIN_OBJ_F64_ARRAY:
+    return (int64_t)kain_box_double(kain_sum_f64(a->data, a->len));
+  case KAIN_OBJ_U8_ARRAY:
+    return (int64_t)kain_box_int(kain_sum_u8(a->data, a->len));
+  default:
+    return (int64_t)kain_box_int(kain_sum_i64(a->data, a->len));
+  }
+}
+
+int64_t kain_array_dot(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_typed_arg(a_val, "array_dot");
+  KainTypedArray *b = kain_typed_arg(b_val, "array_dot");
+  if (a->obj.kind != b->obj.kind || a->len != b->len) {
+    fprintf(stderr,
+            "FATAL: array_dot needs arrays of the same kind and length "
+            "(%lld vs %lld)\n",
+            (long long)a->len, (long long)b->len);
+    kain_flush();
+    exit(1);
+  }
+  switch (a->obj.kind) {
+  case KAIN_OBJ_F64_ARRAY:
+    return (int64_t)kain_box_double(kain_dot_f64(a->data, b->data, a->len));
+  case KAIN_OBJ_U8_ARRAY:
+    return (int64_t)kain_box_int(kain_dot_u8(a->data, b->data, a->len));
+  default:
+    return (int64_t)kain_box_int(kain_dot_i64(a->data, b->data, a->len));
+  }
+}
+
+// In-place multiply by `k`; returns the array
+int64_t kain_array_scale(int64_t arr_val, int64_t k_val) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_typed_arg(arr_val, "array_scale");
+  int64_t n = a->len;
+  if (a->obj.kind == KAIN_OBJ_F64_ARRAY) {
+    double k = kain_num_arg(k_val);
+    double *restrict x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      x[i] *= k;
+  } else if (a->obj.kind == KAIN_OBJ_U8_ARRAY) {
+    uint8_t k = (uint8_t)kain_int_num_arg(k_val);
+    uint8_t *restrict x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      x[i] = (uint8_t)(x[i] * k);
+  } else {
+    uint64_t k = (uint64_t)kain_int_num_arg(k_val);
+    uint64_t *restrict x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      x[i] *= k;
+  }
+  return arr_val;
+}
+
+int64_t kain_array_fill(int64_t arr_val, int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_typed_arg(arr_val, "array_fill");
+  int64_t n = a->len;
+  if (a->obj.kind == KAIN_OBJ_U8_ARRAY) {
+    memset(a->data, (uint8_t)kain_int_num_arg(value), (size_t)n);
+  } else if (a->obj.kind == KAIN_OBJ_F64_ARRAY) {
+    double v = kain_num_arg(value);
+    double *restrict x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      x[i] = v;
+  } else {
+    int64_t v = kain_int_num_arg(value);
+    int64_t *restrict x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      x[i] = v;
+  }
+  return arr_val;
+}
+
+// Element-wise equality (f64 uses ==, so NaN never matches)
+int64_t kain_array_equal(int64_t a_val, int64_t b_val) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_typed_arg(a_val, "array_equal");
+  KainTypedArray *b = kain_typed_arg(b_val, "array_equal");
+  if (a->obj.kind != b->obj.kind || a->len != b->len)
+    return (int64_t)kain_box_bool(0);
+  if (a->obj.kind != KAIN_OBJ_F64_ARRAY)
+    return (int64_t)kain_box_bool(
+        memcmp(a->data, b->data, (size_t)a->len * kain_typed_elem_size(a)) ==
+        0);
+  const double *x = a->data, *y = b->data;
+  int64_t diff = 0;
+  for (int64_t i = 0; i < a->len; i++)
+    diff |= x[i] != y[i];
+  return (int64_t)kain_box_bool(!diff);
+}
+
+// Index of the first element equal to `value`, or -1
+int64_t kain_array_find(int64_t arr_val, int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainTypedArray *a = kain_unbox_typed(arr_val);
+  int64_t n = a ? a->len : kain_array_len_raw(arr_val);
+  int64_t found = -1;
+  if (!a) {
+    for (int64_t i = 0; i < n && found < 0; i++)
+      if (kain_str_eq(kain_array_get_fast(arr_val, i), value) == kain_TRUE)
+        found = i;
+  } else if (a->obj.kind == KAIN_OBJ_U8_ARRAY) {
+    int64_t v = kain_int_num_arg(value);
+    const uint8_t *p =
+        v >= 0 && v <= 255 ? memchr(a->data, (int)v, (size_t)n) : NULL;
+    found = p ? p - (const uint8_t *)a->data : -1;
+  } else if (a->obj.kind == KAIN_OBJ_F64_ARRAY) {
+    double v = kain_num_arg(value);
+    const double *x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      if (x[i] == v) {
+        found = i;
+        break;
+      }
+  } else {
+    int64_t v = kain_int_num_arg(value);
+    const int64_t *x = a->data;
+    for (int64_t i = 0; i < n; i++)
+      if (x[i] == v) {
+        found = i;
+        break;
+      }
+  }
+  return (int64_t)kain_box_int(found);
+}
+
+// =============================================================================
+// Helper Functions (Stdlib)
+// =============================================================================
+
+// String substring search (strstr-based)
+int64_t kain_str_contains(int64_t str_ptr, int64_t substr_ptr) {
+  KAIN_PROFILE_CALL();
+  if (str_ptr == 0 || substr_ptr == 0)
+    return 0;
+  const char *str = (const char *)str_ptr;
+  const char *substr = (const char *)substr_ptr;
+  return strstr(str, substr) != NULL ? 1 : 0;
+}
+
+// Array membership check (internal raw return)
+int64_t kain_array_contains(int64_t arr_ptr, int64_t item_val) {
+  KAIN_PROFILE_CALL();
+  if (arr_ptr == 0)
+    return 0;
+  KainArray *arr = (KainArray *)arr_ptr;
+
+  for (int64_t i = 0; i < arr->len; i++) {
+    if (kain_str_eq(arr->data[i], item_val) == kain_TRUE) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int kain_array_holds(KainArray *arr, int64_t value) {
+  for (int64_t i = 0; arr && i < arr->len; i++)
+    if (kain_str_eq(arr->data[i], value) == kain_TRUE)
+      return 1;
+  return 0;
+}
+
+// Polymorphic contains: detects string vs array using NaN-boxing
+int64_t kain_contains(int64_t first_val, int64_t second_val) {
+  KAIN_PROFILE_CALL();
+  if (first_val == 0)
+    return (int64_t)kain_box_bool(0);
+
+  uint64_t first = (uint64_t)first_val;
+  int res = 0;
+
+  uint64_t tag = kain_get_tag(first);
+  // V1 raw string pointers (raw arrays look the same and land here too)
+  if (KAIN_V1_RAW_PTR(first))
+    tag = kain_TAG_STR;
+
+  switch (tag) {
+  case kain_TAG_STR: {
+    KainStrRef str = kain_str_ref(first_val);
+    KainStrRef sub = kain_str_ref(second_val);
+    res = (str.ptr && sub.ptr &&
+           kain_find_bytes(str.ptr, str.len, sub.ptr, sub.len) != NULL);
+    break;
+  }
+  case kain_TAG_OBJ: {
+    KainRange *r = kain_unbox_range(first_val);
+    if (r && !r->array) {
+      // Unmaterialized range: membership is arithmetic
+      if (kain_is_int((uint64_t)second_val)) {
+        int64_t x = kain_unbox_int((uint64_t)second_val);
+        int64_t i = (x - r->start) / r->step;
+        res = (x - r->start) % r->step == 0 && i >= 0 &&
+              i < kain_range_count(r);
+      }
+    } else {
+      res = kain_array_holds((KainArray *)kain_unbox_any_ptr(first_val),
+                             second_val);
+    }
+    break;
+  }
+  case kain_TAG_PTR:
+    res = kain_array_holds((KainArray *)kain_unbox_ptr(first), second_val);
+    break;
+#ifdef KAIN_STRICT_NANBOX
+  case KAIN_TAG_DOUBLE:
+    // Never a Float here: arrays from kain_array_new are raw heap pointers
+    res = kain_array_holds((KainArray *)first_val, second_val);
+    break;
+#endif
+  }
+
+  return (int64_t)kain_box_bool(res);
+}
+
+// Fields between exact occurrences of `delim`, empty ones included; an empty
+// delimiter splits into bytes. Long fields are views into `str` (copies when
+// it is a reader line).
+int64_t kain_split(int64_t str_val, int64_t delim_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef str = kain_str_ref(str_val);
+  KainStrRef delim = kain_str_ref(delim_val);
+
+  if (!str.ptr || !delim.ptr)
+    return kain_array_new();
+
+  if (delim.len == 0) {
+    // One piece per byte: the size is known
+    KainArray *chars = kain_array_reserve((int64_t)str.len);
+    for (size_t i = 0; i < str.len; i++)
+      chars->data[i] = kain_char_str(str.ptr[i]);
+    chars->len = (int64_t)str.len;
+    return (int64_t)chars;
+  }
+
+  // Count the matches first so the result is sized exactly, then fill it.
+  // len grows with each store so a collection mid-fill still sees the
+  // fields already sliced.
+  KainFinder f;
+  kain_finder_init(&f, delim.ptr, delim.len);
+  const char *end = str.ptr + str.len;
+  const char *p;
+  int64_t count = 0;
+  for (p = str.ptr; (p = kain_finder_next(&f, p, end)); p += delim.len)
+    count++;
+
+  KainArray *parts = kain_array_reserve(count + 1);
+  const char *field = str.ptr;
+  while ((p = kain_finder_next(&f, field, end))) {
+    parts->data[parts->len++] = kain_str_slice(
+        str, (size_t)(field - str.ptr), (size_t)(p - field));
+    field = p + delim.len;
+  }
+  parts->data[parts->len++] =
+      kain_str_slice(str, (size_t)(field - str.ptr), (size_t)(end - field));
+  return (int64_t)parts;
+}
+
+int64_t kain_len(int64_t obj_val) {
+  KAIN_PROFILE_CALL();
+  if (obj_val == 0)
+    return (int64_t)kain_box_int(0);
+  uint64_t uval = (uint64_t)obj_val;
+
+  if (kain_IS_STR(uval)) {
+    return (int64_t)kain_box_int((int64_t)kain_str_ref(obj_val).len);
+  } else if (kain_IS_OBJ(uval)) {
+    if (kain_unbox_range(obj_val) || kain_unbox_typed(obj_val))
+      return kain_array_len(obj_val);
+    return kain_builder_len(obj_val);
+  } else if (kain_is_ptr(uval)) {
+    KainArray *arr = (KainArray *)kain_unbox_ptr(uval);
+    return (int64_t)kain_box_int(arr->len);
+  }
+
+  // Fallback if not boxed correctly
+  return (int64_t)kain_box_int(0);
+}
+
+// Largest magnitude a boxed Int holds (45-bit signed payload)
+#define KAIN_INT_LIMIT (1LL << 44)
+
+// from_chars-style: the whole of [s, s + len) must be an optional sign and
+// digits, no whitespace, in Int range. Returns 0 (leaving *out) otherwise.
+static int kain_parse_i64(const char *s, size_t len, int64_t *out) {
+  size_t i = 0;
+  int neg = 0;
+  if (i < len && (s[i] == '-' || s[i] == '+'))
+    neg = s[i++] == '-';
+  if (i == len)
+    return 0;
+  uint64_t u = 0;
+  for (; i < len; i++) {
+    unsigned digit = (unsigned)(unsigned char)s[i] - '0';
+    if (digit > 9)
+      return 0;
+    u = u * 10 + digit;
+    if (u > (uint64_t)KAIN_INT_LIMIT)
+      return 0;
+  }
+  if (!neg && u == (uint64_t)KAIN_INT_LIMIT)
+    return 0;
+  *out = neg ? -(int64_t)u : (int64_t)u;
+  return 1;
+}
+
+// Same contract for floats, over exactly the decimal syntax the formatter
+// writes: [sign] digits [. digits] [e [sign] digits], a digit somewhere in
+// the mantissa. No blanks, hex floats, inf or nan. Plain decimals ("12.5",
+// up to 15 digits) are exact as digits / 10^k; exponents and longer
+// mantissas are checked here and converted by strtod.
+static int kain_parse_f64(const char *s, size_t len, double *out) {
+  size_t i = 0;
+  int neg = 0;
+  if (i < len && (s[i] == '-' || s[i] == '+'))
+    neg = s[i++] == '-';
+  uint64_t m = 0;
+  int digits = 0, frac = -1;
+  for (; i < len; i++) {
+    unsigned digit = (unsigned)(unsigned char)s[i] - '0';
+    if (digit <= 9) {
+      m = m * 10 + digit;
+      digits++;
+      if (frac >= 0)
+        frac++;
+    } else if (s[i] == '.' && frac < 0) {
+      frac = 0;
+    } else {
+      break;
+    }
+  }
+  if (i == len && digits > 0 && digits <= 15) {
+    double d = (double)m;
+    if (frac > 0)
+      d /= kain_pow10[frac];
+    *out = neg ? -d : d;
+    return 1;
+  }
+
+  if (digits == 0)
+    return 0;
+  if (i < len) {
+    if (s[i] != 'e' && s[i] != 'E')
+      return 0;
+    if (++i < len && (s[i] == '-' || s[i] == '+'))
+      i++;
+    if (i == len)
+      return 0;
+    for (; i < len; i++)
+      if ((unsigned)(unsigned char)s[i] - '0' > 9)
+        return 0;
+  }
+  char stack_buf[64];
+  char *tmp = len < sizeof(stack_buf) ? stack_buf : (char *)malloc(len + 1);
+  if (!tmp)
+    return 0;
+  memcpy(tmp, s, len);
+  tmp[len] = '\0';
+  char *end;
+  double d = strtod(tmp, &end);
+  int ok = end == tmp + len;
+  if (tmp != stack_buf)
+    free(tmp);
+  if (ok)
+    *out = d;
+  return ok;
+}
+
+int64_t kain_some(int64_t value);
+int64_t kain_none(void);
+
+// parse_int("42") -> Some(42); None for anything else
+int64_t kain_parse_int(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef r = kain_str_ref(str_val);
+  int64_t n;
+  if (r.ptr && kain_parse_i64(r.ptr, r.len, &n))
+    return kain_some((int64_t)kain_box_int(n));
+  return kain_none();
+}
+
+int64_t kain_parse_float(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef r = kain_str_ref(str_val);
+  double d;
+  if (r.ptr && kain_parse_f64(r.ptr, r.len, &d))
+    return kain_some((int64_t)kain_box_double(d));
+  return kain_none();
+}
+
+// to_int/to_float stay lenient (leading blanks, trailing junk, 0 on error)
+// and only fall back to libc when the exact parse fails
+int64_t kain_to_int(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef r = kain_str_ref(str_val);
+  if (!r.ptr)
+    return (int64_t)kain_box_int(0);
+  int64_t n;
+  if (kain_parse_i64(r.ptr, r.len, &n))
+    return (int64_t)kain_box_int(n);
+  // View bytes are not terminated; 31 chars cover every Int
+  char tmp[32];
+  size_t len = r.len < sizeof(tmp) - 1 ? r.len : sizeof(tmp) - 1;
+  memcpy(tmp, r.ptr, len);
+  tmp[len] = '\0';
+  return (int64_t)kain_box_int(atoll(tmp));
+}
+
+int64_t kain_to_float(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef r = kain_str_ref(str_val);
+  if (!r.ptr)
+    return 0;
+  double d;
+  if (!kain_parse_f64(r.ptr, r.len, &d)) {
+    char tmp[64];
+    size_t len = r.len < sizeof(tmp) - 1 ? r.len : sizeof(tmp) - 1;
+    memcpy(tmp, r.ptr, len);
+    tmp[len] = '\0';
+    d = atof(tmp);
+  }
+  return (int64_t)kain_box_double(d);
+}
+
+int64_t kain_to_string(int64_t val) {
+  KAIN_PROFILE_CALL();
+  uint64_t uval = (uint64_t)val;
+  char buf[128];
+
+#ifdef KAIN_STRICT_NANBOX
+  switch (kain_get_tag(uval)) {
+  case kain_TAG_STR:
+    return val;
+  case kain_TAG_INT:
+    return (int64_t)kain_box_string(
+        kain_str_from(buf, kain_format_i64(buf, kain_unbox_int(uval))));
+  case KAIN_TAG_DOUBLE:
+    return (int64_t)kain_box_string(
+        kain_str_from(buf, kain_format_f64(buf, kain_unbox_double(uval))));
+  case kain_TAG_BOOL:
+    return kain_intern_ptr(kain_unbox_bool(uval) ? "true" : "false");
+  case kain_TAG_NULL:
+    return kain_intern_ptr("null");
+  case kain_TAG_PTR:
+    sprintf(buf, "[Ptr %p]", kain_unbox_ptr(uval));
+    break;
+  case kain_TAG_OBJ:
+    if (kain_unbox_builder(val))
+      return kain_builder_to_string(val);
+    sprintf(buf, "[Obj %p]", kain_UNBOX_PTR(uval));
+    break;
+  default:
+    sprintf(buf, "[Value 0x%llx]", (unsigned long long)uval);
+    break;
+  }
+  return (int64_t)kain_box_string(kain_str_new(buf));
+#endif
+
+  // V1 COMPATIBILITY: Handle raw integers first (before tag checks)
+  // Raw integers from V1 are small values < NANBOX_QNAN
+  if (uval < NANBOX_QNAN && uval < 0x0010000000000000ULL) {
+    // This is a raw integer (including 0)
+    return (int64_t)kain_box_string(kain_str_from(buf, kain_format_i64(buf, val)));
+  }
+
+  // Anything else below QNAN is past every heap address: a Float, which
+  // kain_is_string() would otherwise take for a V1 string pointer
+  if (uval < NANBOX_QNAN) {
+    size_t n = kain_format_f64(buf, kain_unbox_double(uval));
+    return (int64_t)kain_box_string(kain_str_from(buf, n));
+  }
+
+  uint64_t tag = kain_get_tag(uval);
+
+  if (kain_is_string(uval)) {
+    return val;
+  } else if (kain_unbox_builder(val)) {
+    return kain_builder_to_string(val);
+  } else if (tag == kain_TAG_INT) {
+    size_t n = kain_format_i64(buf, kain_unbox_int(uval));
+    return (int64_t)kain_box_string(kain_str_from(buf, n));
+  } else if (tag == kain_TAG_BOOL) {
+    return kain_intern_ptr(kain_unbox_bool(uval) ? "true" : "false");
+  } else if (tag == kain_TAG_NULL) {
+    return kain_intern_ptr("null");
+  } else if (kain_is_ptr(uval)) {
+    sprintf(buf, "[Ptr %p]", (void *)kain_unbox_ptr(uval));
+  } else {
+    // Fallback for raw pointers/values
+    sprintf(buf, "%lld", (long long)val);
+  }
+
+  return (int64_t)kain_box_string(kain_str_new(buf));
+}
+
+int64_t kain_range_step(int64_t start_val, int64_t end_val, int64_t step_val) {
+  KAIN_PROFILE_CALL();
+  int64_t step = kain_index_arg(step_val);
+  if (step == 0) {
+    fprintf(stderr, "FATAL: range step must not be zero\n");
+    kain_flush();
+    exit(1);
+  }
+  KainRange *r = (KainRange *)arena_alloc_as(sizeof(KainRange), KAIN_GC_OBJ);
+  r->obj.kind = KAIN_OBJ_RANGE;
+  r->obj.flags = 0;
+  r->start = kain_index_arg(start_val);
+  r->end = kain_index_arg(end_val);
+  r->step = step;
+  r->array = 0;
+  return (int64_t)kain_BOX_OBJ(r);
+}
+
+int64_t kain_range(int64_t start_val, int64_t end_val) {
+  KAIN_PROFILE_CALL();
+  return kain_range_step(start_val, end_val, 1);
+}
+
+int64_t kain_substring(int64_t str_val, int64_t start_val, int64_t end_val) {
+  KAIN_PROFILE_CALL();
+  // Auto-unbox NaN-boxed string
+  KainStrRef str = kain_str_ref(str_val);
+
+  // Auto-unbox NaN-boxed integers
+  int64_t start = kain_is_int((uint64_t)start_val)
+                      ? kain_unbox_int((uint64_t)start_val)
+                      : start_val;
+  int64_t end = kain_is_int((uint64_t)end_val)
+                    ? kain_unbox_int((uint64_t)end_val)
+                    : end_val;
+
+  if (start < 0)
+    start = 0;
+  if (end > (int64_t)str.len)
+    end = (int64_t)str.len;
+  if (start >= end)
+    return (int64_t)kain_box_string(kain_str_new(""));
+
+  return kain_str_slice(str, (size_t)start, (size_t)(end - start));
+}
+
+int64_t kain_str_ends_with(int64_t str_val, int64_t suffix_val) {
+  KAIN_PROFILE_CALL();
+  KainStrRef str = kain_str_ref(str_val);
+  KainStrRef suffix = kain_str_ref(suffix_val);
+
+  if (!str.ptr || !suffix.ptr)
+    return (int64_t)kain_box_bool(0);
+
+  if (suffix.len > str.len)
+    return (int64_t)kain_box_bool(0);
+
+  return (int64_t)kain_box_bool(
+      memcmp(str.ptr + str.len - suffix.len, suffix.ptr, suffix.len) == 0);
+}
+
+int64_t kain_slice(int64_t arr_val, int64_t start_val, int64_t end_val) {
+  KAIN_PROFILE_CALL();
+  // Auto-unbox NaN-boxed pointer and integers
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  if (!arr)
+    return kain_array_new();
+
+  int64_t start = kain_is_int((uint64_t)start_val)
+                      ? kain_unbox_int((uint64_t)start_val)
+                      : start_val;
+  int64_t end = kain_is_int((uint64_t)end_val)
+                    ? kain_unbox_int((uint64_t)end_val)
+                    : end_val;
+
+  if (start < 0)
+    start = 0;
+  if (end > arr->len)
+    end = arr->len;
+  int64_t len = end > start ? end - start : 0;
+  if (len >= KAIN_ARRAY_VIEW_MIN && len * 2 >= arr->len) {
+    KainArray *view = (KainArray *)kain_array_new();
+    view->data = arr->data + start;
+    view->len = len;
+    view->cap = len | KAIN_ARRAY_BORROWED;
+    arr->cap |= KAIN_ARRAY_SHARED;
+    return (int64_t)view;
+  }
+  KainArray *copy = kain_array_reserve(len);
+  if (len)
+    memcpy(copy->data, arr->data + start, (size_t)len * sizeof(int64_t));
+  copy->len = len;
+  return (int64_t)copy;
+}
+
+int64_t kain_append(int64_t str_val1, int64_t str_val2) {
+  KAIN_PROFILE_CALL();
+  return kain_str_concat_boxed(str_val1, str_val2);
+}
+
+// =============================================================================
+// Option/Box Helpers
+// =============================================================================
+
+// Enum values share the codegen layout { tag, payload, name }: variant_field
+// reads field i at ((int64_t *)payload)[i]. Variants the runtime builds keep
+// their fields inline right after it (`payload` points there), so each one
+// is a single allocation, and `name` boxes the enum's static tag -> name
+// table rather than holding a string.
+typedef struct {
+  KainObjHeader obj; // kind = KAIN_OBJ_ENUM_NAMES
+  int64_t count;
+  const char *const *names;
+  int64_t *interned; // kain_intern_lit slots, one per tag
+} KainEnumNames;
+
+// Option: tag 0 = Some (one inline field), tag 1 = None (no fields)
+#define KAIN_OPTION_SOME 0
+#define KAIN_OPTION_NONE 1
+
+typedef struct {
+  int64_t tag;
+  int64_t value; // Payload tuple: the word right after the header for Some
+  int64_t name;  // Boxed KainEnumNames (or a variant name string)
+} KainOption;
+
+static const char *const kain_option_names[] = {"Some", "None"};
+static int64_t kain_option_interned[2];
+static KainEnumNames kain_option_enum = {
+    {KAIN_OBJ_ENUM_NAMES, 0}, 2, kain_option_names, kain_option_interned};
+
+// Every None is this object; its name word can only be boxed at run time
+static KainOption kain_none_value = {KAIN_OPTION_NONE, 0, 0};
+
+int64_t kain_some(int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainOption *opt = (KainOption *)arena_alloc_small(
+      sizeof(KainOption) + sizeof(int64_t), KAIN_GC_RAW);
+  int64_t *fields = (int64_t *)(opt + 1);
+  fields[0] = value;
+  opt->tag = KAIN_OPTION_SOME;
+  opt->value = (int64_t)fields;
+  opt->name = (int64_t)kain_BOX_OBJ(&kain_option_enum);
+  return (int64_t)kain_box_ptr(opt);
+}
+
+int64_t kain_none() {
+  KAIN_PROFILE_CALL();
+  if (!kain_atomic_load_ptr((void **)&kain_none_value.name))
+    (void)kain_atomic_xchg_ptr(
+        (void **)&kain_none_value.name,
+        (void *)(uintptr_t)kain_BOX_OBJ(&kain_option_enum));
+  return (int64_t)kain_box_ptr(&kain_none_value);
+}
+
+int64_t kain_unwrap(int64_t opt_val) {
+  KAIN_PROFILE_CALL();
+  if (opt_val == 0) {
+    fprintf(stderr, "PANIC: unwrap called on null pointer\n");
+    exit(1);
+  }
+  KainOption *opt;
+  if (kain_is_ptr((uint64_t)opt_val)) {
+    opt = (KainOption *)kain_unbox_ptr((uint64_t)opt_val);
+  } else {
+    opt = (KainOption *)opt_val;
+  }
+
+  if (opt->tag == KAIN_OPTION_NONE) {
+    fprintf(stderr, "PANIC: called unwrap on None\n");
+    exit(1);
+  }
+  // value is a tuple pointer
+  int64_t *tuple = (int64_t *)opt->value;
+  return tuple[0];
+}
+
+// unwrap() that consumes the Option: a Some from kain_some is recycled, so
+// the caller must not use `opt_val` again
+int64_t kain_take(int64_t opt_val) {
+  KAIN_PROFILE_CALL();
+  int64_t value = kain_unwrap(opt_val);
+  KainOption *opt = kain_is_ptr((uint64_t)opt_val)
+                        ? (KainOption *)kain_unbox_ptr((uint64_t)opt_val)
+                        : (KainOption *)opt_val;
+  if (opt->value == (int64_t)(opt + 1))
+    arena_free_small(opt, sizeof(KainOption) + sizeof(int64_t));
+  return value;
+}
+
+// Box is just a wrapper around a value (heap-allocated)
+int64_t kain_box(int64_t value) {
+  KAIN_PROFILE_CALL();
+  int64_t *box = (int64_t *)arena_alloc_small(sizeof(int64_t), KAIN_GC_RAW);
+  *box = value;
+  return (int64_t)box;
+}
+
+int64_t kain_unbox(int64_t box_ptr) {
+  KAIN_PROFILE_CALL();
+  int64_t *box = (int64_t *)box_ptr;
+  return *box;
+}
+
+// =============================================================================
+// Memory Management (Already defined above)
+// =============================================================================
+
+// void* kain_alloc(int64_t size) - defined in arena section
+// void kain_free(void* ptr) - defined in arena section
+
+// =============================================================================
+// Type Tags (for dynamic typing / enums) - LEGACY, use different prefix to
+// avoid NaN-boxing conflict
+// =============================================================================
+
+#define kain_VALUE_TAG_INT 0
+#define kain_VALUE_TAG_FLOAT 1
+#define kain_VALUE_TAG_STRING 2
+#define kain_VALUE_TAG_BOOL 3
+#define kain_VALUE_TAG_ARRAY 4
+#define kain_VALUE_TAG_NONE 5
+
+typedef struct {
+  int64_t tag;
+  int64_t value; // or pointer cast to i64
+} KainValue;
+
+int64_t kain_value_tag(int64_t value_ptr) {
+  KAIN_PROFILE_CALL();
+  KainValue *v = (KainValue *)value_ptr;
+  return v->tag;
+}
+
+int64_t kain_value_data(int64_t value_ptr) {
+  KAIN_PROFILE_CALL();
+  KainValue *v = (KainValue *)value_ptr;
+  return v->value;
+}
+
+// =============================================================================
+// File I/O
+// =============================================================================
+
+// Size of an open file in bytes (64-bit on every platform), -1 if unknown
+static int64_t kain_file_size(FILE *f) {
+#ifdef _WIN32
+  if (_fseeki64(f, 0, SEEK_END) != 0)
+    return -1;
+  int64_t size = _ftelli64(f);
+  _fseeki64(f, 0, SEEK_SET);
+#else
+  if (fseeko(f, 0, SEEK_END) != 0)
+    return -1;
+  int64_t size = (int64_t)ftello(f);
+  fseeko(f, 0, SEEK_SET);
+#endif
+  return size;
+}
+
+// Read the rest of `f` into a runtime string (fread may return short counts)
+static char *kain_file_read_from(FILE *f, int64_t size) {
+  char *content = kain_str_alloc((size_t)size);
+  size_t read_size = 0;
+  while (read_size < (size_t)size) {
+    size_t n = fread(content + read_size, 1, (size_t)size - read_size, f);
+    if (n == 0)
+      break;
+    read_size += n;
+  }
+
+  // Keep the header honest if the file shrank under us
+  content[read_size] = '\0';
+  kain_str_header(content)->len = (int64_t)read_size;
+  return content;
+}
+
+char *kain_file_read(const char *path) {
+  KAIN_PROFILE_CALL();
+  if (!path)
+    return NULL;
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return NULL;
+
+  int64_t size = kain_file_size(f);
+  char *content = size < 0 ? NULL : kain_file_read_from(f, size);
+  fclose(f);
+  return content;
+}
+
+// -----------------------------------------------------------------------------
+// Memory-mapped reads
+// -----------------------------------------------------------------------------
+//
+// Large files are mapped read-only and returned as a string view over the
+// mapping: no copy, and the bytes are paged in from the page cache instead of
+// being duplicated on the heap. The view header sits inside a KainMappedStr so
+// kain_file_release() can find the mapping even after kain_str_cstr() has
+// swapped `base` for a NUL-terminated copy.
+//
+// Substrings of a mapped file borrow its bytes; materialize any that must
+// outlive kain_file_release().
+
+#if defined(KAIN_GC)
+#define KAIN_FILE_MAP_MIN INT64_MAX // A mapped string is not a GC block
+#elif !defined(KAIN_FILE_MAP_MIN)
+#define KAIN_FILE_MAP_MIN (256 * 1024) // Smaller files are read and copied
+#endif
+
+#define KAIN_STR_MAPPED 8ULL // View over a kain_file_map() mapping
+
+typedef struct {
+  void *map;
+  size_t map_len;
+  KainStrHeader hdr; // Must stay last: the boxed value points just past it
+} KainMappedStr;
+
+static inline KainMappedStr *kain_mapped_str(KainStrHeader *hdr) {
+  return (KainMappedStr *)((char *)hdr - offsetof(KainMappedStr, hdr));
+}
+
+// Map all `len` bytes of the open file read-only, NULL on failure
+static void *kain_map_file(FILE *f, size_t len) {
+#ifdef _WIN32
+  HANDLE file = (HANDLE)_get_osfhandle(_fileno(f));
+  if (file == INVALID_HANDLE_VALUE)
+    return NULL;
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping)
+    return NULL;
+  // The view keeps the mapping object alive after its handle is closed
+  void *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, len);
+  CloseHandle(mapping);
+  return map;
+#else
+  void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+  if (map == MAP_FAILED)
+    return NULL;
+#ifdef MADV_SEQUENTIAL
+  madvise(map, len, MADV_SEQUENTIAL);
+#endif
+  return map;
+#endif
+}
+
+static void kain_unmap_file(void *map, size_t len) {
+#ifdef _WIN32
+  (void)len;
+  UnmapViewOfFile(map);
+#else
+  munmap(map, len);
+#endif
+}
+
+// Read a whole file as a boxed string, mapping it when it is large enough
+int64_t kain_file_map(const char *path) {
+  KAIN_PROFILE_CALL();
+  if (!path)
+    return (int64_t)kain_box_null();
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return (int64_t)kain_box_null();
+  int64_t size = kain_file_size(f);
+  if (size < 0) {
+    fclose(f);
+    return (int64_t)kain_box_null();
+  }
+
+  // Mappings outlive the FILE; a failed map falls back to a plain read
+  void *map = size >= KAIN_FILE_MAP_MIN ? kain_map_file(f, (size_t)size) : NULL;
+  if (map) {
+    fclose(f);
+    KainMappedStr *m =
+        (KainMappedStr *)arena_alloc_as(sizeof(KainMappedStr), KAIN_GC_LEAF);
+    m->map = map;
+    m->map_len = (size_t)size;
+    m->hdr.len = size;
+    m->hdr.base = (const char *)map;
+    m->hdr.hash = 0;
+    m->hdr.flags = KAIN_STR_VIEW | KAIN_STR_MAPPED;
+    return (int64_t)kain_box_string((const char *)(&m->hdr + 1));
+  }
+
+  char *content = kain_file_read_from(f, size);
+  fclose(f);
+  return (int64_t)kain_box_string(content);
+}
+
+// Unmap a string returned by kain_file_map(); it becomes "". Returns false
+// for anything that is not a live mapping.
+int64_t kain_file_release(int64_t str_val) {
+  KAIN_PROFILE_CALL();
+  uint64_t v = (uint64_t)str_val;
+  if (!kain_IS_STR(v) || !kain_UNBOX_STR(v))
+    return (int64_t)kain_box_bool(0);
+  KainStrHeader *hdr = kain_str_header(kain_UNBOX_STR(v));
+  if (!(hdr->flags & KAIN_STR_MAPPED))
+    return (int64_t)kain_box_bool(0);
+
+  KainMappedStr *m = kain_mapped_str(hdr);
+  kain_unmap_file(m->map, m->map_len);
+  m->map = NULL;
+  m->map_len = 0;
+  hdr->len = 0;
+  hdr->base = "";
+  hdr->hash = 0;
+  hdr->flags = KAIN_STR_VIEW | KAIN_STR_VIEW_CSTR;
+  return (int64_t)kain_box_bool(1);
+}
+
+#ifdef _WIN32
+#define kain_fd_open(path, flags)                                              \
+  _open(path, (flags) | _O_BINARY, _S_IREAD | _S_IWRITE)
+#define kain_fd_close(fd) _close(fd)
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+#else
+#define kain_fd_open(path, flags) open(path, flags, 0666)
+#define kain_fd_close(fd) close(fd)
+#endif
+
+// write() all of [p, p + n), retrying short writes and EINTR. Returns 0 or
+// the errno of the failure.
+static int kain_fd_write_all(int fd, const char *p, size_t n) {
+  while (n > 0) {
+#ifdef _WIN32
+    int w = _write(fd, p, n > 0x40000000 ? 0x40000000u : (unsigned)n);
+#else
+    ssize_t w = write(fd, p, n);
+#endif
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return w < 0 && errno ? errno : EIO;
+    p += w;
+    n -= (size_t)w;
+  }
+  return 0;
+}
+
+// Gather write of `cnt` pieces (consumes `iov`), same contract
+static int kain_fd_writev_all(int fd, struct iovec *iov, int cnt) {
+#ifdef _WIN32
+  for (int i = 0; i < cnt; i++) {
+    int err = kain_fd_write_all(fd, (const char *)iov[i].iov_base, iov[i].iov_len);
+    if (err)
+      return err;
+  }
+  return 0;
+#else
+  while (cnt > 0) {
+    ssize_t w = writev(fd, iov, cnt);
+    if (w < 0 && errno == EINTR)
+      continue;
+    if (w <= 0)
+      return w < 0 && errno ? errno : EIO;
+    // Drop what went out, trim a partly written piece
+    while (cnt > 0 && (size_t)w >= iov->iov_len) {
+      w -= (ssize_t)iov->iov_len;
+      iov++;
+      cnt--;
+    }
+    if (cnt > 0) {
+      iov->iov_base = (char *)iov->iov_base + w;
+      iov->iov_len -= (size_t)w;
+    }
+  }
+  return 0;
+#endif
+}
+
+// Replace `path` with [content, content + len); 1 on success
+static int kain_file_write_bytes(const char *path, const char *content,
+                                 size_t len) {
+  if (!path)
+    return 0;
+  int fd = kain_fd_open(path, O_WRONLY | O_CREAT | O_TRUNC);
+  if (fd < 0)
+    return 0;
+  int err = kain_fd_write_all(fd, content, len);
+  if (kain_fd_close(fd) != 0 && !err)
+    err = errno;
+  return err == 0;
+}
+
+int64_t kain_file_write(const char *path, const char *content) {
+  KAIN_PROFILE_CALL();
+  return kain_file_write_bytes(path, content, content ? strlen(content) : 0);
+}
+
+// -----------------------------------------------------------------------------
+// Streaming reader
+// -----------------------------------------------------------------------------
+//
+// A reader owns one growable buffer and one view header. next_line and
+// read_chunk return that header re-pointed at the bytes in the buffer, so
+// reading a file of any size allocates nothing per line. The flip side: a
+// returned string is only valid until the next call on the same reader (or
+// close). materialize() anything that has to outlive that. The view is
+// flagged KAIN_STR_VOLATILE, so split/substring results taken from it are
+// copies and stay valid.
+
+#define READER_INITIAL_CAP (64 * 1024)
+
+#ifdef _WIN32
+#define kain_getc _getc_nolock
+#else
+#define kain_getc getc_unlocked
+#endif
+
+typedef struct {
+  KainObjHeader obj;
+  FILE *f;
+  char *buf;
+  size_t cap;
+  size_t start; // First unconsumed byte
+  size_t end;   // One past the last buffered byte
+  int eof;
+  int is_stdin;
+  KainStrHeader line; // The view handed back to the caller
+} KainReader;
+
+static inline KainReader *kain_unbox_reader(int64_t val) {
+  return (KainReader *)kain_unbox_obj((uint64_t)val, KAIN_OBJ_READER);
+}
+
+static int64_t kain_reader_new(FILE *f, int is_stdin) {
+  KainReader *r = (KainReader *)arena_alloc_as(sizeof(KainReader), KAIN_GC_OBJ);
+  r->obj.kind = KAIN_OBJ_READER;
+  r->obj.flags = 0;
+  r->f = f;
+  r->buf = (char *)malloc(READER_INITIAL_CAP);
+  if (!r->buf) {
+    fprintf(stderr, "FATAL: OOM in kain_reader_new\n");
+    exit(1);
+  }
+  r->cap = READER_INITIAL_CAP;
+  r->start = 0;
+  r->end = 0;
+  r->eof = 0;
+  r->is_stdin = is_stdin;
+  r->line.len = 0;
+  r->line.base = "";
+  r->line.hash = 0;
+  r->line.flags = KAIN_STR_VIEW | KAIN_STR_VOLATILE;
+  region_track(r, KAIN_GC_OBJ);
+  return (int64_t)kain_BOX_OBJ(r);
+}
+
+int64_t kain_reader_open(int64_t path_val) {
+  KAIN_PROFILE_CALL();
+  const char *path = kain_unbox_string((uint64_t)path_val);
+  FILE *f = path ? fopen(path, "rb") : NULL;
+  if (!f)
+    return (int64_t)kain_box_null();
+  return kain_reader_new(f, 0);
+}
+
+int64_t kain_reader_stdin(void) { return kain_reader_new(stdin, 1); }
+
+// Read more input so that at least `want` bytes are buffered, if the input
+// has them. Consumed bytes are compacted away first; the buffer only grows
+// when a single line or chunk is bigger than it.
+static void reader_fill(KainReader *r, size_t want) {
+  KAIN_PROFILE_CALL();
+  if (r->start > 0) {
+    memmove(r->buf, r->buf + r->start, r->end - r->start);
+    r->end -= r->start;
+    r->start = 0;
+  }
+  if (want > r->cap) {
+    size_t new_cap = r->cap;
+    while (new_cap < want)
+      new_cap *= 2;
+    KAIN_PROFILE_COUNT(KAIN_PROF_GROWTHS, 1);
+    char *buf = (char *)realloc(r->buf, new_cap);
+    if (!buf) {
+      fprintf(stderr, "FATAL: OOM in reader_fill\n");
+      exit(1);
+    }
+    r->buf = buf;
+    r->cap = new_cap;
+  }
+  if (r->is_stdin)
+    kain_flush(); // Show any prompt before blocking on input
+  while (!r->eof && r->end < want && r->end < r->cap) {
+    char *dst = r->buf + r->end;
+    size_t n;
+    if (r->is_stdin) {
+      // fread would block until the whole buffer fills; take a line at a time
+      // so interactive input is seen as soon as it is entered. Counting the
+      // bytes here (not fgets + strlen) keeps embedded NULs and never asks
+      // for a one-byte read that fgets would return empty.
+      size_t room = r->cap - r->end;
+      int c = 0;
+      n = 0;
+      while (n < room && (c = kain_getc(r->f)) != EOF) {
+        dst[n++] = (char)c;
+        if (c == '\n')
+          break;
+      }
+    } else {
+      n = fread(dst, 1, r->cap - r->end, r->f);
+    }
+    if (n == 0)
+      r->eof = 1;
+    r->end += n;
+    if (r->is_stdin)
+      break;
+  }
+}
+
+static int64_t reader_take(KainReader *r, size_t len, size_t skip) {
+  r->line.len = (int64_t)len;
+  r->line.base = r->buf + r->start;
+  r->line.hash = 0;
+  r->line.flags = KAIN_STR_VIEW | KAIN_STR_VOLATILE;
+  r->start += len + skip;
+  return (int64_t)kain_box_string((const char *)(&r->line + 1));
+}
+
+// Next line without its terminator ("\n" or "\r\n"), null at end of input
+int64_t kain_reader_next_line(int64_t reader_val) {
+  KAIN_PROFILE_CALL();
+  KainReader *r = kain_unbox_reader(reader_val);
+  if (!r || !r->buf)
+    return (int64_t)kain_box_null();
+
+  size_t scanned = 0;
+  for (;;) {
+    const char *p = (const char *)memchr(r->buf + r->start + scanned, '\n',
+                                         r->end - r->start - scanned);
+    if (p) {
+      size_t len = (size_t)(p - (r->buf + r->start));
+      size_t skip = 1;
+      if (len > 0 && p[-1] == '\r') {
+        len--;
+        skip++;
+      }
+      return reader_take(r, len, skip);
+    }
+    if (r->eof) {
+      if (r->end == r->start)
+        return (int64_t)kain_box_null();
+      // Last line without a trailing newline
+      return reader_take(r, r->end - r->start, 0);
+    }
+    scanned = r->end - r->start;
+    size_t want = scanned < r->cap ? r->cap : scanned * 2;
+    reader_fill(r, want);
+  }
+}
+
+// Up to `n` bytes, null at end of input
+int64_t kain_reader_read_chunk(int64_t reader_val, int64_t n_val) {
+  KAIN_PROFILE_CALL();
+  KainReader *r = kain_unbox_reader(reader_val);
+  int64_t n = kain_is_int((uint64_t)n_val) ? kain_unbox_int((uint64_t)n_val)
+                                           : n_val;
+  if (!r || !r->buf || n <= 0)
+    return (int64_t)kain_box_null();
+
+  if (r->end - r->start < (size_t)n && !r->eof)
+    reader_fill(r, (size_t)n);
+  size_t avail = r->end - r->start;
+  if (avail == 0)
+    return (int64_t)kain_box_null();
+  return reader_take(r, avail < (size_t)n ? avail : (size_t)n, 0);
+}
+
+int64_t kain_reader_close(int64_t reader_val) {
+  KAIN_PROFILE_CALL();
+  KainReader *r = kain_unbox_reader(reader_val);
+  if (!r || !r->buf)
+    return (int64_t)kain_box_bool(0);
+  if (!r->is_stdin)
+    fclose(r->f);
+  free(r->buf);
+  r->buf = NULL;
+  r->f = NULL;
+  r->start = r->end = r->cap = 0;
+  r->line.len = 0;
+  r->line.base = "";
+  r->line.flags = KAIN_STR_VIEW | KAIN_STR_VIEW_CSTR;
+  return (int64_t)kain_box_bool(1);
+}
+
+// =============================================================================
+// Map Operations (open-addressing hash table, Robin Hood probing)
+// =============================================================================
+//
+// Keys are arbitrary NaN-boxed values. Strings (tagged or V1 raw pointers)
+// hash and compare by content; ints, bools and null are normalized to their
+// tagged form so a raw V1 `5` and a boxed `5` are the same key. Any other
+// pointer compares by identity.
+//
+// Every slot caches the key's hash (0 = empty). When the table fills up it
+// doubles, but the old table is kept and drained a few slots per map_set so
+// no single insert pays for the whole rehash. Lookups consult the new table
+// first and fall back to the old one while a migration is in flight.
+// =============================================================================
+
+typedef struct {
+  uint64_t hash;       // Cached key hash, 0 marks an empty slot
+  int64_t key;         // Original key value (normalized for scalars)
+  const char *key_str; // Key bytes for string keys, NULL otherwise
+  size_t key_len;      // Bytes in key_str (strings may hold NULs)
+  int64_t value;
+} KainMapEntry;
+
+typedef struct {
+  KainMapEntry *entries;
+  int64_t len;  // Live keys (across both tables)
+  int64_t used; // Occupied slots in `entries`
+  int64_t cap;  // Slots in `entries` (power of two, or 0)
+  KainMapEntry *old_entries; // Table being drained by incremental growth
+  int64_t old_cap;
+  int64_t migrate_pos;
+} KainMap;
+
+#define MAP_INITIAL_CAP 16
+#define MAP_MIGRATE_STEP 16 // Old slots drained per map_set
+
+typedef struct {
+  uint64_t hash;
+  int64_t key;
+  const char *str;
+  size_t str_len;
+} MapKey;
+
+static MapKey map_make_key(int64_t key_val) {
+  uint64_t v = (uint64_t)key_val;
+  MapKey k;
+  k.key = key_val;
+  k.str = NULL;
+  k.str_len = 0;
+
+  // Tagged runtime strings, or V1 raw string pointers (string literals are
+  // emitted as ptrtoint); the runtime string's cached hash is reused. Only
+  // words past LIKELY_POINTER_MIN count as raw strings, as in
+  // kain_to_string: compiled arithmetic returns raw ints well above 0x10000.
+  if (kain_IS_STR(v) || KAIN_V1_LIKELY_PTR(v)) {
+    KainStrRef r = kain_str_ref(key_val);
+    k.str = r.ptr ? r.ptr : "";
+    k.str_len = r.len;
+    k.hash = kain_str_ref_hash(r);
+    return k;
   }
 
-  if (kain_is_int(b)) {
-    b_raw = kain_unbox_int(b);
-  } else if (b_val < NANBOX_QNAN) {
-    // Raw small integer
-    b_raw = b_val;
-  } else {
-    // Assume double or other - just use raw
-    b_raw = b_val;
+  if (kain_is_int(v)) {
+    // Raw V1 ints below LIKELY_POINTER_MIN land here too; normalize so both
+    // spellings collide
+    int64_t n = v < NANBOX_QNAN ? (int64_t)v : kain_unbox_int(v);
+    k.key = (int64_t)kain_box_int(n);
+  } else if (v == 0) {
+    k.key = (int64_t)kain_NULL;
   }
 
-  // Return RAW result for V1 compatibility
-  return a_raw * b_raw;
+  k.hash = kain_hash_mix((uint64_t)k.key);
+  if (k.hash == 0)
+    k.hash = 1;
+  return k;
 }
 
-int64_t kain_div_op(int64_t a_val, int64_t b_val) {
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
+static inline int map_key_eq(const KainMapEntry *e, const MapKey *k) {
+  if (e->hash != k->hash)
+    return 0;
+  // Compare by length, not terminator: both sides may hold NULs
+  if (k->str)
+    return e->key_str && e->key_len == k->str_len &&
+           memcmp(e->key_str, k->str, k->str_len) == 0;
+  return !e->key_str && e->key == k->key;
+}
 
-  if (kain_is_int(a) && kain_is_int(b)) {
-    int64_t vb = kain_unbox_int(b);
-    if (vb == 0) {
-      fprintf(stderr, "PANIC: Division by zero\n");
-      exit(1);
-    }
-    int64_t result = kain_unbox_int(a) / vb;
-    return (int64_t)kain_box_int(result);
+static KainMapEntry *map_find_in(KainMapEntry *entries, int64_t cap,
+                                 const MapKey *k) {
+  if (!entries)
+    return NULL;
+  KAIN_PROFILE_COUNT(KAIN_PROF_MAP_LOOKUPS, 1);
+  uint64_t mask = (uint64_t)cap - 1;
+  uint64_t idx = k->hash & mask;
+  uint64_t dist = 0;
+  for (;;) {
+    KainMapEntry *e = &entries[idx];
+    KAIN_PROFILE_COUNT(KAIN_PROF_MAP_PROBES, 1);
+    if (e->hash == 0)
+      return NULL;
+    // Robin Hood invariant: once our probe distance exceeds the resident's,
+    // the key cannot be further along the chain.
+    uint64_t e_dist = (idx - (e->hash & mask)) & mask;
+    if (e_dist < dist)
+      return NULL;
+    if (map_key_eq(e, k))
+      return e;
+    idx = (idx + 1) & mask;
+    dist++;
   }
+}
 
-  if (kain_is_double(a) && kain_is_double(b)) {
-    double vb = kain_unbox_double(b);
-    if (vb == 0.0) {
-      // IEEE 754 infinity? Or panic?
-      // For now, let's just do it
+static KainMapEntry *map_find(KainMap *map, const MapKey *k) {
+  KainMapEntry *e = map_find_in(map->entries, map->cap, k);
+  if (!e && map->old_entries)
+    e = map_find_in(map->old_entries, map->old_cap, k);
+  return e;
+}
+
+// Insert an entry known to be absent from `map->entries`
+static void map_insert_new(KainMap *map, KainMapEntry entry) {
+  uint64_t mask = (uint64_t)map->cap - 1;
+  uint64_t idx = entry.hash & mask;
+  uint64_t dist = 0;
+  for (;;) {
+    KainMapEntry *e = &map->entries[idx];
+    if (e->hash == 0) {
+      *e = entry;
+      map->used++;
+      return;
     }
-    double result = kain_unbox_double(a) / vb;
-    return (int64_t)kain_box_double(result);
+    uint64_t e_dist = (idx - (e->hash & mask)) & mask;
+    if (e_dist < dist) {
+      KainMapEntry tmp = *e;
+      *e = entry;
+      entry = tmp;
+      dist = e_dist;
+    }
+    idx = (idx + 1) & mask;
+    dist++;
   }
-
-  if (b_val == 0)
-    return 0;
-  return a_val / b_val;
 }
 
-int64_t kain_rem_op(int64_t a_val, int64_t b_val) {
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
-
-  if (kain_is_int(a) && kain_is_int(b)) {
-    int64_t vb = kain_unbox_int(b);
-    if (vb == 0) {
-      fprintf(stderr, "PANIC: Remainder by zero\n");
-      exit(1);
+static void map_migrate(KainMap *map, int64_t steps) {
+  while (map->old_entries && steps-- > 0) {
+    if (map->migrate_pos >= map->old_cap) {
+      free(map->old_entries);
+      map->old_entries = NULL;
+      map->old_cap = 0;
+      map->migrate_pos = 0;
+      return;
     }
-    int64_t result = kain_unbox_int(a) % vb;
-    return (int64_t)kain_box_int(result);
+    KainMapEntry *e = &map->old_entries[map->migrate_pos++];
+    if (e->hash == 0)
+      continue;
+    MapKey k = {e->hash, e->key, e->key_str, e->key_len};
+    // A map_set during migration may already have written a newer value
+    if (!map_find_in(map->entries, map->cap, &k))
+      map_insert_new(map, *e);
   }
+}
 
-  // Floats don't support % in C, would need fmod
+static void map_grow(KainMap *map) {
+  // Finish any migration still in flight before starting another one
+  map_migrate(map, map->old_cap + 1);
 
-  if (b_val == 0) {
-    fprintf(stderr, "PANIC: Remainder by zero (legacy)\n");
+  int64_t new_cap = map->cap == 0 ? MAP_INITIAL_CAP : map->cap * 2;
+  KAIN_PROFILE_COUNT(KAIN_PROF_GROWTHS, 1);
+  KainMapEntry *entries =
+      (KainMapEntry *)calloc((size_t)new_cap, sizeof(KainMapEntry));
+  if (!entries) {
+    fprintf(stderr, "FATAL: OOM in map_set\n");
     exit(1);
   }
-  return a_val % b_val;
+  map->old_entries = map->entries;
+  map->old_cap = map->cap;
+  map->migrate_pos = 0;
+  map->entries = entries;
+  map->cap = new_cap;
+  map->used = 0;
 }
 
-// Comparison Helpers - Return RAW booleans for V1 compatibility
-
-// Helper to unbox integer with V1 compatibility
-static int64_t unbox_int_v1(uint64_t val, int64_t raw_val) {
-  if (kain_is_int(val)) {
-    return kain_unbox_int(val);
-  } else if (raw_val < NANBOX_QNAN) {
-    return raw_val; // Already raw
-  }
-  return raw_val; // Fallback
+int64_t Map_new() {
+  KAIN_PROFILE_CALL();
+  KainMap *map = (KainMap *)arena_alloc_as(sizeof(KainMap), KAIN_GC_MAP);
+  memset(map, 0, sizeof(KainMap));
+  region_track(map, KAIN_GC_MAP);
+  return (int64_t)kain_box_ptr(map);
 }
 
-int64_t kain_lt_op(int64_t a_val, int64_t b_val) {
-  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
-  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
-  return a < b ? 1 : 0; // Raw boolean
+int64_t kain_contains_key(int64_t map_val, int64_t key_val) {
+  KAIN_PROFILE_CALL();
+  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
+  if (!map || map->len == 0)
+    return (int64_t)kain_box_bool(0);
+  MapKey k = map_make_key(key_val);
+  return (int64_t)kain_box_bool(map_find(map, &k) != NULL);
 }
 
-int64_t kain_gt_op(int64_t a_val, int64_t b_val) {
-  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
-  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
-  return a > b ? 1 : 0; // Raw boolean
+// Map lookup - returns null if not found
+int64_t kain_map_get(int64_t map_val, int64_t key_val) {
+  KAIN_PROFILE_CALL();
+  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
+  if (!map || map->len == 0)
+    return (int64_t)kain_box_null();
+  MapKey k = map_make_key(key_val);
+  KainMapEntry *e = map_find(map, &k);
+  return e ? e->value : (int64_t)kain_box_null();
 }
 
-int64_t kain_le_op(int64_t a_val, int64_t b_val) {
-  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
-  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
-  return a <= b ? 1 : 0; // Raw boolean
+// Map insert/update
+void kain_map_set(int64_t map_val, int64_t key_val, int64_t value) {
+  KAIN_PROFILE_CALL();
+  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
+  if (!map)
+    return;
+  MapKey k = map_make_key(key_val);
+
+  map_migrate(map, MAP_MIGRATE_STEP);
+
+  KainMapEntry *e = map_find_in(map->entries, map->cap, &k);
+  if (e) {
+    e->value = value;
+    return;
+  }
+  int is_new = !(map->old_entries &&
+                 map_find_in(map->old_entries, map->old_cap, &k));
+
+  // Keep the load factor at or below 3/4
+  if ((map->used + 1) * 4 > map->cap * 3)
+    map_grow(map);
+
+  // Entries keep a NUL-terminated copy of view keys
+  if (k.str && kain_IS_STR((uint64_t)key_val) && k.str_len)
+    k.str = kain_unbox_string((uint64_t)key_val);
+  KainMapEntry entry = {k.hash, k.key, k.str, k.str_len, value};
+  map_insert_new(map, entry);
+  if (is_new)
+    map->len++;
 }
 
-int64_t kain_ge_op(int64_t a_val, int64_t b_val) {
-  int64_t a = unbox_int_v1((uint64_t)a_val, a_val);
-  int64_t b = unbox_int_v1((uint64_t)b_val, b_val);
-  return a >= b ? 1 : 0; // Raw boolean
+// Number of keys in a map (boxed)
+int64_t kain_map_len(int64_t map_val) {
+  KAIN_PROFILE_CALL();
+  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
+  return (int64_t)kain_box_int(map ? map->len : 0);
 }
 
-int64_t kain_eq_op(int64_t a_val, int64_t b_val) {
-  // Fast path: bit-identical
-  if (a_val == b_val)
-    return 1;
+// =============================================================================
+// String Join (for StringBuilder.build())
+// =============================================================================
 
-  uint64_t a = (uint64_t)a_val;
-  uint64_t b = (uint64_t)b_val;
+int64_t kain_join(int64_t arr_val, int64_t delim_val) {
+  KAIN_PROFILE_CALL();
+  // StringBuilder.build() path: a native builder joins to its contents
+  if (kain_unbox_builder(arr_val))
+    return kain_builder_to_string(arr_val);
 
-  // If both are integers (boxed or raw), compare them
-  if (kain_is_int(a) && kain_is_int(b)) {
-    return kain_unbox_int(a) == kain_unbox_int(b);
-  }
+  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
+  KainStrRef delim = kain_str_ref(delim_val);
 
-  // V1 compatibility: unbox integers before comparing
-  int64_t ua = unbox_int_v1(a, a_val);
-  int64_t ub = unbox_int_v1(b, b_val);
-  if (ua == ub && (ua != a_val || ub != b_val)) {
-    return 1;
+  if (!arr || arr->len == 0) {
+    return (int64_t)kain_box_string(kain_str_new(""));
   }
 
-  // Only fall back to string comparison if both are potentially strings
-  if (kain_is_string(a) || kain_is_string(b) ||
-      (a < NANBOX_QNAN && a > 0x10000) || (b < NANBOX_QNAN && b > 0x10000)) {
-    // kain_str_eq returns kain_TRUE/kain_FALSE, we need truthy check
-    int64_t res = kain_str_eq(a_val, b_val);
-    return kain_is_truthy(res);
+  // A lone string is its own join (strings are immutable)
+  if (arr->len == 1 && kain_IS_STR((uint64_t)arr->data[0]))
+    return arr->data[0];
+
+  size_t total_len = delim.len * (size_t)(arr->len - 1);
+  for (int64_t i = 0; i < arr->len; i++)
+    total_len += kain_str_ref(arr->data[i]).len;
+
+  char *result = kain_str_alloc(total_len);
+  char *dst = result;
+  for (int64_t i = 0; i < arr->len; i++) {
+    if (i) {
+      if (delim.len == 1)
+        *dst++ = delim.ptr[0];
+      else if (delim.len) {
+        memcpy(dst, delim.ptr, delim.len);
+        dst += delim.len;
+      }
+    }
+    KainStrRef s = kain_str_ref(arr->data[i]);
+    if (s.len) {
+      memcpy(dst, s.ptr, s.len);
+      dst += s.len;
+    }
   }
 
-  return 0;
+  return (int64_t)kain_box_string(result);
 }
 
-int64_t kain_neq_op(int64_t a_val, int64_t b_val) {
-  return kain_eq_op(a_val, b_val) ? 0 : 1;
+// Debug helper: Read 8 bytes from address
+int64_t kain_peek(int64_t ptr) {
+  if (ptr < 1000) {
+    fprintf(stderr, "FATAL: kain_peek called with null/invalid pointer: %lld\n",
+            (long long)ptr);
+    return 0;
+  }
+  int64_t *p = (int64_t *)ptr;
+  return *p;
 }
 
-int64_t kain_ord(int64_t str_val) {
-  const char *str = (const char *)kain_unbox_any_ptr(str_val);
-  if (!str || !*str)
-    return (int64_t)kain_box_int(0);
-  return (int64_t)kain_box_int(str[0]);
-}
+// =============================================================================
+// Variant Introspection (for enum pattern matching in interpreted code)
+// =============================================================================
 
-int64_t kain_chr(int64_t code_val) {
-  // Auto-unbox NaN-boxed integer
-  int64_t code = kain_is_int((uint64_t)code_val)
-                     ? kain_unbox_int((uint64_t)code_val)
-                     : code_val;
+// Get tag name from a tagged union (simplified - returns tag number as string)
+int64_t kain_variant_of(int64_t value_val) {
+  KAIN_PROFILE_CALL();
+  // In our representation, enums are { tag: i64, payload: i8*, name: i8* }
+  int64_t *ptr = (int64_t *)kain_unbox_any_ptr(value_val);
 
-  char *str = (char *)malloc(2);
-  if (!str)
-    return 0;
-  str[0] = (char)code;
-  str[1] = '\0';
-  return (int64_t)kain_box_string(str);
-}
+  if (!ptr) {
+    // Return tagged string "None"
+    static int64_t none_slot = 0;
+    return kain_intern_lit(&none_slot, "None");
+  }
 
-// Get character code at index in string (for efficient lexer)
-int64_t kain_char_code_at(int64_t str_val, int64_t index_val) {
-  // Auto-unbox NaN-boxed string and index
-  const char *str = (const char *)kain_unbox_any_ptr(str_val);
+  // Name is at offset 2 (the 3rd field)
+  uint64_t name_val = (uint64_t)ptr[2];
 
-  int64_t index = kain_is_int((uint64_t)index_val)
-                      ? kain_unbox_int((uint64_t)index_val)
-                      : index_val;
+  // Runtime-built enums name their tags through a static table
+  KainEnumNames *names = (KainEnumNames *)kain_unbox_obj(name_val,
+                                                         KAIN_OBJ_ENUM_NAMES);
+  if (names && ptr[0] >= 0 && ptr[0] < names->count)
+    return kain_intern_lit(&names->interned[ptr[0]], names->names[ptr[0]]);
 
-  if (!str)
-    return (int64_t)kain_box_int(0);
-  size_t len = strlen(str);
-  if (index < 0 || (size_t)index >= len)
-    return (int64_t)kain_box_int(0);
-  return (int64_t)kain_box_int((unsigned char)str[index]);
-}
+  // If it's already a tagged string, return it
+  if (kain_is_string(name_val)) {
+    return (int64_t)name_val;
+  }
 
-// Create single-character string from code (for efficient lexer)
-int64_t kain_char_from_code(int64_t code_val) {
-  // Auto-unbox NaN-boxed integer
-  int64_t code = kain_is_int((uint64_t)code_val)
-                     ? kain_unbox_int((uint64_t)code_val)
-                     : code_val;
+  const char *name = (const char *)name_val;
+  // If name is null (shouldn't happen for valid enums), fallback to tag
+  if (name == NULL) {
+    char buf[24];
+    return (int64_t)kain_box_string(kain_str_from(buf, kain_format_i64(buf, *ptr)));
+  }
 
-  char *str = (char *)arena_alloc(2);
-  str[0] = (char)code;
-  str[1] = '\0';
-  return (int64_t)kain_box_string(str);
+  // Raw names are string constants from codegen: intern them by address so
+  // repeated variant_of calls neither allocate nor rehash
+  return kain_intern_ptr(name);
 }
 
-// Get single character at index as string (for compatibility)
-int64_t kain_char_at(int64_t str_val, int64_t index_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  int64_t index = kain_is_int((uint64_t)index_val)
-                      ? kain_unbox_int((uint64_t)index_val)
-                      : index_val;
+// Extract field from variant by index
+int64_t kain_variant_field(int64_t value_val, int64_t field_idx_val) {
+  KAIN_PROFILE_CALL();
+  // Codegen hands enums over raw, the runtime's own variants boxed
+  int64_t *ptr = (int64_t *)kain_unbox_any_ptr(value_val);
+  if (!ptr)
+    return (int64_t)kain_box_null();
 
-  if (!str)
-    return (int64_t)kain_box_string(kain_str_new(""));
-  size_t len = strlen(str);
-  if (index < 0 || (size_t)index >= len)
-    return (int64_t)kain_box_string(kain_str_new(""));
+  // Unbox field index!
+  int64_t field_idx = kain_is_int((uint64_t)field_idx_val)
+                          ? kain_unbox_int((uint64_t)field_idx_val)
+                          : field_idx_val;
 
-  char buf[2];
-  buf[0] = str[index];
-  buf[1] = '\0';
-  return (int64_t)kain_box_string(kain_str_new(buf));
+  // The payload is at offset 1 (ptr[1])
+  int64_t payload_val = ptr[1];
+  if (payload_val == 0)
+    return (int64_t)kain_box_null();
+
+  int64_t *tuple = (int64_t *)kain_unbox_any_ptr(payload_val);
+  return tuple[field_idx];
 }
 
 // =============================================================================
-// Array Operations (heap-allocated dynamic arrays)
+// Process / System
 // =============================================================================
 
-typedef struct {
-  int64_t *data;
-  int64_t len;
-  int64_t cap;
-} KainArray;
+int64_t kain_system(const char *command) {
+  KAIN_PROFILE_CALL();
+  kain_flush(); // The child shares our stdout
+  return (int64_t)system(command);
+}
 
-// We store arrays as pointers cast to i64
-static int array_new_count = 0;
-int64_t kain_array_new() {
-  array_new_count++;
+void kain_exit(int64_t code) { exit((int)code); }
 
-  KainArray *arr = (KainArray *)arena_alloc(sizeof(KainArray));
-  arr->data = NULL;
-  arr->len = 0;
-  arr->cap = 0;
-  return (int64_t)arr;
+void kain_panic(const char *message) {
+  KAIN_PROFILE_CALL();
+  kain_flush(); // Program output first, then the panic report
+  fprintf(stderr, "\n\n!!! Kain PANIC !!!\n");
+  fprintf(stderr, "Reason: %s\n\n", message);
+  fflush(stderr); // CRITICAL: Force output before exit
+  exit(1);
 }
 
-int64_t kain_array_push(int64_t arr_val, int64_t value) {
-  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
-  if (!arr)
-    return 0;
-
-  if (arr->len >= arr->cap) {
-    int64_t new_cap = arr->cap == 0 ? 8 : arr->cap * 2;
-    arr->data = (int64_t *)realloc(arr->data, new_cap * sizeof(int64_t));
-    if (!arr->data) {
-      fprintf(stderr, "FATAL: OOM in kain_array_push\n");
-      exit(1);
-    }
-    arr->cap = new_cap;
-  }
+// =============================================================================
+// Stdlib Wrappers (for direct linking without stdlib source)
+// =============================================================================
 
-  if (!arr->data) {
-    fprintf(stderr, "FATAL: arr->data is NULL even after realloc! cap=%lld\n",
-            arr->cap);
-    exit(1);
+int64_t args() {
+  int64_t arr_boxed = (int64_t)kain_array_reserve(g_argc);
+  for (int i = 0; i < g_argc; i++) {
+    char *str_copy = kain_str_new(g_argv[i]);
+    kain_array_push(arr_boxed, (int64_t)kain_box_string(str_copy));
   }
+  return arr_boxed;
+}
 
-  arr->data[arr->len] = value;
-  arr->len++;
-  return arr_val;
+int64_t read_file(int64_t path_val) {
+  const char *p = (const char *)kain_unbox_any_ptr(path_val);
+  return kain_file_map(p);
 }
 
-int64_t kain_array_pop(int64_t arr_val) {
-  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
-  if (!arr)
-    return 0;
+int64_t release_file(int64_t str_val) { return kain_file_release(str_val); }
 
-  if (arr->len == 0)
-    return 0;
-  return arr->data[--arr->len];
-}
+int64_t reader_open(int64_t path_val) { return kain_reader_open(path_val); }
 
-static int array_get_count = 0;
-int64_t kain_array_get(int64_t arr_val, int64_t index_val) {
-  array_get_count++;
+int64_t stdin_reader(void) { return kain_reader_stdin(); }
 
-  // Auto-unbox NaN-boxed array pointer
-  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
-  if (!arr)
-    return 0;
+int64_t next_line(int64_t reader) { return kain_reader_next_line(reader); }
 
-  // Auto-unbox NaN-boxed index
-  int64_t index = (index_val < NANBOX_QNAN)
-                      ? index_val
-                      : kain_unbox_int((uint64_t)index_val);
+int64_t read_chunk(int64_t reader, int64_t n) {
+  return kain_reader_read_chunk(reader, n);
+}
 
-  // Comprehensive bounds checking with diagnostic info
-  if (index < 0 || index >= arr->len) {
-    fprintf(stderr,
-            "\n═══════════════════════════════════════════════════════════\n");
-    fprintf(stderr, "ERROR: Array index out of bounds\n");
-    fprintf(stderr,
-            "═══════════════════════════════════════════════════════════\n\n");
+int64_t reader_close(int64_t reader) { return kain_reader_close(reader); }
 
-    fprintf(stderr, "Array Information:\n");
-    fprintf(stderr, "  Address:  %p\n", (void *)arr);
-    fprintf(stderr, "  Length:   %lld\n", (long long)arr->len);
-    fprintf(stderr, "  Capacity: %lld\n", (long long)arr->cap);
-    fprintf(stderr, "  Data ptr: %p\n", (void *)arr->data);
+int64_t writer_open(int64_t path_val) { return kain_writer_open(path_val); }
 
-    fprintf(stderr, "\nIndex Information:\n");
-    fprintf(stderr, "  Requested index: %lld\n", (long long)index);
-    fprintf(stderr, "  Index (raw):     0x%llx\n",
-            (unsigned long long)index_val);
-    if (index_val >= NANBOX_QNAN) {
-      fprintf(stderr, "  Index (boxed):   0x%llx (NaN-boxed integer)\n",
-              (unsigned long long)index_val);
-    }
-    fprintf(stderr, "  Valid range:     0 <= index < %lld\n",
-            (long long)arr->len);
-
-    if (arr->len > 0 && arr->data) {
-      fprintf(stderr, "\nArray Contents Preview:\n");
-      int show_count = arr->len < 5 ? (int)arr->len : 5;
-      for (int i = 0; i < show_count; i++) {
-        fprintf(stderr, "  arr[%d] = 0x%llx\n", i,
-                (unsigned long long)arr->data[i]);
-      }
-      if (arr->len > 5) {
-        fprintf(stderr, "  ... (%lld more elements)\n",
-                (long long)(arr->len - 5));
-      }
-    }
+int64_t writer_append(int64_t path_val) { return kain_writer_append(path_val); }
 
-    fprintf(stderr, "\nLikely Causes:\n");
-    if (index == arr->len) {
-      fprintf(stderr, "   Index equals length - off-by-one error\n");
-      fprintf(stderr, "    - Using 1-based indexing instead of 0-based\n");
-      fprintf(stderr,
-              "    - Loop condition should be 'i < len' not 'i <= len'\n");
-    } else if (index == index_val && index_val >= NANBOX_QNAN) {
-      fprintf(stderr, "   Using boxed integer directly as index\n");
-      fprintf(stderr,
-              "    - Variable assignment may not be storing computed value\n");
-      fprintf(stderr, "    - Let-binding codegen bug in bootstrap compiler\n");
-      fprintf(stderr, "    - Expression result not being used\n");
-    } else if (index > arr->len + 100) {
-      fprintf(stderr, "   Index is very large - possible memory corruption\n");
-      fprintf(stderr, "    - Uninitialized variable\n");
-      fprintf(stderr, "    - Pointer arithmetic error\n");
-    } else {
-      fprintf(stderr, "  - Check loop bounds and index calculations\n");
-      fprintf(stderr, "  - Verify array was populated correctly\n");
-    }
+int64_t writer_async(int64_t writer) { return kain_writer_async(writer); }
 
-    fprintf(stderr, "\nStack Trace:\n");
-    kain_print_stack_trace();
-    fprintf(stderr,
-            "═══════════════════════════════════════════════════════════\n\n");
-    fflush(stderr);
-    exit(1);
-  }
+int64_t writer_write(int64_t writer, int64_t value) {
+  return kain_writer_write(writer, value);
+}
 
-  return ((int64_t *)arr->data)[index];
+int64_t writer_writev(int64_t writer, int64_t pieces) {
+  return kain_writer_writev(writer, pieces);
 }
 
-void kain_array_set(int64_t arr_val, int64_t index_val, int64_t value) {
-  // Auto-unbox NaN-boxed array pointer and index
-  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
-  if (!arr)
-    return;
+int64_t writer_flush(int64_t writer) { return kain_writer_flush(writer); }
 
-  int64_t index = kain_is_int((uint64_t)index_val)
-                      ? kain_unbox_int((uint64_t)index_val)
-                      : index_val;
+int64_t writer_close(int64_t writer) { return kain_writer_close(writer); }
 
-  if (index < 0 || index >= arr->len) {
-    fprintf(stderr, "FATAL: Array SET index out of bounds: %lld (len=%lld)\n",
-            (long long)index, (long long)arr->len);
-    exit(1);
-  }
-  arr->data[index] = value;
+// Builders are written from their buffer and strings by length, so neither
+// has to be flattened or NUL-terminated first
+int64_t write_file(int64_t path_val, int64_t content_val) {
+  const char *p = (const char *)kain_unbox_any_ptr(path_val);
+  KainBuilder *b = kain_unbox_builder(content_val);
+  if (b)
+    return (int64_t)kain_box_int(kain_file_write_bytes(
+        p, b->len ? builder_bytes(b) : "", (size_t)b->len));
+  KainStrRef r = kain_str_ref(content_val);
+  if (r.ptr)
+    return (int64_t)kain_box_int(kain_file_write_bytes(p, r.ptr, r.len));
+  return (int64_t)kain_box_int(
+      kain_file_write(p, (const char *)kain_unbox_any_ptr(content_val)));
 }
 
-static int array_len_count = 0;
-int64_t kain_array_len(int64_t arr_val) {
-  array_len_count++;
+int64_t file_exists(int64_t path_val) {
+  const char *p = kain_is_string((uint64_t)path_val)
+                      ? kain_unbox_string((uint64_t)path_val)
+                      : (const char *)path_val;
+  FILE *f = fopen(p, "rb");
+  if (f) {
+    fclose(f);
+    return (int64_t)kain_box_int(1);
+  }
+  return (int64_t)kain_box_int(0);
+}
 
-  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
-  if (!arr)
-    return 0;
+int64_t substring(int64_t str_val, int64_t start, int64_t end) {
+  return kain_substring(str_val, start, end);
+}
 
-  // Return boxed integer for V1/V2 compatibility
-  return (int64_t)kain_box_int(arr->len);
+int64_t replace(int64_t str_val, int64_t old_val, int64_t new_val) {
+  return kain_str_replace(str_val, old_val, new_val);
 }
 
-void kain_array_free(int64_t arr_ptr) {
-  KainArray *arr = (KainArray *)arr_ptr;
-  if (arr->data)
-    free(arr->data);
-  free(arr);
+int64_t starts_with(int64_t str_val, int64_t prefix_val) {
+  return kain_str_starts_with(str_val, prefix_val);
 }
 
-// =============================================================================
-// Helper Functions (Stdlib)
-// =============================================================================
+// Wrappers for high-performance lexer
+int64_t char_code_at(int64_t str_val, int64_t index_val) {
+  return kain_char_code_at(str_val, index_val);
+}
 
-// String substring search (strstr-based)
-int64_t kain_str_contains(int64_t str_ptr, int64_t substr_ptr) {
-  if (str_ptr == 0 || substr_ptr == 0)
-    return 0;
-  const char *str = (const char *)str_ptr;
-  const char *substr = (const char *)substr_ptr;
-  return strstr(str, substr) != NULL ? 1 : 0;
+int64_t char_from_code(int64_t code_val) {
+  return kain_char_from_code(code_val);
 }
 
-// Array membership check (internal raw return)
-int64_t kain_array_contains(int64_t arr_ptr, int64_t item_val) {
-  if (arr_ptr == 0)
-    return 0;
-  KainArray *arr = (KainArray *)arr_ptr;
+int64_t bytes_iter(int64_t str_val) { return kain_bytes_iter(str_val); }
 
-  for (int64_t i = 0; i < arr->len; i++) {
-    if (kain_str_eq(arr->data[i], item_val) == kain_TRUE) {
-      return 1;
-    }
-  }
-  return 0;
+int64_t bytes_next(int64_t it) { return kain_bytes_next(it); }
+
+int64_t bytes_peek(int64_t it, int64_t offset) {
+  return kain_bytes_peek(it, offset);
 }
 
-// Polymorphic contains: detects string vs array using NaN-boxing
-int64_t kain_contains(int64_t first_val, int64_t second_val) {
-  if (first_val == 0)
-    return (int64_t)kain_box_bool(0);
+int64_t bytes_pos(int64_t it) { return kain_bytes_pos(it); }
 
-  uint64_t first = (uint64_t)first_val;
-  uint64_t second = (uint64_t)second_val;
-  int res = 0;
+int64_t to_float(int64_t str_ptr) { return kain_to_float(str_ptr); }
 
-  if (kain_is_string(first)) {
-    const char *str = kain_unbox_string(first);
-    const char *substr = kain_is_string(second) ? kain_unbox_string(second)
-                                                : (const char *)second_val;
-    res = (str && substr && strstr(str, substr) != NULL);
-  } else if (kain_is_ptr(first)) {
-    // NaN-boxed pointer
-    KainArray *arr = (KainArray *)kain_unbox_ptr(first);
-    for (int64_t i = 0; i < arr->len; i++) {
-      if (kain_str_eq(arr->data[i], second_val) == kain_TRUE) {
-        res = 1;
-        break;
-      }
-    }
-  } else if (!kain_is_tagged(first) && first > 0x10000) {
-    // RAW pointer fallback (for arrays from kain_array_new which return raw
-    // pointers) Heuristic: value > 0x10000 and not tagged -> likely a heap
-    // pointer
-    KainArray *arr = (KainArray *)first_val;
-    printf(
-        "DEBUG contains: raw arr=%p, len=%lld, looking for second_val=%llx\n",
-        (void *)arr, (long long)arr->len, (unsigned long long)second_val);
-    for (int64_t i = 0; i < arr->len; i++) {
-      printf("DEBUG contains[%lld]: arr->data[i]=%llx\n", (long long)i,
-             (unsigned long long)arr->data[i]);
-      if (kain_str_eq(arr->data[i], second_val) == kain_TRUE) {
-        res = 1;
-        break;
-      }
-    }
-  }
+// Missing aliases for bootstrap compatibility
+int64_t str_eq(int64_t a, int64_t b) { return kain_str_eq(a, b); }
 
-  return (int64_t)kain_box_bool(res);
-}
+int64_t array_len(int64_t arr) { return kain_array_len(arr); }
 
-int64_t kain_split(int64_t str_val, int64_t delim_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  const char *delim = kain_is_string((uint64_t)delim_val)
-                          ? kain_unbox_string((uint64_t)delim_val)
-                          : (const char *)delim_val;
+int64_t push(int64_t arr, int64_t val) { return kain_array_push(arr, val); }
 
-  // debug logging removed
+int64_t pop(int64_t arr) { return kain_array_pop(arr); }
 
-  int64_t arr_boxed = kain_array_new();
+int64_t to_int(int64_t str_val) { return kain_to_int(str_val); }
 
-  if (!str || !delim)
-    return arr_boxed;
+int64_t join(int64_t arr, int64_t sep) { return kain_join(arr, sep); }
 
-  if (strlen(delim) == 0) {
-    size_t len = strlen(str);
-    for (size_t i = 0; i < len; i++) {
-      char buf[2];
-      buf[0] = str[i];
-      buf[1] = '\0';
-      kain_array_push(arr_boxed, (int64_t)kain_box_string(kain_str_new(buf)));
-    }
-  } else {
-    char *str_copy = strdup(str);
-    char *token = strtok(str_copy, delim);
-    while (token != NULL) {
-      kain_array_push(arr_boxed, (int64_t)kain_box_string(kain_str_new(token)));
-      token = strtok(NULL, delim);
-    }
-    free(str_copy);
-  }
+int64_t variant_of(int64_t val) { return kain_variant_of(val); }
 
-  return arr_boxed;
-}
+int64_t intern(int64_t val) { return kain_intern_value(val); }
 
-int64_t kain_len(int64_t obj_val) {
-  if (obj_val == 0)
-    return (int64_t)kain_box_int(0);
-  uint64_t uval = (uint64_t)obj_val;
+int64_t materialize(int64_t val) { return kain_materialize(val); }
 
-  if (kain_is_string(uval)) {
-    return (int64_t)kain_box_int((int64_t)strlen(kain_unbox_string(uval)));
-  } else if (kain_is_ptr(uval)) {
-    KainArray *arr = (KainArray *)kain_unbox_ptr(uval);
-    return (int64_t)kain_box_int(arr->len);
-  }
+int64_t builder_new(void) { return kain_builder_new(); }
 
-  // Fallback if not boxed correctly
-  return (int64_t)kain_box_int(0);
+int64_t builder_with_capacity(int64_t cap) {
+  return kain_builder_with_capacity(cap);
 }
 
-int64_t kain_to_int(int64_t str_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  if (!str)
-    return (int64_t)kain_box_int(0);
-  return (int64_t)kain_box_int(atoll(str));
+int64_t builder_append(int64_t sb, int64_t val) {
+  return kain_builder_append(sb, val);
 }
 
-// Float logic is tricky because we use i64 everywhere in this bootstrap.
-// We might be storing float bits in i64?
-// parser.kn uses Expr::Float(float(tok.lexeme)).
-// If Expr::Float stores i64, then we just cast bits?
-// But let's assume standard float parsing for now, returning bits as i64?
-// Or maybe we just return integer part?
-// The bootstrap uses i64 for everything.
-// I'll leave float for now or return 0.
-int64_t kain_to_float(int64_t str_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  if (!str)
-    return 0;
-  double d = atof(str);
-  return (int64_t)kain_box_double(d);
+int64_t builder_append_char(int64_t sb, int64_t code) {
+  return kain_builder_append_char(sb, code);
 }
 
-int64_t kain_to_string(int64_t val) {
-  uint64_t uval = (uint64_t)val;
-  char buf[128];
+int64_t builder_append_int(int64_t sb, int64_t n) {
+  return kain_builder_append_int(sb, n);
+}
 
-  // V1 COMPATIBILITY: Handle raw integers first (before tag checks)
-  // Raw integers from V1 are small values < NANBOX_QNAN
-  if (uval < NANBOX_QNAN && uval < 0x0010000000000000ULL) {
-    // This is a raw integer (including 0)
-    sprintf(buf, "%lld", (long long)val);
-    return (int64_t)kain_box_string(kain_str_new(buf));
-  }
+int64_t builder_len(int64_t sb) { return kain_builder_len(sb); }
 
-  uint64_t tag = kain_get_tag(uval);
+int64_t builder_finish(int64_t sb) { return kain_builder_finish(sb); }
 
-  if (kain_is_string(uval)) {
-    return val;
-  } else if (tag == kain_TAG_INT) {
-    int64_t unboxed = kain_unbox_int(uval);
-    sprintf(buf, "%lld", (long long)unboxed);
-  } else if (tag == (uint64_t)-1) { // Double
-    sprintf(buf, "%g", kain_unbox_double(uval));
-  } else if (tag == kain_TAG_BOOL) {
-    sprintf(buf, "%s", kain_unbox_bool(uval) ? "true" : "false");
-  } else if (tag == kain_TAG_NULL) {
-    sprintf(buf, "null");
-  } else if (kain_is_ptr(uval)) {
-    sprintf(buf, "[Ptr %p]", (void *)kain_unbox_ptr(uval));
-  } else {
-    // Fallback for raw pointers/values
-    sprintf(buf, "%lld", (long long)val);
-  }
+int64_t println(int64_t val) { return kain_println_str(val); }
 
-  return (int64_t)kain_box_string(kain_str_new(buf));
+int64_t flush(void) { return kain_flush(); }
+
+int64_t panic(int64_t msg) {
+  const char *str = (const char *)kain_unbox_any_ptr(msg);
+  kain_panic(str);
+  return 0; // never reached
 }
 
-int64_t kain_range(int64_t start_val, int64_t end_val) {
-  int64_t start = kain_is_int((uint64_t)start_val)
-                      ? kain_unbox_int((uint64_t)start_val)
-                      : start_val;
-  int64_t end = kain_is_int((uint64_t)end_val)
-                    ? kain_unbox_int((uint64_t)end_val)
-                    : end_val;
+int64_t contains(int64_t str, int64_t substr) {
+  return kain_contains(str, substr); // Fixed: was kain_str_contains, should be
+                                     // polymorphic kain_contains
+}
 
-  int64_t arr_boxed = kain_array_new();
-  for (int64_t i = start; i < end; i++) {
-    kain_array_push(arr_boxed, (int64_t)kain_box_int(i));
-  }
-  return arr_boxed;
+int64_t variant_field(int64_t val, int64_t idx) {
+  return kain_variant_field(val, idx);
 }
 
-int64_t kain_substring(int64_t str_val, int64_t start_val, int64_t end_val) {
-  // Auto-unbox NaN-boxed string
-  const char *str;
-  if (kain_is_string((uint64_t)str_val)) {
-    str = kain_unbox_string((uint64_t)str_val);
-  } else {
-    str = (const char *)str_val;
-  }
+// Wrapper for stdlib compatibility - avoid name collision with C str* functions
+int64_t kain_str(int64_t val) { return kain_to_string(val); }
 
-  // Auto-unbox NaN-boxed integers
-  int64_t start = kain_is_int((uint64_t)start_val)
-                      ? kain_unbox_int((uint64_t)start_val)
-                      : start_val;
-  int64_t end = kain_is_int((uint64_t)end_val)
-                    ? kain_unbox_int((uint64_t)end_val)
-                    : end_val;
+int64_t to_string(int64_t val) { return kain_to_string(val); }
 
-  size_t len = strlen(str);
-  if (start < 0)
-    start = 0;
-  if (end > (int64_t)len)
-    end = len;
-  if (start >= end)
-    return (int64_t)kain_box_string(kain_str_new(""));
+int64_t map_set(int64_t map, int64_t key, int64_t val) {
+  KAIN_PROFILE_CALL();
+  kain_map_set(map, key, val);
+  return 0;
+}
 
-  size_t sub_len = end - start;
-  char *result = (char *)arena_alloc(sub_len + 1);
-  strncpy(result, str + start, sub_len);
-  result[sub_len] = '\0';
-  return (int64_t)kain_box_string(result);
+int64_t contains_key(int64_t map, int64_t key) {
+  return kain_contains_key(map, key);
+}
+
+int64_t map_get(int64_t map, int64_t key) { return kain_map_get(map, key); }
+
+int64_t map_len(int64_t map) { return kain_map_len(map); }
+
+int64_t split(int64_t str, int64_t delim) { return kain_split(str, delim); }
+
+int64_t str_len(int64_t str) { return kain_str_len(str); }
+extern int64_t main_Kain();
+
+// =============================================================================
+// TokenType Constructors (Workaround for bootstrap codegen bug)
+// =============================================================================
+
+int64_t kain_create_token_simple(const char *name) {
+  KAIN_PROFILE_CALL();
+  int64_t *ptr = (int64_t *)kain_alloc(24);
+  ptr[0] = 0;
+  ptr[1] = 0; // null payload
+  ptr[2] = kain_intern_ptr(name);
+  return (int64_t)kain_box_ptr(ptr);
+}
+
+int64_t kain_create_token_payload(const char *name, int64_t val) {
+  KAIN_PROFILE_CALL();
+  // { tag, payload, name } with the one field inline (see kain_some)
+  int64_t *ptr = (int64_t *)kain_alloc(32);
+  ptr[0] = 0;
+  ptr[3] = val;
+  ptr[1] = (int64_t)&ptr[3];
+  ptr[2] = kain_intern_ptr(name);
+  return (int64_t)kain_box_ptr(ptr);
 }
 
-int64_t kain_str_ends_with(int64_t str_val, int64_t suffix_val) {
-  const char *str = kain_is_string((uint64_t)str_val)
-                        ? kain_unbox_string((uint64_t)str_val)
-                        : (const char *)str_val;
-  const char *suffix = kain_is_string((uint64_t)suffix_val)
-                           ? kain_unbox_string((uint64_t)suffix_val)
-                           : (const char *)suffix_val;
-
-  if (!str || !suffix)
-    return (int64_t)kain_box_bool(0);
-
-  size_t str_len = strlen(str);
-  size_t suffix_len = strlen(suffix);
+// =============================================================================
+// Clocks
+// =============================================================================
+//
+// now() and now_ns() read the monotonic clock (QueryPerformanceCounter on
+// Windows, CLOCK_MONOTONIC elsewhere), so differences are real elapsed time
+// and never jump with the wall clock. Both count from runtime start, which
+// keeps now_ns() inside a boxed Int for almost 5 hours. cycles() reads the
+// CPU's cycle counter where there is one (its low 44 bits, so it wraps about
+// every 90 minutes at 3 GHz); only differences of nearby reads mean
+// anything.
+// =============================================================================
 
-  if (suffix_len > str_len)
-    return (int64_t)kain_box_bool(0);
+static uint64_t kain_clock_origin = 0; // kain_monotonic_ns() at startup
+
+static uint64_t kain_monotonic_ns(void) {
+#ifdef _WIN32
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER now;
+  if (!freq.QuadPart)
+    QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&now);
+  // Split the conversion so ticks * 1e9 cannot overflow
+  uint64_t secs = (uint64_t)now.QuadPart / (uint64_t)freq.QuadPart;
+  uint64_t rest = (uint64_t)now.QuadPart % (uint64_t)freq.QuadPart;
+  return secs * 1000000000ULL + rest * 1000000000ULL / (uint64_t)freq.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
 
-  return (int64_t)kain_box_bool(strcmp(str + str_len - suffix_len, suffix) ==
-                                0);
+static uint64_t kain_clock_elapsed_ns(void) {
+  uint64_t t = kain_monotonic_ns();
+  // Embedders that never run main() start counting at their first read
+  if (!kain_clock_origin)
+    kain_clock_origin = t;
+  return t - kain_clock_origin;
 }
 
-int64_t kain_slice(int64_t arr_val, int64_t start_val, int64_t end_val) {
-  // Auto-unbox NaN-boxed pointer and integers
-  KainArray *arr;
-  if (kain_is_ptr((uint64_t)arr_val)) {
-    arr = (KainArray *)kain_unbox_ptr((uint64_t)arr_val);
-  } else {
-    arr = (KainArray *)arr_val;
-  }
+// Seconds since runtime start, as a Float
+int64_t kain_now(void) {
+  KAIN_PROFILE_CALL();
+  return (int64_t)kain_box_double((double)kain_clock_elapsed_ns() * 1e-9);
+}
 
-  int64_t start = kain_is_int((uint64_t)start_val)
-                      ? kain_unbox_int((uint64_t)start_val)
-                      : start_val;
-  int64_t end = kain_is_int((uint64_t)end_val)
-                    ? kain_unbox_int((uint64_t)end_val)
-                    : end_val;
+// Nanoseconds since runtime start
+int64_t kain_now_ns(void) {
+  KAIN_PROFILE_CALL();
+  return (int64_t)kain_box_int((int64_t)kain_clock_elapsed_ns());
+}
 
-  int64_t new_arr = kain_array_new();
-  if (start < 0)
-    start = 0;
-  if (end > arr->len)
-    end = arr->len;
-  for (int64_t i = start; i < end; i++) {
-    kain_array_push(new_arr, arr->data[i]);
-  }
-  return new_arr;
+// Raw cycle counter; falls back to nanoseconds without one
+int64_t kain_cycles(void) {
+  KAIN_PROFILE_CALL();
+  uint64_t c;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  c = __rdtsc();
+#elif (defined(__GNUC__) || defined(__clang__)) &&                            \
+    (defined(__x86_64__) || defined(__i386__))
+  uint32_t lo, hi;
+  __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+  c = ((uint64_t)hi << 32) | lo;
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+  __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(c));
+#else
+  c = kain_monotonic_ns();
+#endif
+  // Keep it non-negative once sign-extended from the boxed 45 bits
+  return (int64_t)kain_box_int((int64_t)(c & (NANBOX_PAYLOAD_MASK >> 1)));
 }
 
-int64_t kain_append(int64_t str_val1, int64_t str_val2) {
-  // Auto-unbox NaN-boxed strings
-  const char *a;
-  const char *b;
-  if (kain_is_string((uint64_t)str_val1)) {
-    a = kain_unbox_string((uint64_t)str_val1);
-  } else {
-    a = (const char *)str_val1;
-  }
-  if (kain_is_string((uint64_t)str_val2)) {
-    b = kain_unbox_string((uint64_t)str_val2);
-  } else {
-    b = (const char *)str_val2;
+// Block the calling thread; takes Float seconds (an Int counts as seconds)
+int64_t kain_sleep(int64_t seconds_val) {
+  KAIN_PROFILE_CALL();
+  double secs = kain_is_double((uint64_t)seconds_val)
+                    ? kain_unbox_double((uint64_t)seconds_val)
+                    : (double)kain_index_arg(seconds_val);
+  if (!(secs > 0))
+    return 0;
+#ifdef _WIN32
+  Sleep((DWORD)(secs * 1000.0 + 0.5));
+#else
+  struct timespec req;
+  req.tv_sec = (time_t)secs;
+  req.tv_nsec = (long)((secs - (double)req.tv_sec) * 1e9);
+  // The sampling profiler's SIGPROF interrupts sleeps: resume the rest
+  while (nanosleep(&req, &req) != 0 && errno == EINTR) {
   }
-  return (int64_t)kain_box_string(kain_str_concat(a, b));
+#endif
+  return 0;
 }
 
 // =============================================================================
-// Option/Box Helpers
+// Stack Trace Support
+// =============================================================================
+//
+// `korec --trace` makes every Kain function call kain_trace_enter() on entry
+// and kain_trace_exit() before it returns. Frames live in a per-thread buffer
+// that doubles when full, so deep recursion keeps its whole trace. The same
+// stack feeds the sampling profiler below.
 // =============================================================================
 
-// Option is represented as { tag: i64, value: i64 }
-// tag = 0 for None, 1 for Some
+#define KAIN_TRACE_INITIAL_FRAMES 64
+#define KAIN_TRACE_PRINT_FRAMES 64 // Innermost frames a panic prints
+
+typedef struct KainFnTime KainFnTime;
 
 typedef struct {
-  int64_t tag;
-  int64_t value;
-  int64_t name; // Variant name
-} KainOption;
+  const char *function_name;
+  const char *file;
+  int line;
+  KainFnTime *time;  // Timing entry, NULL unless timing was on at entry
+  uint64_t start_ns; // Entry time of the outermost active call, else 0
+} KainStackFrame;
 
-int64_t kain_some(int64_t value) {
-  KainOption *opt = (KainOption *)arena_alloc(sizeof(KainOption));
-  opt->tag = 0; // Some is 1st variant
-  // Allocate tuple for payload to match generic EnumVariant layout
-  int64_t *tuple = (int64_t *)arena_alloc(sizeof(int64_t));
-  tuple[0] = value;
-  opt->value = (int64_t)tuple;
-
-  opt->name = (int64_t)kain_box_string(kain_str_new("Some"));
-  return (int64_t)kain_box_ptr(opt);
-}
+static KAIN_TLS KainStackFrame g_initial_frames[KAIN_TRACE_INITIAL_FRAMES];
+static KAIN_TLS KainStackFrame *g_stack_frames = NULL;
+static KAIN_TLS int g_stack_cap = 0;
+static KAIN_TLS int g_stack_depth = 0;
 
-int64_t kain_none() {
-  KainOption *opt = (KainOption *)arena_alloc(sizeof(KainOption));
-  opt->tag = 1;   // None is 2nd variant
-  opt->value = 0; // Null tuple
-  opt->name = (int64_t)kain_box_string(kain_str_new("None"));
-  return (int64_t)kain_box_ptr(opt);
-}
+static int kain_timing = 0; // Set while the sampling profiler runs
 
-int64_t kain_unwrap(int64_t opt_val) {
-  if (opt_val == 0) {
-    fprintf(stderr, "PANIC: unwrap called on null pointer\n");
-    exit(1);
-  }
-  KainOption *opt;
-  if (kain_is_ptr((uint64_t)opt_val)) {
-    opt = (KainOption *)kain_unbox_ptr((uint64_t)opt_val);
-  } else {
-    opt = (KainOption *)opt_val;
-  }
+static KainFnTime *kain_time_enter(KainStackFrame *f);
+static void kain_time_exit(KainStackFrame *f);
 
-  if (opt->tag == 1) { // tag 1 = None, tag 0 = Some
-    fprintf(stderr, "PANIC: called unwrap on None\n");
+// The sampling signal reads the stack of the thread it interrupts, so every
+// frame must be complete before the depth that exposes it is stored
+#ifdef _WIN32
+#define kain_signal_fence() _ReadWriteBarrier()
+#else
+#define kain_signal_fence() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#endif
+
+static void kain_trace_grow(void) {
+  if (!g_stack_frames) {
+    g_stack_frames = g_initial_frames;
+    g_stack_cap = KAIN_TRACE_INITIAL_FRAMES;
+    return;
+  }
+  int cap = g_stack_cap * 2;
+  KainStackFrame *frames =
+      (KainStackFrame *)malloc((size_t)cap * sizeof(KainStackFrame));
+  if (!frames) {
+    fprintf(stderr, "FATAL: OOM growing the trace stack (%d frames)\n", cap);
     exit(1);
   }
-  // value is a tuple pointer
-  int64_t *tuple = (int64_t *)opt->value;
-  return tuple[0];
+  memcpy(frames, g_stack_frames, (size_t)g_stack_depth * sizeof(KainStackFrame));
+  // Publish before freeing: a sample taken in between still reads the old
+  // buffer, which stays valid until the switch
+  KainStackFrame *old = g_stack_frames;
+  kain_signal_fence();
+  g_stack_frames = frames;
+  g_stack_cap = cap;
+  kain_signal_fence();
+  if (old != g_initial_frames)
+    free(old);
 }
 
-// Box is just a wrapper around a value (heap-allocated)
-int64_t kain_box(int64_t value) {
-  int64_t *box = (int64_t *)arena_alloc(sizeof(int64_t));
-  *box = value;
-  return (int64_t)box;
+// Called when entering a function (instrumented by codegen)
+void kain_trace_enter(const char *func_name, const char *file, int line) {
+  if (g_stack_depth == g_stack_cap)
+    kain_trace_grow();
+  KainStackFrame *f = &g_stack_frames[g_stack_depth];
+  f->function_name = func_name;
+  f->file = file;
+  f->line = line;
+  f->time = kain_timing ? kain_time_enter(f) : NULL;
+  kain_signal_fence();
+  g_stack_depth++;
 }
 
-int64_t kain_unbox(int64_t box_ptr) {
-  int64_t *box = (int64_t *)box_ptr;
-  return *box;
+// Called when exiting a function
+void kain_trace_exit(void) {
+  if (g_stack_depth > 0) {
+    KainStackFrame *f = &g_stack_frames[g_stack_depth - 1];
+    if (f->time)
+      kain_time_exit(f);
+    g_stack_depth--;
+  }
 }
 
-// =============================================================================
-// Memory Management (Already defined above)
-// =============================================================================
+// Print stack trace on panic
+void kain_print_stack_trace(void) {
+  fprintf(stderr, "\n\033[1;36mStack trace (most recent call last):\033[0m\n");
+  int shown = 0;
+  for (int i = g_stack_depth - 1; i >= 0; i--) {
+    if (shown++ == KAIN_TRACE_PRINT_FRAMES) {
+      fprintf(stderr, "  ... %d more frames\n", i + 1);
+      break;
+    }
+    const KainStackFrame *f = &g_stack_frames[i];
+    if (f->file && f->line)
+      fprintf(stderr, "  at %s (%s:%d)\n", f->function_name, f->file, f->line);
+    else if (f->file)
+      fprintf(stderr, "  at %s (%s)\n", f->function_name, f->file);
+    else
+      fprintf(stderr, "  at %s\n", f->function_name);
+  }
+}
 
-// void* kain_alloc(int64_t size) - defined in arena section
-// void kain_free(void* ptr) - defined in arena section
+// Get current stack depth (for debugging)
+int64_t kain_stack_depth(void) { return (int64_t)g_stack_depth; }
 
 // =============================================================================
-// Type Tags (for dynamic typing / enums) - LEGACY, use different prefix to
-// avoid NaN-boxing conflict
+// Sampling Profiler
+// =============================================================================
+//
+// kain_sample_start(hz) arms a CPU-time timer (SIGPROF). Each tick copies
+// the interrupted thread's trace stack into one preallocated buffer (the
+// handler never allocates or locks; a full buffer drops samples).
+// kain_sample_write() folds identical stacks into the collapsed
+// "main;parse;lex 42" format that flamegraph.pl, inferno and speedscope
+// read.
+//
+// While sampling, kain_trace_enter/exit also time every call with the
+// monotonic clock. The inclusive time of recursive functions is counted
+// once, from the outermost call. With sampling off, the only cost per call
+// is a test of kain_timing.
+//
+// KAIN_SAMPLE=<file> samples the whole run, at KAIN_SAMPLE_HZ (default
+// 997), and writes the stacks to <file> at exit. Programs must be compiled
+// with `korec --trace`, otherwise every stack is empty. Windows builds time
+// calls but cannot sample.
 // =============================================================================
 
-#define kain_VALUE_TAG_INT 0
-#define kain_VALUE_TAG_FLOAT 1
-#define kain_VALUE_TAG_STRING 2
-#define kain_VALUE_TAG_BOOL 3
-#define kain_VALUE_TAG_ARRAY 4
-#define kain_VALUE_TAG_NONE 5
-
-typedef struct {
-  int64_t tag;
-  int64_t value; // or pointer cast to i64
-} KainValue;
+#define KAIN_SAMPLE_DEFAULT_HZ 997 // Prime, so ticks don't beat with loops
+#define KAIN_SAMPLE_MAX_DEPTH 1024 // Outermost frames kept per sample
+#define KAIN_SAMPLE_BUFFER_WORDS (4u << 20) // 32 MB, touched only as filled
+
+struct KainFnTime {
+  const char *name;
+  uint64_t calls;
+  uint64_t total_ns;
+  int64_t active; // Activations currently on the stack
+};
+
+// Per-thread timing table; every thread's table is linked into a list
+typedef struct KainTimeTable {
+  KainFnTime **slots; // Open addressing by name pointer
+  size_t cap;
+  size_t count;
+  struct KainTimeTable *next;
+} KainTimeTable;
+
+static KAIN_TLS KainTimeTable *tls_times = NULL;
+static KainTimeTable *all_times = NULL;
+
+// Sample records: [depth + 1][outermost frame] ... [innermost frame]
+static const char **sample_buf = NULL;
+static size_t sample_used = 0; // Words reserved, may run past the end
+static size_t sample_dropped = 0;
+static int sample_hz = 0;
+static const char *sample_env_path = NULL;
+
+static size_t kain_time_slot(const char *name, size_t cap) {
+  return (size_t)(((uintptr_t)name >> 3) * 0x9E3779B97F4A7C15ULL >> 32) &
+         (cap - 1);
+}
 
-int64_t kain_value_tag(int64_t value_ptr) {
-  KainValue *v = (KainValue *)value_ptr;
-  return v->tag;
+static KainFnTime *kain_time_lookup(const char *name) {
+  KainTimeTable *t = tls_times;
+  if (!t) {
+    t = (KainTimeTable *)calloc(1, sizeof(KainTimeTable));
+    if (!t) {
+      fprintf(stderr, "FATAL: OOM in the call timer\n");
+      exit(1);
+    }
+    tls_times = t;
+    KainTimeTable *head;
+    do {
+      head = (KainTimeTable *)kain_atomic_load_ptr(&all_times);
+      t->next = head;
+    } while (!kain_atomic_cas_ptr(&all_times, head, t));
+  }
+  if ((t->count + 1) * 2 > t->cap) {
+    size_t cap = t->cap ? t->cap * 2 : 256;
+    KainFnTime **slots = (KainFnTime **)calloc(cap, sizeof(KainFnTime *));
+    if (!slots) {
+      fprintf(stderr, "FATAL: OOM in the call timer\n");
+      exit(1);
+    }
+    for (size_t i = 0; i < t->cap; i++) {
+      if (!t->slots[i])
+        continue;
+      size_t j = kain_time_slot(t->slots[i]->name, cap);
+      while (slots[j])
+        j = (j + 1) & (cap - 1);
+      slots[j] = t->slots[i];
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->cap = cap;
+  }
+  size_t i = kain_time_slot(name, t->cap);
+  while (t->slots[i]) {
+    if (t->slots[i]->name == name)
+      return t->slots[i];
+    i = (i + 1) & (t->cap - 1);
+  }
+  KainFnTime *e = (KainFnTime *)calloc(1, sizeof(KainFnTime));
+  if (!e) {
+    fprintf(stderr, "FATAL: OOM in the call timer\n");
+    exit(1);
+  }
+  e->name = name;
+  t->slots[i] = e;
+  t->count++;
+  return e;
 }
 
-int64_t kain_value_data(int64_t value_ptr) {
-  KainValue *v = (KainValue *)value_ptr;
-  return v->value;
+static KainFnTime *kain_time_enter(KainStackFrame *f) {
+  KainFnTime *e = kain_time_lookup(f->function_name);
+  e->calls++;
+  f->start_ns = e->active++ == 0 ? kain_monotonic_ns() : 0;
+  return e;
 }
 
-// =============================================================================
-// File I/O
-// =============================================================================
+static void kain_time_exit(KainStackFrame *f) {
+  KainFnTime *e = f->time;
+  if (--e->active == 0)
+    e->total_ns += kain_monotonic_ns() - f->start_ns;
+}
 
-char *kain_file_read(const char *path) {
-  // // fprintf(stderr, "[file_read] Reading '%s'\n", path ? path : "NULL");
-  // // fflush(stderr);
-  FILE *f = fopen(path, "rb");
-  if (!f) {
-    // // fprintf(stderr, "[file_read] Failed to open '%s'\n", path ? path :
-    // "NULL");
-    // // fflush(stderr);
-    return NULL;
+#ifndef _WIN32
+static void kain_sample_signal(int sig) {
+  (void)sig;
+  int depth = g_stack_depth;
+  const KainStackFrame *frames = g_stack_frames;
+  if (depth <= 0)
+    return;
+  if (depth > KAIN_SAMPLE_MAX_DEPTH)
+    depth = KAIN_SAMPLE_MAX_DEPTH;
+  size_t need = (size_t)depth + 1;
+  size_t at = kain_atomic_add_size(&sample_used, need) - need;
+  if (at + need > KAIN_SAMPLE_BUFFER_WORDS) {
+    kain_atomic_add_size(&sample_dropped, 1);
+    return;
   }
+  for (int i = 0; i < depth; i++)
+    sample_buf[at + 1 + (size_t)i] = frames[i].function_name;
+  kain_signal_fence();
+  sample_buf[at] = (const char *)(uintptr_t)need;
+}
 
-  fseek(f, 0, SEEK_END);
-  long size = ftell(f);
-  fseek(f, 0, SEEK_SET);
+static void kain_sample_timer(int hz) {
+  struct itimerval it;
+  memset(&it, 0, sizeof(it));
+  if (hz > 0) {
+    it.it_interval.tv_usec = hz >= 1000000 ? 1 : 1000000 / hz;
+    it.it_value = it.it_interval;
+  }
+  setitimer(ITIMER_PROF, &it, NULL);
+}
+#endif
+
+// Start sampling at `hz` ticks per CPU second (<= 0: the default) and timing
+// calls. Restarting keeps the samples taken so far.
+int64_t kain_sample_start(int64_t hz_val) {
+  int64_t hz = kain_index_arg(hz_val);
+  sample_hz = hz > 0 ? (int)hz : KAIN_SAMPLE_DEFAULT_HZ;
+  kain_timing = 1;
+#ifdef _WIN32
+  fprintf(stderr, "kain sample: no sampling on Windows, timing calls only\n");
+#else
+  if (!sample_buf) {
+    sample_buf =
+        (const char **)calloc(KAIN_SAMPLE_BUFFER_WORDS, sizeof(const char *));
+    if (!sample_buf) {
+      fprintf(stderr, "FATAL: OOM allocating the sample buffer\n");
+      exit(1);
+    }
+  }
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = kain_sample_signal;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGPROF, &sa, NULL);
+  kain_sample_timer(sample_hz);
+#endif
+  return 0;
+}
 
-  // // fprintf(stderr, "[file_read] Size: %ld\n", size);
-  // // fflush(stderr);
+int64_t kain_sample_stop(void) {
+#ifndef _WIN32
+  if (sample_hz)
+    kain_sample_timer(0);
+#endif
+  kain_timing = 0;
+  return 0;
+}
 
-  char *content = (char *)malloc(size + 1);
-  long read_size = fread(content, 1, size, f);
-  (void)read_size; // Silence unused variable warning
-  // // fprintf(stderr, "[file_read] Read %ld bytes\n", read_size);
-  // // fflush(stderr);
+static int kain_sample_cmp(const void *a, const void *b) {
+  const char *const *x = *(const char *const *const *)a;
+  const char *const *y = *(const char *const *const *)b;
+  size_t nx = (size_t)(uintptr_t)x[0], ny = (size_t)(uintptr_t)y[0];
+  for (size_t i = 1; i < nx && i < ny; i++)
+    if (x[i] != y[i])
+      return (uintptr_t)x[i] < (uintptr_t)y[i] ? -1 : 1;
+  return nx < ny ? -1 : nx > ny ? 1 : 0;
+}
 
-  content[size] = '\0';
-  fclose(f);
+static int kain_fn_time_cmp(const void *a, const void *b) {
+  const KainFnTime *x = *(const KainFnTime *const *)a;
+  const KainFnTime *y = *(const KainFnTime *const *)b;
+  return x->total_ns < y->total_ns ? 1 : x->total_ns > y->total_ns ? -1 : 0;
+}
 
-  return content;
+// Print the inclusive time per function to stderr, slowest first
+static void kain_sample_print_times(void) {
+  size_t n = 0;
+  for (KainTimeTable *t = kain_atomic_load_ptr(&all_times); t; t = t->next)
+    n += t->count;
+  if (!n)
+    return;
+  KainFnTime **all = (KainFnTime **)malloc(n * sizeof(KainFnTime *));
+  if (!all)
+    return;
+  n = 0;
+  for (KainTimeTable *t = kain_atomic_load_ptr(&all_times); t; t = t->next)
+    for (size_t i = 0; i < t->cap; i++)
+      if (t->slots[i])
+        all[n++] = t->slots[i];
+  qsort(all, n, sizeof(*all), kain_fn_time_cmp);
+  fprintf(stderr, "\n%-40s %12s %14s\n", "function", "calls", "inclusive ms");
+  for (size_t i = 0; i < n; i++)
+    fprintf(stderr, "%-40s %12llu %14.3f\n", all[i]->name,
+            (unsigned long long)all[i]->calls, (double)all[i]->total_ns / 1e6);
+  free(all);
 }
 
-int64_t kain_file_write(const char *path, const char *content) {
-  // // fprintf(stderr, "[file_write] path='%s' content_len=%zu\n", path ? path
-  // : "NULL", content ? strlen(content) : 0);
-  // // fflush(stderr);
-  FILE *f = fopen(path, "wb");
-  if (!f) {
-    // // fprintf(stderr, "[file_write] Failed to open file!\n");
-    // // fflush(stderr);
+// Write the collapsed stacks to `path` (stderr when null or empty) and the
+// per-function times to stderr. Sampling continues if it was running.
+int64_t kain_sample_write(int64_t path_val) {
+  const char *path = kain_is_string((uint64_t)path_val)
+                         ? kain_unbox_string((uint64_t)path_val)
+                         : (const char *)path_val;
+  FILE *out = stderr;
+  if (path && *path) {
+    out = fopen(path, "w");
+    if (!out) {
+      fprintf(stderr, "kain sample: cannot write %s\n", path);
+      return 0;
+    }
+  }
+
+  // Index the complete records, then sort them so equal stacks are adjacent
+  size_t used = kain_atomic_load(&sample_used);
+  if (used > KAIN_SAMPLE_BUFFER_WORDS)
+    used = KAIN_SAMPLE_BUFFER_WORDS;
+  size_t n = 0;
+  for (size_t at = 0; at < used && sample_buf && sample_buf[at];
+       at += (size_t)(uintptr_t)sample_buf[at])
+    n++;
+  const char ***recs = (const char ***)malloc((n ? n : 1) * sizeof(*recs));
+  if (!recs) {
+    if (out != stderr)
+      fclose(out);
     return 0;
   }
+  n = 0;
+  for (size_t at = 0; at < used && sample_buf && sample_buf[at];
+       at += (size_t)(uintptr_t)sample_buf[at])
+    recs[n++] = &sample_buf[at];
+  qsort(recs, n, sizeof(*recs), kain_sample_cmp);
+
+  for (size_t i = 0; i < n;) {
+    size_t j = i + 1;
+    while (j < n && kain_sample_cmp(&recs[i], &recs[j]) == 0)
+      j++;
+    size_t frames = (size_t)(uintptr_t)recs[i][0] - 1;
+    for (size_t k = 0; k < frames; k++)
+      fprintf(out, "%s%s", k ? ";" : "", recs[i][k + 1]);
+    fprintf(out, " %zu\n", j - i);
+    i = j;
+  }
+  free(recs);
+  if (out != stderr)
+    fclose(out);
+
+  if (sample_dropped)
+    fprintf(stderr, "kain sample: buffer full, %zu samples dropped\n",
+            sample_dropped);
+  if (sample_hz && !n)
+    fprintf(stderr,
+            "kain sample: no samples (was it built with `korec --trace`?)\n");
+  kain_sample_print_times();
+  return 0;
+}
 
-  size_t len = strlen(content);
-  size_t written = fwrite(content, 1, len, f);
-  (void)written; // Silence unused variable warning
-  // // fprintf(stderr, "[file_write] Wrote %zu bytes\n", written);
-  // // fflush(stderr);
-  fclose(f);
+static void kain_sample_at_exit(void) {
+  kain_sample_stop();
+  kain_sample_write((int64_t)sample_env_path);
+}
 
-  return 1;
+// KAIN_SAMPLE=<file> [KAIN_SAMPLE_HZ=<n>]: profile the whole run
+static void kain_sample_from_env(void) {
+  const char *path = getenv("KAIN_SAMPLE");
+  if (!path || !*path)
+    return;
+  const char *hz = getenv("KAIN_SAMPLE_HZ");
+  sample_env_path = path;
+  atexit(kain_sample_at_exit);
+  kain_sample_start(hz ? atoll(hz) : 0);
 }
 
 // =============================================================================
-// Map Operations (simple key-value store using parallel arrays)
+// Task Scheduler (work-stealing thread pool)
+// =============================================================================
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the tail
+// (LIFO, cache-warm) while idle workers steal from the head (FIFO, oldest
+// and usually largest). Threads outside the pool submit through one extra
+// injection deque. join_task() never just blocks: it runs queued tasks until its
+// own is done, so nested spawn/join cannot deadlock the pool.
+//
+// Kain functions are passed as raw `i64 (i64)` code pointers (codegen lowers
+// a bare function name to one). The pool
+// starts on first use with KAIN_THREADS workers (default: one per core,
+// counting the calling thread).
 // =============================================================================
 
+typedef int64_t (*KainTaskFn)(int64_t);
+
+typedef struct KainTask {
+  KainObjHeader obj; // kind = KAIN_OBJ_TASK
+  void (*run)(struct KainTask *);
+  KainTaskFn fn;
+  int64_t arg;    // spawn: the argument; loops: the source array
+  int64_t lo, hi; // loops: element range of this chunk
+  KainArray *dst; // parallel_map output
+  int64_t result;
+  int done;
+} KainTask;
+
 typedef struct {
-  int64_t *keys;
-  int64_t *values;
-  int64_t len;
-  int64_t cap;
-} KainMap;
+  kain_mutex_t lock;
+  KainTask **items; // Ring buffer, `cap` is a power of two
+  size_t head, tail, cap;
+} KainDeque;
+
+static struct {
+  int workers;       // Threads in the pool (the caller of join helps too)
+  KainDeque *deques; // [workers + 1], the last one is the injection queue
+  kain_thread_t *threads;
+  kain_mutex_t sleep_lock;
+  kain_cond_t wake; // New work or a finished task
+  int64_t queued;   // Pushed but not yet taken, under sleep_lock
+  int stop;
+} kain_pool;
+
+static kain_mutex_t kain_pool_init_lock = KAIN_MUTEX_INIT;
+static int kain_pool_ready = 0;
+static KAIN_TLS int kain_worker_id = -1;
+
+static void kain_deque_push(KainDeque *d, KainTask *t) {
+  kain_mutex_lock(&d->lock);
+  if (d->tail - d->head == d->cap) {
+    size_t new_cap = d->cap ? d->cap * 2 : 64;
+    KainTask **items = (KainTask **)malloc(new_cap * sizeof(KainTask *));
+    if (!items) {
+      fprintf(stderr, "FATAL: OOM in kain_spawn\n");
+      exit(1);
+    }
+    for (size_t i = d->head; i != d->tail; i++)
+      items[i & (new_cap - 1)] = d->items[i & (d->cap - 1)];
+    free(d->items);
+    d->items = items;
+    d->cap = new_cap;
+  }
+  d->items[d->tail++ & (d->cap - 1)] = t;
+  kain_mutex_unlock(&d->lock);
+}
 
-int64_t Map_new() {
-  KainMap *map = (KainMap *)malloc(sizeof(KainMap));
-  map->keys = NULL;
-  map->values = NULL;
-  map->len = 0;
-  map->cap = 0;
-  return (int64_t)kain_box_ptr(map);
+static KainTask *kain_deque_take(KainDeque *d, int from_tail) {
+  KainTask *t = NULL;
+  kain_mutex_lock(&d->lock);
+  if (d->head != d->tail)
+    t = from_tail ? d->items[--d->tail & (d->cap - 1)]
+                  : d->items[d->head++ & (d->cap - 1)];
+  kain_mutex_unlock(&d->lock);
+  return t;
 }
 
-int64_t kain_contains_key(int64_t map_val, int64_t key_val) {
-  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
-  if (!map)
-    return (int64_t)kain_box_bool(0);
-  const char *key = (const char *)kain_unbox_any_ptr(key_val);
-  if (map->keys == NULL)
-    return (int64_t)kain_box_bool(0);
+static void kain_pool_submit(KainTask *t) {
+  int id = kain_worker_id >= 0 ? kain_worker_id : kain_pool.workers;
+  kain_deque_push(&kain_pool.deques[id], t);
+  kain_mutex_lock(&kain_pool.sleep_lock);
+  kain_pool.queued++;
+  kain_cond_broadcast(&kain_pool.wake);
+  kain_mutex_unlock(&kain_pool.sleep_lock);
+}
 
-  for (int64_t i = 0; i < map->len; i++) {
-    int64_t stored_key_val = map->keys[i];
-    const char *stored_key = (const char *)kain_unbox_any_ptr(stored_key_val);
-    if (stored_key && strcmp(stored_key, key) == 0) {
-      return (int64_t)kain_box_bool(1);
-    }
+// Own deque first, then the injection queue, then steal round-robin
+static KainTask *kain_pool_find(void) {
+  int n = kain_pool.workers;
+  int self = kain_worker_id;
+  KainTask *t = self >= 0 ? kain_deque_take(&kain_pool.deques[self], 1) : NULL;
+  if (!t)
+    t = kain_deque_take(&kain_pool.deques[n], 0);
+  for (int i = 1; !t && i <= n; i++)
+    t = kain_deque_take(&kain_pool.deques[(self + i + n) % n], 0);
+  if (t) {
+    kain_mutex_lock(&kain_pool.sleep_lock);
+    kain_pool.queued--;
+    kain_mutex_unlock(&kain_pool.sleep_lock);
   }
-  return (int64_t)kain_box_bool(0);
+  return t;
 }
 
-// Map lookup - returns 0 if not found
-int64_t kain_map_get(int64_t map_val, int64_t key_val) {
-  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
-  if (!map)
-    return (int64_t)kain_box_null();
-  const char *key = (const char *)kain_unbox_any_ptr(key_val);
-  if (!map->keys)
-    return (int64_t)kain_box_null();
-  for (int64_t i = 0; i < map->len; i++) {
-    int64_t stored_key_val = map->keys[i];
-    const char *stored_key = (const char *)kain_unbox_any_ptr(stored_key_val);
-    if (stored_key && strcmp(stored_key, key) == 0) {
-      return map->values[i];
+static void kain_task_execute(KainTask *t) {
+  t->run(t);
+  kain_atomic_store(&t->done, 1);
+  kain_mutex_lock(&kain_pool.sleep_lock);
+  kain_cond_broadcast(&kain_pool.wake);
+  kain_mutex_unlock(&kain_pool.sleep_lock);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI kain_worker_main(LPVOID arg)
+#else
+static void *kain_worker_main(void *arg)
+#endif
+{
+  kain_worker_id = (int)(intptr_t)arg;
+  for (;;) {
+    KainTask *t = kain_pool_find();
+    if (t) {
+      kain_task_execute(t);
+      continue;
     }
+    kain_mutex_lock(&kain_pool.sleep_lock);
+    while (kain_pool.queued == 0 && !kain_pool.stop)
+      kain_cond_wait(&kain_pool.wake, &kain_pool.sleep_lock);
+    int stop = kain_pool.stop && kain_pool.queued == 0;
+    kain_mutex_unlock(&kain_pool.sleep_lock);
+    if (stop)
+      break;
   }
-  return (int64_t)kain_box_null();
+  return 0;
 }
 
-// Map insert/update
-void kain_map_set(int64_t map_val, int64_t key_val, int64_t value) {
-  KainMap *map = (KainMap *)kain_unbox_any_ptr(map_val);
-  if (!map)
+static void kain_pool_shutdown(void) {
+  kain_mutex_lock(&kain_pool.sleep_lock);
+  kain_pool.stop = 1;
+  kain_cond_broadcast(&kain_pool.wake);
+  kain_mutex_unlock(&kain_pool.sleep_lock);
+  for (int i = 0; i < kain_pool.workers; i++) {
+#ifdef _WIN32
+    WaitForSingleObject(kain_pool.threads[i], INFINITE);
+    CloseHandle(kain_pool.threads[i]);
+#else
+    pthread_join(kain_pool.threads[i], NULL);
+#endif
+  }
+}
+
+static int kain_cpu_count(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int)n : 1;
+#endif
+}
+
+// For embedders calling compiled Kain code from their own threads: turn on
+// the shared-table locks. Call once, before a second thread enters Kain.
+void kain_enable_threads(void) {
+  if (!kain_char_table_ready)
+    kain_char_table_init();
+  kain_threaded = 1;
+}
+
+static void kain_pool_start(void) {
+  kain_mutex_lock(&kain_pool_init_lock);
+  if (kain_pool_ready) {
+    kain_mutex_unlock(&kain_pool_init_lock);
     return;
-  const char *key = (const char *)kain_unbox_any_ptr(key_val);
-
-  // Check if key exists
-  for (int64_t i = 0; i < map->len; i++) {
-    int64_t stored_key_val = map->keys[i];
-    const char *stored_key = (const char *)kain_unbox_any_ptr(stored_key_val);
-    if (stored_key && strcmp(stored_key, key) == 0) {
-      map->values[i] = value;
-      return;
+  }
+  const char *env = getenv("KAIN_THREADS");
+  int threads = env && atoi(env) > 0 ? atoi(env) : kain_cpu_count();
+  int workers = threads - 1; // The joining thread is the last core
+  if (workers > 256)
+    workers = 256;
+
+  kain_mutex_t init_lock = KAIN_MUTEX_INIT;
+  kain_cond_t init_cond = KAIN_COND_INIT;
+  kain_pool.workers = workers;
+  kain_pool.deques = (KainDeque *)calloc((size_t)workers + 1, sizeof(KainDeque));
+  kain_pool.threads =
+      (kain_thread_t *)calloc((size_t)(workers > 0 ? workers : 1),
+                              sizeof(kain_thread_t));
+  if (!kain_pool.deques || !kain_pool.threads) {
+    fprintf(stderr, "FATAL: OOM starting the thread pool\n");
+    exit(1);
+  }
+  for (int i = 0; i <= workers; i++)
+    kain_pool.deques[i].lock = init_lock;
+  kain_pool.sleep_lock = init_lock;
+  kain_pool.wake = init_cond;
+
+  kain_enable_threads();
+  for (int i = 0; i < workers; i++) {
+#ifdef _WIN32
+    kain_pool.threads[i] =
+        CreateThread(NULL, 0, kain_worker_main, (LPVOID)(intptr_t)i, 0, NULL);
+    int failed = kain_pool.threads[i] == NULL;
+#else
+    int failed = pthread_create(&kain_pool.threads[i], NULL, kain_worker_main,
+                                (void *)(intptr_t)i) != 0;
+#endif
+    if (failed) {
+      fprintf(stderr, "FATAL: could not start worker thread %d\n", i);
+      exit(1);
     }
   }
+  atexit(kain_pool_shutdown);
+  kain_pool_ready = 1;
+  kain_mutex_unlock(&kain_pool_init_lock);
+}
 
-  // Add new key
-  if (map->len >= map->cap) {
-    int64_t new_cap = map->cap == 0 ? 8 : map->cap * 2;
-    map->keys = (int64_t *)realloc(map->keys, new_cap * sizeof(int64_t));
-    map->values = (int64_t *)realloc(map->values, new_cap * sizeof(int64_t));
-    if (!map->keys || !map->values) {
-      printf("FATAL: OOM in map_set\n");
-      exit(1);
+static void kain_task_wait(KainTask *t) {
+  while (!kain_atomic_load(&t->done)) {
+    KainTask *other = kain_pool_find();
+    if (other) {
+      kain_task_execute(other);
+      continue;
     }
-    map->cap = new_cap;
+    kain_mutex_lock(&kain_pool.sleep_lock);
+    if (!kain_atomic_load(&t->done) && kain_pool.queued == 0)
+      kain_cond_wait(&kain_pool.wake, &kain_pool.sleep_lock);
+    kain_mutex_unlock(&kain_pool.sleep_lock);
   }
-  map->keys[map->len] = key_val;
-  map->values[map->len] = value;
-  map->len++;
 }
 
-// =============================================================================
-// String Join (for StringBuilder.build())
-// =============================================================================
+static void kain_task_call(KainTask *t) { t->result = t->fn(t->arg); }
 
-int64_t kain_join(int64_t arr_val, int64_t delim_val) {
-  KainArray *arr = (KainArray *)kain_unbox_any_ptr(arr_val);
-  const char *delim = (const char *)kain_unbox_any_ptr(delim_val);
-  if (!delim)
-    delim = "";
+static void kain_task_for_chunk(KainTask *t) {
+  for (int64_t i = t->lo; i < t->hi; i++)
+    t->fn(kain_array_get_fast(t->arg, i));
+}
 
-  if (!arr || arr->len == 0) {
-    return (int64_t)kain_box_string(kain_str_new(""));
-  }
+static void kain_task_map_chunk(KainTask *t) {
+  for (int64_t i = t->lo; i < t->hi; i++)
+    t->dst->data[i] = t->fn(kain_array_get_fast(t->arg, i));
+}
 
-  size_t delim_len = strlen(delim);
-  size_t total_len = 0;
-  for (int64_t i = 0; i < arr->len; i++) {
-    int64_t val = arr->data[i];
-    const char *s = kain_is_string((uint64_t)val)
-                        ? kain_unbox_string((uint64_t)val)
-                        : (const char *)val;
-    if (s)
-      total_len += strlen(s);
-    if (i < arr->len - 1)
-      total_len += delim_len;
+static KainTaskFn kain_task_fn_arg(int64_t fn_val, const char *who) {
+  if (!fn_val || (uint64_t)fn_val >= NANBOX_QNAN) {
+    fprintf(stderr, "FATAL: %s expects a function\n", who);
+    kain_flush();
+    exit(1);
   }
+  return (KainTaskFn)(intptr_t)fn_val;
+}
+
+// Run fn(arg) on the pool; join_task() returns its result
+int64_t kain_spawn(int64_t fn_val, int64_t arg) {
+  KAIN_PROFILE_CALL();
+  KainTask *t = (KainTask *)arena_alloc_as(sizeof(KainTask), KAIN_GC_OBJ);
+  memset(t, 0, sizeof(*t));
+  t->obj.kind = KAIN_OBJ_TASK;
+  t->run = kain_task_call;
+  t->fn = kain_task_fn_arg(fn_val, "spawn");
+  t->arg = arg;
+  kain_pool_start();
+  if (kain_pool.workers == 0)
+    kain_task_execute(t);
+  else
+    kain_pool_submit(t);
+  return (int64_t)kain_BOX_OBJ(t);
+}
 
-  char *result = (char *)arena_alloc(total_len + 1);
-  result[0] = '\0';
+int64_t kain_task_join(int64_t task_val) {
+  KAIN_PROFILE_CALL();
+  KainTask *t = (KainTask *)kain_unbox_obj((uint64_t)task_val, KAIN_OBJ_TASK);
+  if (!t)
+    return (int64_t)kain_box_null();
+  kain_task_wait(t);
+  return t->result;
+}
 
-  for (int64_t i = 0; i < arr->len; i++) {
-    int64_t val = arr->data[i];
-    const char *s = kain_is_string((uint64_t)val)
-                        ? kain_unbox_string((uint64_t)val)
-                        : (const char *)val;
-    if (s)
-      strcat(result, s);
-    if (i < arr->len - 1)
-      strcat(result, delim);
+// Split [0, n) into a few chunks per thread, run them on the pool (the
+// caller takes the first) and wait for all of them
+static void kain_parallel_run(void (*run)(KainTask *), KainTaskFn fn,
+                              int64_t src, KainArray *dst, int64_t n) {
+  if (n <= 0)
+    return;
+  kain_pool_start();
+  int64_t chunks = (int64_t)(kain_pool.workers + 1) * 4;
+  if (chunks > n)
+    chunks = n;
+  KainTask *tasks = (KainTask *)calloc((size_t)chunks, sizeof(KainTask));
+  if (!tasks) {
+    fprintf(stderr, "FATAL: OOM in kain_parallel_run\n");
+    exit(1);
+  }
+  for (int64_t c = 0; c < chunks; c++) {
+    KainTask *t = &tasks[c];
+    t->obj.kind = KAIN_OBJ_TASK;
+    t->run = run;
+    t->fn = fn;
+    t->arg = src;
+    t->dst = dst;
+    t->lo = n * c / chunks;
+    t->hi = n * (c + 1) / chunks;
+    if (c > 0)
+      kain_pool_submit(t);
   }
+  kain_task_execute(&tasks[0]);
+  for (int64_t c = 1; c < chunks; c++)
+    kain_task_wait(&tasks[c]);
+  free(tasks);
+}
 
-  return (int64_t)kain_box_string(result);
+// fn(x) for every element of an array or range, in parallel and unordered
+int64_t kain_parallel_for(int64_t iter_val, int64_t fn_val) {
+  KAIN_PROFILE_CALL();
+  KainTaskFn fn = kain_task_fn_arg(fn_val, "parallel_for");
+  kain_parallel_run(kain_task_for_chunk, fn, iter_val, NULL,
+                    kain_array_len_raw(iter_val));
+  return 0;
 }
 
-// Debug helper: Read 8 bytes from address
-int64_t kain_peek(int64_t ptr) {
-  if (ptr < 1000) {
-    fprintf(stderr, "FATAL: kain_peek called with null/invalid pointer: %lld\n",
-            (long long)ptr);
-    return 0;
-  }
-  int64_t *p = (int64_t *)ptr;
-  return *p;
+// New array of fn(x) for every element, computed in parallel, in order
+int64_t kain_parallel_map(int64_t arr_val, int64_t fn_val) {
+  KAIN_PROFILE_CALL();
+  KainTaskFn fn = kain_task_fn_arg(fn_val, "parallel_map");
+  int64_t n = kain_array_len_raw(arr_val);
+  KainArray *dst = kain_array_reserve(n);
+  dst->len = n > 0 ? n : 0;
+  kain_parallel_run(kain_task_map_chunk, fn, arr_val, dst, n);
+  return (int64_t)dst;
 }
 
 // =============================================================================
-// Variant Introspection (for enum pattern matching in interpreted code)
+// Buffered Writers
+// =============================================================================
+//
+// writer_open/writer_append return a file handle with a large write buffer,
+// so emitting a big artifact costs one write() per KAIN_WRITER_BUF bytes
+// instead of one per piece. writer_writev() takes an array of pieces and
+// hands long strings and builders to writev() in place: nothing gets
+// flattened into one giant string first.
+//
+// writer_async() double-buffers: a full buffer goes to the thread pool and
+// is written there while the program fills the other one, so generating the
+// next chunk overlaps with the disk. Async pieces are always copied, since
+// the caller may reset a region or reuse a builder right after. A writer
+// keeps the first error it hits; writes, flush and close report it.
+// Writers still open at exit are flushed and closed.
 // =============================================================================
 
-// Get tag name from a tagged union (simplified - returns tag number as string)
-int64_t kain_variant_of(int64_t value_val) {
-  // In our representation, enums are { tag: i64, payload: i8*, name: i8* }
-  int64_t *ptr;
-  if (kain_is_ptr((uint64_t)value_val)) {
-    ptr = (int64_t *)kain_unbox_ptr((uint64_t)value_val);
-  } else {
-    ptr = (int64_t *)value_val;
-  }
+#define KAIN_WRITER_BUF (1 << 20)
+#define KAIN_WRITER_DIRECT (64 * 1024) // Pieces this long skip the buffer
+#define KAIN_WRITER_IOV 64
+
+typedef struct KainWriter {
+  KainObjHeader obj;
+  int fd; // -1 once closed
+  int async;
+  int error;    // errno of the first failed write, 0 if none
+  int active;   // Buffer being filled
+  char *buf[2]; // buf[1] only in async mode
+  size_t len;   // Bytes in buf[active]
+  KainTask flush; // Background write: arg = buffer, lo = length
+  struct KainWriter *next;
+} KainWriter;
+
+static KainWriter *kain_writers = NULL; // Open writers, closed at exit
+static kain_mutex_t kain_writers_lock = KAIN_MUTEX_INIT;
+static void kain_writers_at_exit(void);
+
+static inline KainWriter *kain_unbox_writer(int64_t val) {
+  KainWriter *w = (KainWriter *)kain_unbox_obj((uint64_t)val, KAIN_OBJ_WRITER);
+  return w && w->fd >= 0 ? w : NULL;
+}
 
-  if (!ptr) {
-    // Return tagged string "None"
-    return (int64_t)kain_box_string(kain_str_new("None"));
-  }
+static inline void kain_writer_fail(KainWriter *w, int err) {
+  if (err && !w->error)
+    w->error = err;
+}
 
-  // Name is at offset 2 (the 3rd field)
-  uint64_t name_val = (uint64_t)ptr[2];
+static void kain_writer_flush_task(KainTask *t) {
+  KainWriter *w = (KainWriter *)((char *)t - offsetof(KainWriter, flush));
+  kain_writer_fail(w, kain_fd_write_all(w->fd, (const char *)(intptr_t)t->arg,
+                                        (size_t)t->lo));
+}
 
-  // If it's already a tagged string, return it
-  if (kain_is_string(name_val)) {
-    return (int64_t)name_val;
-  }
+// Block until the background write (if any) has finished
+static void kain_writer_wait(KainWriter *w) {
+  if (!kain_atomic_load(&w->flush.done))
+    kain_task_wait(&w->flush);
+}
 
-  const char *name = (const char *)name_val;
-  // If name is null (shouldn't happen for valid enums), fallback to tag
-  if (name == NULL) {
-    int64_t tag = *ptr;
-    char buf[32];
-    sprintf(buf, "%lld", (long long)tag);
-    return (int64_t)kain_box_string(kain_str_new(buf));
+// Write out the buffer being filled: on the pool in async mode, else here
+static void kain_writer_drain(KainWriter *w) {
+  if (!w->len)
+    return;
+  if (!w->async) {
+    kain_writer_fail(w, kain_fd_write_all(w->fd, w->buf[0], w->len));
+    w->len = 0;
+    return;
   }
+  kain_writer_wait(w);
+  w->flush.arg = (int64_t)(intptr_t)w->buf[w->active];
+  w->flush.lo = (int64_t)w->len;
+  w->flush.done = 0;
+  w->active ^= 1;
+  w->len = 0;
+  if (kain_pool.workers == 0)
+    kain_task_execute(&w->flush);
+  else
+    kain_pool_submit(&w->flush);
+}
 
-  // Create new string and NAN-BOX IT properly
-  // This ensures it is treated as a String by println/str_eq/etc.
-  // kain_box_string now uses kain_BOX_STR macro to ensure correct tagging
-  return (int64_t)kain_box_string(kain_str_new(name));
+static void kain_writer_put(KainWriter *w, const char *p, size_t n) {
+  if (!w->async && n >= KAIN_WRITER_DIRECT) {
+    // Buffered bytes and the piece in one syscall, no copy
+    struct iovec iov[2] = {{w->buf[0], w->len}, {(void *)p, n}};
+    kain_writer_fail(w, kain_fd_writev_all(w->fd, iov, 2));
+    w->len = 0;
+    return;
+  }
+  while (n > 0) {
+    size_t room = KAIN_WRITER_BUF - w->len;
+    size_t take = n < room ? n : room;
+    memcpy(w->buf[w->active] + w->len, p, take);
+    w->len += take;
+    p += take;
+    n -= take;
+    if (w->len == KAIN_WRITER_BUF)
+      kain_writer_drain(w);
+  }
 }
 
-// Extract field from variant by index
-int64_t kain_variant_field(int64_t value_val, int64_t field_idx_val) {
-  int64_t *ptr;
-  if (kain_is_ptr((uint64_t)value_val)) {
-    ptr = (int64_t *)kain_unbox_ptr((uint64_t)value_val);
+// Bytes of one piece: strings and builders as they are, numbers formatted
+// into `tmp` (KAIN_F64_BUF bytes), anything else through kain_to_string
+static KainStrRef kain_writer_piece(int64_t val, char *tmp) {
+  KainStrRef r = {NULL, 0, NULL};
+  KainBuilder *b = kain_unbox_builder(val);
+  uint64_t v = (uint64_t)val;
+  if (b) {
+    r.ptr = b->len ? builder_bytes(b) : "";
+    r.len = (size_t)b->len;
+  } else if (kain_is_int(v)) {
+    r.ptr = tmp;
+    r.len = kain_format_i64(tmp, kain_unbox_int(v));
+  } else if (kain_is_double(v) && v >= KAIN_DOUBLE_MIN && !KAIN_V1_RAW_PTR(v)) {
+    r.ptr = tmp;
+    r.len = kain_format_f64(tmp, kain_unbox_double(v));
   } else {
-    ptr = (int64_t *)value_val;
+    r = kain_str_ref(val);
+    if (!r.ptr)
+      r = kain_str_ref(kain_to_string(val));
   }
+  return r;
+}
 
-  if (!ptr)
-    return (int64_t)kain_box_null();
-
-  // Unbox field index!
-  int64_t field_idx = kain_is_int((uint64_t)field_idx_val)
-                          ? kain_unbox_int((uint64_t)field_idx_val)
-                          : field_idx_val;
-
-  // The payload is at offset 1 (ptr[1])
-  int64_t payload_val = ptr[1];
-  if (payload_val == 0)
+static int64_t kain_writer_new(int64_t path_val, int append) {
+  const char *path = kain_unbox_string((uint64_t)path_val);
+  int fd = path ? kain_fd_open(path, O_WRONLY | O_CREAT |
+                                         (append ? O_APPEND : O_TRUNC))
+                : -1;
+  if (fd < 0)
     return (int64_t)kain_box_null();
 
-  int64_t *tuple;
-  if (kain_is_ptr((uint64_t)payload_val)) {
-    tuple = (int64_t *)kain_unbox_ptr((uint64_t)payload_val);
-  } else {
-    tuple = (int64_t *)payload_val;
+  // malloc'd, not arena: the exit hook must still find it after the program
+  // dropped its last reference
+  KainWriter *w = (KainWriter *)calloc(1, sizeof(KainWriter));
+  char *buf = (char *)malloc(KAIN_WRITER_BUF);
+  if (!w || !buf) {
+    fprintf(stderr, "FATAL: OOM in kain_writer_new\n");
+    exit(1);
   }
-
-  return tuple[field_idx];
+  w->obj.kind = KAIN_OBJ_WRITER;
+  w->fd = fd;
+  w->buf[0] = buf;
+  w->flush.obj.kind = KAIN_OBJ_TASK;
+  w->flush.run = kain_writer_flush_task;
+  w->flush.done = 1;
+
+  static int exit_hook = 0;
+  KAIN_SHARED_LOCK(&kain_writers_lock);
+  w->next = kain_writers;
+  kain_writers = w;
+  if (!exit_hook) {
+    atexit(kain_writers_at_exit);
+    exit_hook = 1;
+  }
+  KAIN_SHARED_UNLOCK(&kain_writers_lock);
+  return (int64_t)kain_BOX_OBJ(w);
 }
 
-// =============================================================================
-// Process / System
-// =============================================================================
-
-int64_t kain_system(const char *command) { return (int64_t)system(command); }
+int64_t kain_writer_open(int64_t path_val) {
+  KAIN_PROFILE_CALL();
+  return kain_writer_new(path_val, 0);
+}
 
-void kain_exit(int64_t code) { exit((int)code); }
+int64_t kain_writer_append(int64_t path_val) {
+  KAIN_PROFILE_CALL();
+  return kain_writer_new(path_val, 1);
+}
 
-void kain_panic(const char *message) {
-  fprintf(stderr, "\n\n!!! Kain PANIC !!!\n");
-  fprintf(stderr, "Reason: %s\n\n", message);
-  fflush(stderr); // CRITICAL: Force output before exit
-  fflush(stdout);
-  exit(1);
+// Switch to background flushing; returns the writer
+int64_t kain_writer_async(int64_t w_val) {
+  KAIN_PROFILE_CALL();
+  KainWriter *w = kain_unbox_writer(w_val);
+  if (!w || w->async)
+    return w_val;
+  w->buf[1] = (char *)malloc(KAIN_WRITER_BUF);
+  if (!w->buf[1]) {
+    fprintf(stderr, "FATAL: OOM in kain_writer_async\n");
+    exit(1);
+  }
+  kain_pool_start();
+  w->async = 1;
+  return w_val;
 }
 
-// =============================================================================
-// Stdlib Wrappers (for direct linking without stdlib source)
-// =============================================================================
+int64_t kain_writer_write(int64_t w_val, int64_t val) {
+  KAIN_PROFILE_CALL();
+  KainWriter *w = kain_unbox_writer(w_val);
+  if (!w)
+    return (int64_t)kain_box_bool(0);
+  char tmp[KAIN_F64_BUF];
+  KainStrRef r = kain_writer_piece(val, tmp);
+  if (r.len)
+    kain_writer_put(w, r.ptr, r.len);
+  return (int64_t)kain_box_bool(w->error == 0);
+}
 
-int64_t args() {
-  printf("DEBUG: [RUNTIME] Entering args()\n");
-  fflush(stdout);
-  int64_t arr_boxed = kain_array_new();
-  printf("DEBUG: [RUNTIME] g_argc = %d\n", g_argc);
-  fflush(stdout);
-  for (int i = 0; i < g_argc; i++) {
-    printf("DEBUG: [RUNTIME] processing arg %d: %s\n", i, g_argv[i]);
-    fflush(stdout);
-    char *str_copy = kain_str_new(g_argv[i]);
-    kain_array_push(arr_boxed, (int64_t)kain_box_string(str_copy));
+// Write every element of `pieces` in order. Short pieces are copied into the
+// buffer, long ones go to writev() by reference next to the buffered runs.
+int64_t kain_writer_writev(int64_t w_val, int64_t pieces) {
+  KAIN_PROFILE_CALL();
+  KainWriter *w = kain_unbox_writer(w_val);
+  if (!w)
+    return (int64_t)kain_box_bool(0);
+  int64_t n = kain_array_len_raw(pieces);
+  char tmp[KAIN_F64_BUF];
+
+  if (w->async) {
+    for (int64_t i = 0; i < n; i++) {
+      KainStrRef r = kain_writer_piece(kain_array_get_fast(pieces, i), tmp);
+      if (r.len)
+        kain_writer_put(w, r.ptr, r.len);
+    }
+    return (int64_t)kain_box_bool(w->error == 0);
   }
-  printf("DEBUG: [RUNTIME] Returning from args()\n");
-  fflush(stdout);
-  return arr_boxed;
-}
 
-int64_t read_file(int64_t path_val) {
-  const char *p = (const char *)kain_unbox_any_ptr(path_val);
-  printf("DEBUG: [RUNTIME] read_file: path='%s'\n", p ? p : "NULL");
-  fflush(stdout);
-  char *content = kain_file_read(p);
-  if (content == NULL) {
-    printf("DEBUG: [RUNTIME] read_file FAILED\n");
-    fflush(stdout);
-    return (int64_t)kain_box_null();
+  struct iovec iov[KAIN_WRITER_IOV];
+  int cnt = 0;
+  size_t mark = 0; // Buffered bytes before `mark` are already in iov
+  for (int64_t i = 0; i < n; i++) {
+    KainStrRef r = kain_writer_piece(kain_array_get_fast(pieces, i), tmp);
+    if (!r.len)
+      continue;
+    int direct = r.len >= KAIN_WRITER_DIRECT;
+    // Room for this piece, its buffered run and a trailing run
+    if (cnt + 3 > KAIN_WRITER_IOV ||
+        (!direct && w->len + r.len > KAIN_WRITER_BUF)) {
+      if (w->len > mark)
+        iov[cnt++] = (struct iovec){w->buf[0] + mark, w->len - mark};
+      kain_writer_fail(w, kain_fd_writev_all(w->fd, iov, cnt));
+      cnt = 0;
+      w->len = mark = 0;
+    }
+    if (direct) {
+      if (w->len > mark)
+        iov[cnt++] = (struct iovec){w->buf[0] + mark, w->len - mark};
+      mark = w->len;
+      iov[cnt++] = (struct iovec){(void *)r.ptr, r.len};
+    } else {
+      memcpy(w->buf[0] + w->len, r.ptr, r.len);
+      w->len += r.len;
+    }
   }
-  printf("DEBUG: [RUNTIME] read_file SUCCESS, len=%zu\n", strlen(content));
-  fflush(stdout);
-  return (int64_t)kain_box_string(content);
+  // Pieces referenced by iov belong to the caller: write them before
+  // returning. A purely buffered tail can wait for the next flush.
+  if (cnt) {
+    if (w->len > mark)
+      iov[cnt++] = (struct iovec){w->buf[0] + mark, w->len - mark};
+    kain_writer_fail(w, kain_fd_writev_all(w->fd, iov, cnt));
+    w->len = 0;
+  }
+  return (int64_t)kain_box_bool(w->error == 0);
 }
 
-int64_t write_file(int64_t path_val, int64_t content_val) {
-  const char *p = (const char *)kain_unbox_any_ptr(path_val);
-  const char *c = (const char *)kain_unbox_any_ptr(content_val);
-  return (int64_t)kain_box_int(kain_file_write(p, c));
+// Write out everything buffered (waiting for a background flush); true if
+// every write so far succeeded
+int64_t kain_writer_flush(int64_t w_val) {
+  KAIN_PROFILE_CALL();
+  KainWriter *w = kain_unbox_writer(w_val);
+  if (!w)
+    return (int64_t)kain_box_bool(0);
+  kain_writer_drain(w);
+  kain_writer_wait(w);
+  return (int64_t)kain_box_bool(w->error == 0);
 }
 
-int64_t file_exists(int64_t path_val) {
-  const char *p = kain_is_string((uint64_t)path_val)
-                      ? kain_unbox_string((uint64_t)path_val)
-                      : (const char *)path_val;
-  FILE *f = fopen(p, "rb");
-  if (f) {
-    fclose(f);
-    return (int64_t)kain_box_int(1);
+int64_t kain_writer_close(int64_t w_val) {
+  KAIN_PROFILE_CALL();
+  KainWriter *w = kain_unbox_writer(w_val);
+  if (!w)
+    return (int64_t)kain_box_bool(0);
+  kain_writer_drain(w);
+  kain_writer_wait(w);
+  if (kain_fd_close(w->fd) != 0)
+    kain_writer_fail(w, errno);
+  w->fd = -1;
+  free(w->buf[0]);
+  free(w->buf[1]);
+  w->buf[0] = w->buf[1] = NULL;
+
+  KAIN_SHARED_LOCK(&kain_writers_lock);
+  for (KainWriter **link = &kain_writers; *link; link = &(*link)->next) {
+    if (*link == w) {
+      *link = w->next;
+      break;
+    }
   }
-  return (int64_t)kain_box_int(0);
+  KAIN_SHARED_UNLOCK(&kain_writers_lock);
+  // The struct stays allocated: the program may still hold the handle
+  return (int64_t)kain_box_bool(w->error == 0);
 }
 
-int64_t substring(int64_t str_val, int64_t start, int64_t end) {
-  return kain_substring(str_val, start, end);
+static void kain_writers_at_exit(void) {
+  // Runs after the pool has drained (or never started): finish in-flight
+  // writes, then write the rest from this thread
+  while (kain_writers) {
+    KainWriter *w = kain_writers;
+    kain_writer_wait(w);
+    w->async = 0;
+    if (w->len) {
+      kain_writer_fail(w, kain_fd_write_all(w->fd, w->buf[w->active], w->len));
+      w->len = 0;
+    }
+    kain_writer_close((int64_t)kain_BOX_OBJ(w));
+  }
 }
 
-int64_t replace(int64_t str_val, int64_t old_val, int64_t new_val) {
-  return kain_str_replace(str_val, old_val, new_val);
+// =============================================================================
+// Garbage Collector (opt-in: build the runtime with -DKAIN_GC)
+// =============================================================================
+//
+// Stop-the-world mark-sweep over the blocks described in "Collected heap".
+// Roots are
+//   - the shadow stack: `korec --gc` spills every local and parameter to a
+//     slot and registers it with kain_gc_root() in a per-call frame,
+//   - slots an embedder registered with kain_gc_add_root(),
+//   - unless built with KAIN_GC_PRECISE, the native stack and registers,
+//     scanned conservatively so temporaries held by compiled code or by the
+//     runtime itself in the middle of a call survive an automatic collection.
+//
+// Tagged values are traced by tag. Raw V1 words (codegen still passes arrays
+// as plain pointers) are looked up in the block set, so a number that merely
+// looks like an address can at worst retain a block, never corrupt one.
+// Stack words may point anywhere inside a block; heap words must point at
+// its start (or at a string's bytes).
+//
+// Precise builds collect only at explicit gc_collect() calls, where every
+// live value is in a rooted local. Once worker threads exist (spawn_task,
+// parallel_for, kain_enable_threads) collection is skipped: their stacks and
+// arenas are not visible here.
+// =============================================================================
+
+// The shadow stack is per thread, like the arena: compiled code on pool
+// workers pushes and unwinds frames concurrently with the main thread
+static KAIN_TLS int64_t gc_root_len = 0; // Shadow stack depth
+
+#ifdef KAIN_GC
+static KAIN_TLS int64_t **gc_roots = NULL; // Shadow stack of variable slots
+static KAIN_TLS int64_t gc_root_cap = 0;
+
+static void gc_push_slot(int64_t ***stack, int64_t *len, int64_t *cap,
+                         int64_t *slot) {
+  if (*len == *cap) {
+    int64_t new_cap = *cap ? *cap * 2 : 256;
+    int64_t **grown =
+        (int64_t **)realloc(*stack, (size_t)new_cap * sizeof(int64_t *));
+    if (!grown) {
+      fprintf(stderr, "FATAL: OOM growing the GC root stack\n");
+      exit(1);
+    }
+    *stack = grown;
+    *cap = new_cap;
+  }
+  (*stack)[(*len)++] = slot;
+}
+#endif
+
+// Shadow stack protocol emitted by `korec --gc`: a function saves the depth
+// on entry, registers each variable slot, and unwinds to the saved depth on
+// return (and at every loop header, so loop bodies don't pile up slots)
+int64_t kain_gc_frame(void) { return gc_root_len; }
+
+void kain_gc_root(int64_t *slot) {
+#ifdef KAIN_GC
+  gc_push_slot(&gc_roots, &gc_root_len, &gc_root_cap, slot);
+#else
+  (void)slot;
+  gc_root_len++;
+#endif
 }
 
-int64_t starts_with(int64_t str_val, int64_t prefix_val) {
-  return kain_str_starts_with(str_val, prefix_val);
+void kain_gc_unwind(int64_t frame) {
+  if (frame < gc_root_len)
+    gc_root_len = frame;
 }
 
-// Wrappers for high-performance lexer
-int64_t char_code_at(int64_t str_val, int64_t index_val) {
-  return kain_char_code_at(str_val, index_val);
+// Free the malloc'd storage behind an object of allocation kind `kind`
+// (KAIN_GC_*): the collector calls it on dead blocks, arena_rewind() on the
+// objects a region created
+static void kain_finalize(void *p, uint32_t kind) {
+  if (kind == KAIN_GC_ARRAY) {
+    // A shared or borrowed buffer still belongs to the views
+    KainArray *arr = (KainArray *)p;
+    if (KAIN_ARRAY_OWNS_DATA(arr))
+      free(arr->data);
+  } else if (kind == KAIN_GC_MAP) {
+    KainMap *map = (KainMap *)p;
+    free(map->entries);
+    free(map->old_entries);
+  } else if (kind == KAIN_GC_OBJ) {
+    KainObjHeader *obj = (KainObjHeader *)p;
+    switch (obj->kind) {
+    case KAIN_OBJ_BUILDER:
+      free(((KainBuilder *)p)->buf);
+      break;
+    case KAIN_OBJ_READER: {
+      KainReader *r = (KainReader *)p;
+      if (r->buf && !r->is_stdin)
+        fclose(r->f);
+      free(r->buf);
+      break;
+    }
+    case KAIN_OBJ_I64_ARRAY:
+    case KAIN_OBJ_F64_ARRAY:
+    case KAIN_OBJ_U8_ARRAY:
+      free(((KainTypedArray *)p)->data);
+      break;
+    default:
+      break;
+    }
+  }
 }
 
-int64_t char_from_code(int64_t code_val) {
-  return kain_char_from_code(code_val);
+#ifndef KAIN_GC
+static void region_release_owned(size_t from) {
+  while (region_owned_len > from) {
+    RegionOwned *o = &region_owned[--region_owned_len];
+    kain_finalize(o->obj, o->kind);
+  }
 }
+#endif
 
-int64_t to_float(int64_t str_ptr) { return kain_to_float(str_ptr); }
+#ifdef KAIN_GC
 
-// Missing aliases for bootstrap compatibility
-int64_t str_eq(int64_t a, int64_t b) { return kain_str_eq(a, b); }
+static int64_t **gc_globals = NULL; // kain_gc_add_root() slots
+static int64_t gc_global_len = 0;
+static int64_t gc_global_cap = 0;
 
-int64_t array_len(int64_t arr) { return kain_array_len(arr); }
+static void **gc_gray = NULL; // Marked blocks whose payload is not traced yet
+static size_t gc_gray_len = 0;
+static size_t gc_gray_cap = 0;
 
-int64_t push(int64_t arr, int64_t val) { return kain_array_push(arr, val); }
+static char *gc_stack_base = NULL; // Outermost frame, see kain_gc_init()
 
-int64_t pop(int64_t arr) { return kain_array_pop(arr); }
+static void gc_mark(void *p) {
+  KainGcHeader *h = gc_header(p);
+  if (h->mark)
+    return;
+  h->mark = 1;
+  if (h->kind == KAIN_GC_LEAF)
+    return;
+  if (gc_gray_len == gc_gray_cap) {
+    size_t cap = gc_gray_cap ? gc_gray_cap * 2 : 1024;
+    void **grown = (void **)realloc(gc_gray, cap * sizeof(void *));
+    if (!grown) {
+      fprintf(stderr, "FATAL: OOM growing the GC mark stack\n");
+      exit(1);
+    }
+    gc_gray = grown;
+    gc_gray_cap = cap;
+  }
+  gc_gray[gc_gray_len++] = p;
+}
 
-int64_t to_int(int64_t str_val) { return kain_to_int(str_val); }
+// The block a heap slot refers to, if any
+static void *gc_ref(uint64_t v) {
+  if (v >= NANBOX_QNAN) {
+    uint64_t tag = (v >> NANBOX_TAG_SHIFT) & 0x7;
+    if (tag == kain_TAG_PTR || tag == kain_TAG_OBJ)
+      return gc_find((uintptr_t)kain_UNBOX_PTR(v));
+    if (tag != kain_TAG_STR)
+      return NULL;
+    // Heap strings start with their header; a reader's current line is a
+    // header embedded in the reader
+    uintptr_t hdr = (uintptr_t)kain_UNBOX_STR(v) - sizeof(KainStrHeader);
+    void *b = gc_find(hdr);
+    return b ? b : gc_find(hdr - offsetof(KainReader, line));
+  }
+  // V1 raw pointer: a block, or the bytes of a heap string
+  void *b = gc_find((uintptr_t)v);
+  return b ? b : gc_find((uintptr_t)v - sizeof(KainStrHeader));
+}
 
-int64_t join(int64_t arr, int64_t sep) { return kain_join(arr, sep); }
+static void gc_scan_slots(const int64_t *slots, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    void *b = gc_ref((uint64_t)slots[i]);
+    if (b)
+      gc_mark(b);
+  }
+}
 
-int64_t variant_of(int64_t val) { return kain_variant_of(val); }
+static void gc_scan_entries(const KainMapEntry *e, int64_t cap) {
+  for (int64_t i = 0; e && i < cap; i++) {
+    if (!e[i].hash)
+      continue;
+    gc_scan_slots(&e[i].key, 1);
+    gc_scan_slots(&e[i].value, 1);
+  }
+}
 
-int64_t println(int64_t val) { return kain_println_str(val); }
+static void gc_trace(void *p) {
+  KainGcHeader *h = gc_header(p);
+  if (h->kind == KAIN_GC_ARRAY) {
+    KainArray *arr = (KainArray *)p;
+    if (arr->data)
+      gc_scan_slots(arr->data, (size_t)arr->len);
+  } else if (h->kind == KAIN_GC_MAP) {
+    KainMap *map = (KainMap *)p;
+    gc_scan_entries(map->entries, map->cap);
+    gc_scan_entries(map->old_entries, map->old_cap);
+  } else {
+    // Raw slots and runtime objects: any word may hold a value. Fields that
+    // are malloc'd buffers or plain numbers simply don't resolve to a block.
+    gc_scan_slots((const int64_t *)p, h->size / sizeof(int64_t));
+  }
+}
 
-int64_t panic(int64_t msg) {
-  const char *str = (const char *)kain_unbox_any_ptr(msg);
-  kain_panic(str);
-  return 0; // never reached
+#ifndef KAIN_GC_PRECISE
+
+static int gc_cmp_ptr(const void *a, const void *b) {
+  uintptr_t x = (uintptr_t)*(void *const *)a;
+  uintptr_t y = (uintptr_t)*(void *const *)b;
+  return x < y ? -1 : x > y;
 }
 
-int64_t contains(int64_t str, int64_t substr) {
-  return kain_contains(str, substr); // Fixed: was kain_str_contains, should be
-                                     // polymorphic kain_contains
+// Mark the block containing `p` (sorted: all blocks by address)
+static void gc_mark_interior(void **sorted, size_t n, uintptr_t p) {
+  if (p < gc_lo || p > gc_hi + gc_header((void *)gc_hi)->size)
+    return;
+  size_t lo = 0, hi = n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if ((uintptr_t)sorted[mid] <= p)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return;
+  void *b = sorted[lo - 1];
+  if (p <= (uintptr_t)b + gc_header(b)->size)
+    gc_mark(b);
 }
 
-int64_t variant_field(int64_t val, int64_t idx) {
-  return kain_variant_field(val, idx);
+// Reads the frames of every caller, including sanitizer redzones
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((noinline, no_sanitize_address))
+#endif
+static void gc_scan_native_stack(void **sorted, size_t n) {
+  // Spill callee-saved registers so values that live only in them are seen
+  jmp_buf regs;
+  setjmp(regs);
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_unwind_init();
+#endif
+  char *top = (char *)&regs;
+  uintptr_t start = ((uintptr_t)top + 7) & ~(uintptr_t)7;
+  for (uintptr_t a = start; a + sizeof(int64_t) <= (uintptr_t)gc_stack_base;
+       a += sizeof(int64_t)) {
+    uint64_t v = *(volatile uint64_t *)a;
+    uint64_t tag = (v >> NANBOX_TAG_SHIFT) & 0x7;
+    if (v >= NANBOX_QNAN && (tag == kain_TAG_PTR || tag == kain_TAG_OBJ ||
+                             tag == kain_TAG_STR))
+      v = (uint64_t)(uintptr_t)kain_UNBOX_PTR(v);
+    gc_mark_interior(sorted, n, (uintptr_t)v);
+  }
 }
 
-// Wrapper for stdlib compatibility - avoid name collision with C str* functions
-int64_t kain_str(int64_t val) { return kain_to_string(val); }
+static void gc_mark_stack_roots(void) {
+  if (!gc_stack_base || !gc_block_count)
+    return;
+  void **sorted = (void **)malloc(gc_block_count * sizeof(void *));
+  if (!sorted) {
+    fprintf(stderr, "FATAL: OOM scanning the stack for GC roots\n");
+    exit(1);
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < gc_block_cap; i++)
+    if (gc_blocks[i])
+      sorted[n++] = gc_blocks[i];
+  qsort(sorted, n, sizeof(void *), gc_cmp_ptr);
+  gc_scan_native_stack(sorted, n);
+  free(sorted);
+}
 
-int64_t to_string(int64_t val) { return kain_to_string(val); }
+#endif
+
+// Free every unmarked block, clear the marks and rebuild the set
+static size_t gc_sweep(void) {
+  size_t live = 0, survivors = 0;
+  for (size_t i = 0; i < gc_block_cap; i++)
+    if (gc_blocks[i] && gc_header(gc_blocks[i])->mark)
+      survivors++;
+  size_t cap = 1024;
+  while (cap < survivors * 2)
+    cap *= 2;
+
+  void **table = gc_table_new(cap);
+  size_t freed = 0;
+  gc_lo = UINTPTR_MAX;
+  gc_hi = 0;
+  for (size_t i = 0; i < gc_block_cap; i++) {
+    void *p = gc_blocks[i];
+    if (!p)
+      continue;
+    KainGcHeader *h = gc_header(p);
+    if (!h->mark) {
+      freed += h->size;
+      kain_finalize(p, h->kind);
+      free(h);
+      continue;
+    }
+    h->mark = 0;
+    live += h->size;
+    gc_table_insert(table, cap, p);
+    if ((uintptr_t)p < gc_lo)
+      gc_lo = (uintptr_t)p;
+    if ((uintptr_t)p > gc_hi)
+      gc_hi = (uintptr_t)p;
+  }
+  free(gc_blocks);
+  gc_blocks = table;
+  gc_block_cap = cap;
+  gc_block_count = survivors;
+  gc_live_bytes = live;
+  return freed;
+}
 
-int64_t map_set(int64_t map, int64_t key, int64_t val) {
-  kain_map_set(map, key, val);
-  return 0;
+static size_t gc_run(int scan_stack) {
+  if (kain_threaded || !gc_block_count)
+    return 0;
+  for (int64_t i = 0; i < gc_root_len; i++)
+    gc_scan_slots(gc_roots[i], 1);
+  for (int64_t i = 0; i < gc_global_len; i++)
+    gc_scan_slots(gc_globals[i], 1);
+#ifndef KAIN_GC_PRECISE
+  if (scan_stack)
+    gc_mark_stack_roots();
+#else
+  (void)scan_stack;
+#endif
+  while (gc_gray_len)
+    gc_trace(gc_gray[--gc_gray_len]);
+
+  size_t freed = gc_sweep();
+  gc_alloc_bytes = 0;
+  // Collect again once as much has been allocated as survived
+  gc_threshold = gc_live_bytes > KAIN_GC_MIN_HEAP ? gc_live_bytes
+                                                   : KAIN_GC_MIN_HEAP;
+  return freed;
 }
 
-int64_t contains_key(int64_t map, int64_t key) {
-  return kain_contains_key(map, key);
+// Allocation-triggered collection; needs the conservative stack scan
+static void kain_gc_maybe_collect(void) {
+#ifndef KAIN_GC_PRECISE
+  if (gc_stack_base && !kain_threaded) {
+    gc_run(1);
+    return;
+  }
+#endif
+  gc_alloc_bytes = 0;
 }
 
-int64_t map_get(int64_t map, int64_t key) { return kain_map_get(map, key); }
+#endif // KAIN_GC
+
+// Record the outermost stack frame that may hold Kain values. main() does
+// this; an embedder that calls compiled code from its own threads' entry
+// points should call it there before the first allocation.
+void kain_gc_init(void *stack_base) {
+#ifdef KAIN_GC
+  gc_stack_base = (char *)stack_base;
+#else
+  (void)stack_base;
+#endif
+}
 
-int64_t split(int64_t str, int64_t delim) { return kain_split(str, delim); }
+// Keep `*slot` alive across collections (embedder globals)
+void kain_gc_add_root(int64_t *slot) {
+#ifdef KAIN_GC
+  gc_push_slot(&gc_globals, &gc_global_len, &gc_global_cap, slot);
+#else
+  (void)slot;
+#endif
+}
 
-int64_t str_len(int64_t str) { return kain_str_len(str); }
-extern int64_t main_Kain();
+// Collect now; returns the number of bytes freed (boxed). Without KAIN_GC
+// there is nothing to collect.
+int64_t kain_gc_collect(void) {
+#ifdef KAIN_GC
+  return (int64_t)kain_box_int((int64_t)gc_run(1));
+#else
+  return (int64_t)kain_box_int(0);
+#endif
+}
+
+// Bytes held by collected blocks (boxed); the arena's bytes without KAIN_GC
+int64_t kain_gc_heap_bytes(void) {
+#ifdef KAIN_GC
+  return (int64_t)kain_box_int((int64_t)(gc_live_bytes + gc_alloc_bytes));
+#else
+  return kain_arena_used();
+#endif
+}
 
 // =============================================================================
-// TokenType Constructors (Workaround for bootstrap codegen bug)
+// Profile Report
 // =============================================================================
 
-int64_t kain_create_token_simple(const char *name) {
-  int64_t *ptr = (int64_t *)kain_alloc(24);
-  ptr[0] = 0;
-  ptr[1] = 0; // null payload
-  ptr[2] = (int64_t)kain_box_string(kain_str_new(name));
-  return (int64_t)kain_box_ptr(ptr);
+#ifdef KAIN_PROFILE
+static int kain_prof_site_cmp(const void *a, const void *b) {
+  size_t ca = (*(KainProfSite *const *)a)->calls;
+  size_t cb = (*(KainProfSite *const *)b)->calls;
+  return ca < cb ? 1 : ca > cb ? -1 : 0;
 }
-
-int64_t kain_create_token_payload(const char *name, int64_t val) {
-  int64_t *ptr = (int64_t *)kain_alloc(24);
-  ptr[0] = 0;
-  int64_t *tuple = (int64_t *)kain_alloc(8);
-  tuple[0] = val;
-  ptr[1] = (int64_t)tuple;
-  ptr[2] = (int64_t)kain_box_string(kain_str_new(name));
-  return (int64_t)kain_box_ptr(ptr);
+#endif
+
+// Print the KAIN_PROFILE counters to stderr, busiest builtins first. The
+// counts keep running, so calling this twice shows the totals so far.
+int64_t kain_profile_dump(void) {
+  // Drain stdout directly: kain_flush() would count itself
+  KAIN_SHARED_LOCK(&kain_out_lock);
+  kain_out_drain();
+  KAIN_SHARED_UNLOCK(&kain_out_lock);
+#ifdef KAIN_PROFILE
+  static const char *kind_names[KAIN_PROF_KINDS] = {
+      "raw (structs, options)", "string", "array", "map", "object"};
+  size_t n = 0;
+  for (KainProfSite *s = kain_atomic_load_ptr(&kain_prof_sites); s; s = s->next)
+    n++;
+  KainProfSite **sites = (KainProfSite **)malloc((n ? n : 1) * sizeof(*sites));
+  if (!sites)
+    return 0;
+  n = 0;
+  for (KainProfSite *s = kain_atomic_load_ptr(&kain_prof_sites); s; s = s->next)
+    sites[n++] = s;
+  qsort(sites, n, sizeof(*sites), kain_prof_site_cmp);
+
+  fprintf(stderr, "\n=== kain profile ===\n");
+  fprintf(stderr, "%-32s %14s\n", "builtin", "calls");
+  for (size_t i = 0; i < n; i++)
+    fprintf(stderr, "%-32s %14zu\n", sites[i]->name, sites[i]->calls);
+  free(sites);
+
+  fprintf(stderr, "\n%-32s %14s %14s\n", "allocations", "objects", "bytes");
+  for (int k = 0; k < KAIN_PROF_KINDS; k++)
+    fprintf(stderr, "%-32s %14zu %14zu\n", kind_names[k],
+            kain_prof_objects[k], kain_prof_bytes[k]);
+
+  size_t lookups = kain_prof_events[KAIN_PROF_MAP_LOOKUPS];
+  size_t probes = kain_prof_events[KAIN_PROF_MAP_PROBES];
+  fprintf(stderr, "\n%-32s %14zu\n", "map lookups", lookups);
+  fprintf(stderr, "%-32s %14zu (%.2f per lookup)\n", "map probes", probes,
+          lookups ? (double)probes / (double)lookups : 0.0);
+  fprintf(stderr, "%-32s %14zu\n", "buffer growths",
+          kain_prof_events[KAIN_PROF_GROWTHS]);
+  fprintf(stderr, "%-32s %14zu (%zu bytes)\n", "string copies",
+          kain_prof_events[KAIN_PROF_STR_COPIES],
+          kain_prof_events[KAIN_PROF_STR_COPY_BYTES]);
+  fflush(stderr);
+#else
+  fprintf(stderr, "kain profile: runtime built without -DKAIN_PROFILE\n");
+#endif
+  return 0;
 }
 
 // =============================================================================
-// Stack Trace Support
+// Benchmarks
+// =============================================================================
+//
+// bench(name, f, runs) calls f(i) a few times untimed, to warm the caches
+// and the allocator, then `runs` more times under the monotonic clock. It
+// prints one line with the min, median and p99 of the timed runs and the
+// bytes allocated per run (and the number of allocations, counting buffer
+// regrowths, in -DKAIN_PROFILE builds), and
+// returns the median in nanoseconds. KAIN_BENCH_RUNS overrides every
+// `runs`, e.g. KAIN_BENCH_RUNS=1 to smoke-test a suite.
 // =============================================================================
 
-#define MAX_STACK_FRAMES 64
+#define KAIN_BENCH_MAX_RUNS 1000000
+#define KAIN_BENCH_MAX_WARMUP 100
+
+// Bytes allocated so far: exact when profiling, arena/heap growth otherwise
+static size_t kain_bench_bytes(void) {
+#ifdef KAIN_PROFILE
+  size_t n = 0;
+  for (int k = 0; k < KAIN_PROF_KINDS; k++)
+    n += kain_prof_bytes[k];
+  return n;
+#elif defined(KAIN_GC)
+  return gc_total_bytes;
+#else
+  return total_allocated;
+#endif
+}
 
-typedef struct {
-  const char *function_name;
-  const char *file;
-  int line;
-} KainStackFrame;
+// Objects allocated plus buffers regrown (in malloc'd storage, not in bytes)
+static size_t kain_bench_objects(void) {
+  size_t n = 0;
+#ifdef KAIN_PROFILE
+  for (int k = 0; k < KAIN_PROF_KINDS; k++)
+    n += kain_prof_objects[k];
+  n += kain_prof_events[KAIN_PROF_GROWTHS];
+#endif
+  return n;
+}
 
-static KainStackFrame g_stack_frames[MAX_STACK_FRAMES];
-static int g_stack_depth = 0;
+static int kain_bench_cmp(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
 
-// Called when entering a function (instrumented by codegen)
-void kain_trace_enter(const char *func_name, const char *file, int line) {
-  if (g_stack_depth < MAX_STACK_FRAMES) {
-    g_stack_frames[g_stack_depth].function_name = func_name;
-    g_stack_frames[g_stack_depth].file = file;
-    g_stack_frames[g_stack_depth].line = line;
-    g_stack_depth++;
-  }
+static void kain_bench_fmt(char *buf, size_t cap, uint64_t ns) {
+  if (ns < 10000)
+    snprintf(buf, cap, "%llu ns", (unsigned long long)ns);
+  else if (ns < 10000000)
+    snprintf(buf, cap, "%.2f us", (double)ns / 1e3);
+  else if (ns < 10000000000ULL)
+    snprintf(buf, cap, "%.2f ms", (double)ns / 1e6);
+  else
+    snprintf(buf, cap, "%.2f s", (double)ns / 1e9);
 }
 
-// Called when exiting a function
-void kain_trace_exit(void) {
-  if (g_stack_depth > 0) {
-    g_stack_depth--;
+int64_t kain_bench(int64_t name_val, int64_t fn_val, int64_t runs_val) {
+  KAIN_PROFILE_CALL();
+  const char *name = kain_is_string((uint64_t)name_val)
+                         ? kain_unbox_string((uint64_t)name_val)
+                         : "bench";
+  KainTaskFn fn = kain_task_fn_arg(fn_val, "bench");
+  int64_t runs = kain_index_arg(runs_val);
+  const char *env = getenv("KAIN_BENCH_RUNS");
+  if (env && atoll(env) > 0)
+    runs = atoll(env);
+  if (runs < 1)
+    runs = 1;
+  if (runs > KAIN_BENCH_MAX_RUNS)
+    runs = KAIN_BENCH_MAX_RUNS;
+
+  uint64_t *times = (uint64_t *)malloc((size_t)runs * sizeof(uint64_t));
+  if (!times) {
+    fprintf(stderr, "FATAL: OOM in bench\n");
+    exit(1);
   }
-}
 
-// Print stack trace on panic
-void kain_print_stack_trace(void) {
-  fprintf(stderr, "\n\033[1;36mStack trace (most recent call last):\033[0m\n");
-  for (int i = g_stack_depth - 1; i >= 0; i--) {
-    fprintf(stderr, "  at %s (%s:%d)\n", g_stack_frames[i].function_name,
-            g_stack_frames[i].file, g_stack_frames[i].line);
+  int64_t warmup = runs / 10;
+  if (warmup < 1)
+    warmup = 1;
+  if (warmup > KAIN_BENCH_MAX_WARMUP)
+    warmup = KAIN_BENCH_MAX_WARMUP;
+  for (int64_t i = 0; i < warmup; i++)
+    fn((int64_t)kain_box_int(i));
+
+  size_t bytes0 = kain_bench_bytes(), objects0 = kain_bench_objects();
+  for (int64_t i = 0; i < runs; i++) {
+    uint64_t t0 = kain_monotonic_ns();
+    fn((int64_t)kain_box_int(i));
+    times[i] = kain_monotonic_ns() - t0;
   }
+  size_t bytes1 = kain_bench_bytes(), objects1 = kain_bench_objects();
+
+  qsort(times, (size_t)runs, sizeof(uint64_t), kain_bench_cmp);
+  uint64_t median = runs & 1 ? times[runs / 2]
+                             : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+  uint64_t p99 = times[(runs * 99 + 99) / 100 - 1];
+  char min_s[32], median_s[32], p99_s[32], line[256];
+  kain_bench_fmt(min_s, sizeof(min_s), times[0]);
+  kain_bench_fmt(median_s, sizeof(median_s), median);
+  kain_bench_fmt(p99_s, sizeof(p99_s), p99);
+  free(times);
+
+  // Regions released inside f can shrink the arena below where it started
+  size_t bytes = bytes1 > bytes0 ? (bytes1 - bytes0) / (size_t)runs : 0;
+  int n = snprintf(line, sizeof(line),
+                   "bench %-24s min %10s  median %10s  p99 %10s  %zu B/run",
+                   name, min_s, median_s, p99_s, bytes);
+#ifdef KAIN_PROFILE
+  n += snprintf(line + n, sizeof(line) - n, "  %zu allocs/run",
+                (objects1 - objects0) / (size_t)runs);
+#else
+  (void)objects0;
+  (void)objects1;
+#endif
+  snprintf(line + n, sizeof(line) - n, "  (%lld runs)\n", (long long)runs);
+  kain_out_write(line, strlen(line));
+  return (int64_t)kain_box_int((int64_t)median);
 }
 
-// Get current stack depth (for debugging)
-int64_t kain_stack_depth(void) { return (int64_t)g_stack_depth; }
-
 int main(int argc, char **argv) {
-  printf("DEBUG: [C-MAIN] argc=%d, argv[0]=%s\n", argc, argv[0]);
-  fflush(stdout);
+  kain_gc_init(&argc);
   kain_set_args(argc, argv);
+  kain_clock_origin = kain_monotonic_ns();
+  kain_sample_from_env();
   int64_t r = main_Kain();
   return (int)r;
 }
@@ -1964,17 +7026,37 @@ int64_t assert(int64_t cond, int64_t msg) {
   return cond;
 }
 
-int64_t now(void) {
-  return 0; // Stub
-}
+int64_t now(void) { return kain_now(); }
 
-int64_t sleep(int64_t ms) {
-  return 0; // Stub
-}
+int64_t sleep(int64_t seconds) { return kain_sleep(seconds); }
 
 int64_t len(int64_t val) { return kain_len(val); }
 
+int64_t spawn_task(int64_t fn, int64_t arg) { return kain_spawn(fn, arg); }
+int64_t join_task(int64_t task) { return kain_task_join(task); }
+int64_t parallel_for(int64_t iter, int64_t fn) {
+  return kain_parallel_for(iter, fn);
+}
+int64_t parallel_map(int64_t arr, int64_t fn) {
+  return kain_parallel_map(arr, fn);
+}
+
 int64_t range(int64_t start, int64_t end) { return kain_range(start, end); }
+int64_t range_step(int64_t start, int64_t end, int64_t step) {
+  return kain_range_step(start, end, step);
+}
+int64_t i64_array(int64_t len) { return kain_i64_array(len); }
+int64_t f64_array(int64_t len) { return kain_f64_array(len); }
+int64_t u8_array(int64_t len) { return kain_u8_array(len); }
+int64_t to_i64_array(int64_t arr) { return kain_to_i64_array(arr); }
+int64_t to_f64_array(int64_t arr) { return kain_to_f64_array(arr); }
+int64_t to_u8_array(int64_t arr) { return kain_to_u8_array(arr); }
+int64_t array_sum(int64_t arr) { return kain_array_sum(arr); }
+int64_t array_dot(int64_t a, int64_t b) { return kain_array_dot(a, b); }
+int64_t array_scale(int64_t arr, int64_t k) { return kain_array_scale(arr, k); }
+int64_t array_fill(int64_t arr, int64_t v) { return kain_array_fill(arr, v); }
+int64_t array_equal(int64_t a, int64_t b) { return kain_array_equal(a, b); }
+int64_t array_find(int64_t arr, int64_t v) { return kain_array_find(arr, v); }
 
 // Forward declare Map_new if needed or just alias whatever exposes it
 extern int64_t Map_new();
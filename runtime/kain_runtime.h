@@ -0,0 +1,434 @@
+// ============================================================================
+// Kain Runtime - Value Representation & Inline Fast Paths
+// ============================================================================
+// NaN-boxing helpers shared by kain_runtime.c and anything compiled against
+// it (C extensions, tests). Everything here is static inline so that the
+// common tagged-int / double cases compile to a couple of instructions; the
+// out-of-line kain_*_op functions keep handling strings, builders and V1 raw
+// values.
+//
+// src/codegen.kn emits the same fast paths as alwaysinline LLVM IR
+// (@kain_add_fast etc.) - keep the two in sync.
+// ============================================================================
+
+#ifndef KAIN_RUNTIME_H
+#define KAIN_RUNTIME_H
+
+#include <stdint.h>
+#include <string.h>
+
+// =============================================================================
+// NaN-Boxing Type System
+// =============================================================================
+//
+// We use NaN-boxing to encode multiple types in a single 64-bit value.
+// IEEE 754 doubles have many "quiet NaN" bit patterns we can hijack.
+//
+// Bit layout:
+//   Float:  Any value < NANBOX_QNAN is a valid IEEE 754 double (unboxed)
+//   Tagged: [0xFFF8 prefix (16 bits)][tag (3 bits)][payload (45 bits)]
+//
+// Type tags (3 bits):
+//   0 = Pointer (heap object, 45-bit address space = 32TB)
+//   1 = Integer (signed 45-bit, range: ±17.5 trillion)
+//   2 = Boolean (payload = 0 or 1)
+//   3 = Null/Unit
+//   4 = String (points at the bytes of a length-prefixed heap string)
+//   5 = Runtime object (points at a KainObjHeader: builders, ranges, ...)
+//   6-7 = Reserved for future types
+//
+// References: V8, LuaJIT, SpiderMonkey, JavaScriptCore, Koka
+// =============================================================================
+
+// Quiet NaN prefix - any value >= this is a tagged value, not a double
+#define NANBOX_QNAN 0xFFF8000000000000ULL
+
+// Type tag shifts and masks
+#define NANBOX_TAG_SHIFT 45
+#define NANBOX_PAYLOAD_MASK 0x00001FFFFFFFFFFFULL // 45 bits
+
+// Type tags (stored in bits 45-47)
+#define kain_TAG_PTR 0ULL
+#define kain_TAG_INT 1ULL
+#define kain_TAG_BOOL 2ULL
+#define kain_TAG_NULL 3ULL
+#define kain_TAG_STR 4ULL // String pointers (for quick type checks)
+#define kain_TAG_OBJ 5ULL // Runtime-native objects with a KainObjHeader
+
+// === UNIFIED MEMORY MODEL MACROS ===
+// Standardized macros for NaN-boxing to ensure consistency across runtime and
+// codegen
+#define kain_BOX_PTR(ptr) (NANBOX_QNAN | (((uint64_t)(ptr)) >> 3))
+#define kain_UNBOX_PTR(val) ((void *)(((val) & NANBOX_PAYLOAD_MASK) << 3))
+// Box string: QNAN | (TAG << 45) | (ptr >> 3)
+#define kain_BOX_STR(ptr)                                                      \
+  ((NANBOX_QNAN | (kain_TAG_STR << NANBOX_TAG_SHIFT)) |                        \
+   (((uint64_t)(ptr)) >> 3))
+// Unbox string: (val & PAYLOAD_MASK) << 3
+#define kain_UNBOX_STR(val) ((const char *)(((val) & NANBOX_PAYLOAD_MASK) << 3))
+// Check string: (val & PREFIX_MASK) == STR_PREFIX
+#define kain_IS_STR(val)                                                       \
+  (((val) & (NANBOX_QNAN | (7ULL << NANBOX_TAG_SHIFT))) ==                     \
+   (NANBOX_QNAN | (kain_TAG_STR << NANBOX_TAG_SHIFT)))
+
+// Box runtime object: QNAN | (TAG_OBJ << 45) | (ptr >> 3)
+#define kain_BOX_OBJ(ptr)                                                      \
+  ((NANBOX_QNAN | (kain_TAG_OBJ << NANBOX_TAG_SHIFT)) |                        \
+   (((uint64_t)(ptr)) >> 3))
+#define kain_IS_OBJ(val)                                                       \
+  (((val) & (NANBOX_QNAN | (7ULL << NANBOX_TAG_SHIFT))) ==                     \
+   (NANBOX_QNAN | (kain_TAG_OBJ << NANBOX_TAG_SHIFT)))
+
+// Sentinel values
+#define kain_NULL (NANBOX_QNAN | (kain_TAG_NULL << NANBOX_TAG_SHIFT))
+#define kain_TRUE (NANBOX_QNAN | (kain_TAG_BOOL << NANBOX_TAG_SHIFT) | 1)
+#define kain_FALSE (NANBOX_QNAN | (kain_TAG_BOOL << NANBOX_TAG_SHIFT) | 0)
+
+// =============================================================================
+// Strict NaN-boxing (-DKAIN_STRICT_NANBOX)
+// =============================================================================
+//
+// V1 code passes raw ints and raw string pointers, so by default the checks
+// below also guess what an untagged word is. An object file compiled with
+// KAIN_STRICT_NANBOX promises tagged scalars instead: Ints, Bools, Null and
+// Strings always carry their tag, any other word below NANBOX_QNAN is a
+// Float, and 0 is null. Every check is then one mask-and-compare. Arrays and
+// structs may still be raw heap pointers where an argument can only be a
+// container. Arithmetic results stay boxed Ints and comparisons return
+// tagged Bools. The choice is per translation unit; the V1 bootstrap keeps
+// linking a runtime built without it.
+// =============================================================================
+
+#define KAIN_TAG_MASK (NANBOX_QNAN | (7ULL << NANBOX_TAG_SHIFT))
+#define KAIN_TAG_PREFIX(tag) (NANBOX_QNAN | ((tag) << NANBOX_TAG_SHIFT))
+#define KAIN_INT_PREFIX KAIN_TAG_PREFIX(kain_TAG_INT)
+#define KAIN_TAG_DOUBLE ((uint64_t)-1) // kain_get_tag() of a Float
+
+// === Type Checking ===
+
+static inline int kain_is_double(uint64_t v) { return v < NANBOX_QNAN; }
+
+static inline int kain_is_tagged(uint64_t v) { return v >= NANBOX_QNAN; }
+
+#ifdef KAIN_STRICT_NANBOX
+
+static inline uint64_t kain_get_tag(uint64_t v) {
+  if (v < NANBOX_QNAN)
+    return v ? KAIN_TAG_DOUBLE : kain_TAG_NULL;
+  return (v >> NANBOX_TAG_SHIFT) & 0x7;
+}
+
+static inline int kain_is_ptr(uint64_t v) {
+  return (v & KAIN_TAG_MASK) == KAIN_TAG_PREFIX(kain_TAG_PTR);
+}
+
+static inline int kain_is_string(uint64_t v) {
+  return (v & KAIN_TAG_MASK) == KAIN_TAG_PREFIX(kain_TAG_STR);
+}
+
+static inline int kain_is_int(uint64_t v) {
+  return (v & KAIN_TAG_MASK) == KAIN_INT_PREFIX;
+}
+
+static inline int kain_is_bool(uint64_t v) {
+  return (v & KAIN_TAG_MASK) == KAIN_TAG_PREFIX(kain_TAG_BOOL);
+}
+
+static inline int kain_is_null(uint64_t v) {
+  return v == 0 || (v & KAIN_TAG_MASK) == kain_NULL;
+}
+
+#else
+
+static inline uint64_t kain_get_tag(uint64_t v) {
+  if (v == 0)
+    return kain_TAG_NULL; // Treat 0 as Null
+  if (v < NANBOX_QNAN) {
+    // TRANSITION HACK: If the value is small (e.g. < 1 million),
+    // it's almost certainly a raw integer from the V1 compiler.
+    if (v < 0x0010000000000000ULL)
+      return kain_TAG_INT;
+    return KAIN_TAG_DOUBLE;
+  }
+  return (v >> NANBOX_TAG_SHIFT) & 0x7;
+}
+
+static inline int kain_is_ptr(uint64_t v) {
+  if (v == 0)
+    return 0;
+  if (v < NANBOX_QNAN)
+    return v > 0x10000; // V1 Pointer
+  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_PTR &&
+         (v & NANBOX_QNAN) == NANBOX_QNAN;
+}
+
+static inline int kain_is_string(uint64_t v) {
+  if (v == 0)
+    return 0;
+  if (v < NANBOX_QNAN)
+    return v > 0x10000; // V1 String
+  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_STR &&
+         (v & NANBOX_QNAN) == NANBOX_QNAN;
+}
+
+static inline int kain_is_int(uint64_t v) {
+  if (v < NANBOX_QNAN)
+    return v < 0x0010000000000000ULL;
+  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_INT &&
+         (v & NANBOX_QNAN) == NANBOX_QNAN;
+}
+
+static inline int kain_is_bool(uint64_t v) {
+  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_BOOL;
+}
+
+static inline int kain_is_null(uint64_t v) {
+  if (v == 0)
+    return 1;
+  if (v < NANBOX_QNAN)
+    return 0;
+  return ((v >> NANBOX_TAG_SHIFT) & 0x7) == kain_TAG_NULL;
+}
+
+#endif // KAIN_STRICT_NANBOX
+
+// === Boxing (Kain -> NaN-box) ===
+
+static inline uint64_t kain_box_double(double d) {
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(double));
+  return bits;
+}
+
+static inline uint64_t kain_box_ptr(void *p) {
+  if (p == NULL)
+    return 0;
+  return kain_BOX_PTR(p);
+}
+
+// `s` must come from kain_str_alloc/kain_str_new (it needs a KainStrHeader);
+// use kain_box_cstr() for foreign C strings.
+static inline uint64_t kain_box_string(const char *s) {
+  return kain_BOX_STR(s);
+}
+
+static inline uint64_t kain_box_int(int64_t n) {
+  // Apply NaN-boxing: QNAN | (TAG_INT << 45) | (value & PAYLOAD_MASK)
+  return NANBOX_QNAN | (kain_TAG_INT << NANBOX_TAG_SHIFT) |
+         ((uint64_t)n & NANBOX_PAYLOAD_MASK);
+}
+
+static inline uint64_t kain_box_bool(int b) {
+  return b ? kain_TRUE : kain_FALSE;
+}
+
+static inline uint64_t kain_box_null(void) { return kain_NULL; }
+
+// === Unboxing (NaN-box -> Kain) ===
+
+static inline double kain_unbox_double(uint64_t v) {
+  double d;
+  memcpy(&d, &v, sizeof(double));
+  return d;
+}
+
+static inline void *kain_unbox_ptr(uint64_t v) {
+  if (v == 0)
+    return NULL;
+  return kain_UNBOX_PTR(v);
+}
+
+static inline int64_t kain_unbox_int(uint64_t v) {
+  // Sign-extend from 45 bits
+  int64_t raw = (int64_t)(v & NANBOX_PAYLOAD_MASK);
+  // If bit 44 is set, extend the sign
+  if (raw & (1ULL << 44)) {
+    raw |= 0xFFFFE00000000000LL; // Set upper bits for negative
+  }
+  return raw;
+}
+
+static inline int kain_unbox_bool(uint64_t v) {
+  return (v & NANBOX_PAYLOAD_MASK) != 0;
+}
+
+// =============================================================================
+// Arithmetic / Comparison Fast Paths
+// =============================================================================
+//
+// Each kain_*_fast() handles two tagged ints (add also takes two doubles)
+// inline and otherwise defers to the runtime op, so results are identical to
+// calling the op directly. Note the V1 conventions of the ops: add returns a
+// boxed int, sub/mul return raw ints, comparisons return raw 0/1 (boxed
+// results and tagged Bools under KAIN_STRICT_NANBOX).
+// =============================================================================
+
+int64_t kain_add_op(int64_t a_val, int64_t b_val);
+int64_t kain_sub_op(int64_t a_val, int64_t b_val);
+int64_t kain_mul_op(int64_t a_val, int64_t b_val);
+int64_t kain_div_op(int64_t a_val, int64_t b_val);
+int64_t kain_rem_op(int64_t a_val, int64_t b_val);
+int64_t kain_eq_op(int64_t a_val, int64_t b_val);
+int64_t kain_neq_op(int64_t a_val, int64_t b_val);
+int64_t kain_lt_op(int64_t a_val, int64_t b_val);
+int64_t kain_le_op(int64_t a_val, int64_t b_val);
+int64_t kain_gt_op(int64_t a_val, int64_t b_val);
+int64_t kain_ge_op(int64_t a_val, int64_t b_val);
+
+#ifdef KAIN_STRICT_NANBOX
+#define KAIN_DOUBLE_MIN 1ULL // Everything but null below the tags
+#define KAIN_OP_INT(n) ((int64_t)kain_box_int(n))
+#define KAIN_OP_BOOL(c) ((int64_t)kain_box_bool(c))
+#else
+// Smallest bit pattern kain_is_int() does not claim as a raw V1 int
+#define KAIN_DOUBLE_MIN 0x0010000000000000ULL
+// V1 codegen indexes with raw sub/mul results and branches on raw 0/1
+#define KAIN_OP_INT(n) ((int64_t)(n))
+#define KAIN_OP_BOOL(c) ((int64_t)((c) ? 1 : 0))
+#endif
+
+static inline int kain_both_int(uint64_t a, uint64_t b) {
+  return ((a & KAIN_TAG_MASK) == KAIN_INT_PREFIX) &
+         ((b & KAIN_TAG_MASK) == KAIN_INT_PREFIX);
+}
+
+// Both values are doubles that kain_add_op would not read as raw ints
+static inline int kain_both_double(uint64_t a, uint64_t b) {
+  return (a - KAIN_DOUBLE_MIN < NANBOX_QNAN - KAIN_DOUBLE_MIN) &
+         (b - KAIN_DOUBLE_MIN < NANBOX_QNAN - KAIN_DOUBLE_MIN);
+}
+
+// Payload arithmetic wraps modulo 2^45 exactly like kain_box_int(x + y)
+static inline int64_t kain_add_fast(int64_t a_val, int64_t b_val) {
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+  if (kain_both_int(a, b))
+    return (int64_t)(((a + b) & NANBOX_PAYLOAD_MASK) | KAIN_INT_PREFIX);
+  if (kain_both_double(a, b))
+    return (int64_t)kain_box_double(kain_unbox_double(a) +
+                                    kain_unbox_double(b));
+  return kain_add_op(a_val, b_val);
+}
+
+static inline int64_t kain_sub_fast(int64_t a_val, int64_t b_val) {
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+  if (kain_both_int(a, b))
+    return KAIN_OP_INT(kain_unbox_int(a) - kain_unbox_int(b));
+  return kain_sub_op(a_val, b_val);
+}
+
+static inline int64_t kain_mul_fast(int64_t a_val, int64_t b_val) {
+  uint64_t a = (uint64_t)a_val;
+  uint64_t b = (uint64_t)b_val;
+  if (kain_both_int(a, b))
+    return KAIN_OP_INT(kain_unbox_int(a) * kain_unbox_int(b));
+  return kain_mul_op(a_val, b_val);
+}
+
+static inline int64_t kain_eq_fast(int64_t a_val, int64_t b_val) {
+  if (kain_both_int((uint64_t)a_val, (uint64_t)b_val))
+    return KAIN_OP_BOOL(a_val == b_val);
+  return kain_eq_op(a_val, b_val);
+}
+
+static inline int64_t kain_neq_fast(int64_t a_val, int64_t b_val) {
+  if (kain_both_int((uint64_t)a_val, (uint64_t)b_val))
+    return KAIN_OP_BOOL(a_val != b_val);
+  return kain_neq_op(a_val, b_val);
+}
+
+#define KAIN_CMP_FAST(name, op)                                                \
+  static inline int64_t kain_##name##_fast(int64_t a_val, int64_t b_val) {     \
+    uint64_t a = (uint64_t)a_val;                                              \
+    uint64_t b = (uint64_t)b_val;                                              \
+    if (kain_both_int(a, b))                                                   \
+      return KAIN_OP_BOOL(kain_unbox_int(a) op kain_unbox_int(b));             \
+    return kain_##name##_op(a_val, b_val);                                     \
+  }
+
+KAIN_CMP_FAST(lt, <)
+KAIN_CMP_FAST(le, <=)
+KAIN_CMP_FAST(gt, >)
+KAIN_CMP_FAST(ge, >=)
+
+#undef KAIN_CMP_FAST
+
+// =============================================================================
+// Embedding from several threads
+// =============================================================================
+//
+// Each thread gets its own arena and trace stack automatically. Call
+// kain_enable_threads() once before a second thread enters compiled Kain
+// code, and kain_thread_exit() from a thread that is done with everything
+// it allocated (its pages go back to the shared pool).
+// =============================================================================
+
+void kain_enable_threads(void);
+void kain_thread_exit(void);
+
+// =============================================================================
+// Garbage collection (runtime built with -DKAIN_GC)
+// =============================================================================
+//
+// Call kain_gc_init() with the address of a local in the outermost frame
+// that calls into Kain code (main() already does), and register globals that
+// hold Kain values with kain_gc_add_root(). Without KAIN_GC these are no-ops.
+// =============================================================================
+
+void kain_gc_init(void *stack_base);
+void kain_gc_add_root(int64_t *slot);
+int64_t kain_gc_collect(void);
+
+// =============================================================================
+// Profiling (runtime built with -DKAIN_PROFILE)
+// =============================================================================
+
+// Print call, allocation and map counters to stderr; a note otherwise
+int64_t kain_profile_dump(void);
+
+// Call tracing (korec --trace) and the sampling profiler built on it.
+// KAIN_SAMPLE=<file> samples a whole run; these profile part of one.
+void kain_trace_enter(const char *func_name, const char *file, int line);
+void kain_trace_exit(void);
+int64_t kain_sample_start(int64_t hz);
+int64_t kain_sample_stop(void);
+int64_t kain_sample_write(int64_t path);
+
+// =============================================================================
+// Number parsing
+// =============================================================================
+
+// Whole-string parses: Some(value), or None for empty input, stray
+// characters (including blanks) or an Int outside the 45-bit range.
+// Floats are plain decimals with an optional exponent: no hex, inf or nan.
+int64_t kain_parse_int(int64_t str);
+int64_t kain_parse_float(int64_t str);
+
+// =============================================================================
+// Buffered writers
+// =============================================================================
+
+// Open for writing (truncate, or append), null on failure
+int64_t kain_writer_open(int64_t path);
+int64_t kain_writer_append(int64_t path);
+// Write full buffers on the thread pool from now on; returns the writer
+int64_t kain_writer_async(int64_t writer);
+// Bool results are false once any write on the writer has failed
+int64_t kain_writer_write(int64_t writer, int64_t value);
+int64_t kain_writer_writev(int64_t writer, int64_t pieces);
+int64_t kain_writer_flush(int64_t writer);
+int64_t kain_writer_close(int64_t writer);
+
+// =============================================================================
+// Clocks and benchmarks
+// =============================================================================
+
+int64_t kain_now(void);    // Float seconds since start, monotonic
+int64_t kain_now_ns(void); // Int nanoseconds since start, monotonic
+int64_t kain_cycles(void);
+int64_t kain_sleep(int64_t seconds);
+// Time fn(i) over runs calls; prints a summary line, returns the median ns
+int64_t kain_bench(int64_t name, int64_t fn, int64_t runs);
+
+#endif // KAIN_RUNTIME_H
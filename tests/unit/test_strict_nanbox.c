@@ -0,0 +1,67 @@
+// Strict NaN-box mode: the runtime and this file both compiled with
+// -DKAIN_STRICT_NANBOX, e.g. from the repository root:
+//   gcc -DKAIN_STRICT_NANBOX -Iruntime tests/unit/test_strict_nanbox.c
+//       runtime/kain_runtime.c -lm -lpthread
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "kain_runtime.h"
+
+char *kain_str_new(const char *s);
+int64_t kain_to_string(int64_t val);
+int64_t kain_contains(int64_t first, int64_t second);
+int64_t kain_is_truthy(int64_t val);
+int64_t kain_array_new(void);
+int64_t kain_array_push(int64_t arr, int64_t value);
+
+static int failures = 0;
+
+static void expect(const char *what, int64_t val, const char *want) {
+  const char *got = kain_UNBOX_STR((uint64_t)kain_to_string(val));
+  if (strcmp(got, want) != 0) {
+    printf("FAIL %s: got %s, want %s\n", what, got, want);
+    failures++;
+  }
+}
+
+static int64_t I(int64_t n) { return (int64_t)kain_box_int(n); }
+static int64_t F(double d) { return (int64_t)kain_box_double(d); }
+static int64_t S(const char *s) { return (int64_t)kain_box_string(kain_str_new(s)); }
+
+int64_t main_Kain() {
+  expect("int", I(-42), "-42");
+  expect("float", F(2.5), "2.5");
+  expect("null", 0, "null");
+
+  expect("int + int", kain_add_op(I(2), I(3)), "5");
+  expect("int + float", kain_add_op(I(2), F(0.5)), "2.5");
+  expect("str + str", kain_add_op(S("ab"), S("cd")), "abcd");
+  expect("sub is boxed", kain_sub_fast(I(2), I(5)), "-3");
+  expect("mul promotes", kain_mul_op(I(4), F(1.5)), "6");
+
+  expect("lt", kain_lt_fast(I(1), I(2)), "true");
+  expect("ge mixed", kain_ge_op(F(1.0), I(2)), "false");
+  expect("eq strings", kain_eq_op(S("xy"), S("xy")), "true");
+  expect("neq", kain_neq_op(I(3), I(4)), "true");
+  expect("null spellings", kain_eq_op(0, (int64_t)kain_NULL), "true");
+
+  int64_t arr = kain_array_new();
+  kain_array_push(arr, S("k"));
+  kain_array_push(arr, I(9));
+  expect("raw array holds int", kain_contains(arr, I(9)), "true");
+  expect("raw array holds str", kain_contains(arr, S("k")), "true");
+  expect("raw array misses", kain_contains(arr, I(1)), "false");
+  expect("substring", kain_contains(S("hello"), S("ll")), "true");
+
+  if (kain_is_truthy(I(0)) || !kain_is_truthy(I(-1)) ||
+      kain_is_truthy((int64_t)kain_FALSE) || !kain_is_truthy(S(""))) {
+    printf("FAIL truthy\n");
+    failures++;
+  }
+
+  printf(failures ? "%d strict NaN-box checks failed\n"
+                  : "All strict NaN-box checks passed\n",
+         failures);
+  return failures != 0;
+}